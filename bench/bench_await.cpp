@@ -0,0 +1,182 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   coroutine playout through RTPPlayoutStream.
+*
+*   usage: bench_await [streams] [seconds] [workers]
+*
+*   Runs 'streams' coroutines, each doing nothing but co_await stream.next()
+*   on its own RTPJitter, on 'workers' scheduler threads.  The main thread
+*   plays the network and pushes a 20 ms packet into every buffer each 20 ms,
+*   losing 5% of them.  One JSON object at the end, e.g.
+*
+*       {"bench":"rtp_await","streams":1000,"resumes":99000,"gaps":4900,
+*        "cpu_ns_per_resume":900, "lateness_p99_us":300, ...}
+*
+*   The coroutines only run when a frame or a gap is due; the exit status is
+*   1 if any of them saw a result other than SUCCESS or DROPPED_PACKET before
+*   being closed, or did not finish.  Built as C++20.
+*
+******************************************************************************/
+
+#include "rtp_await.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+static const unsigned   PACKET_MS = 20;
+static const unsigned   DEPTH_MS  = 60;
+
+// the least a coroutine needs to be started and forgotten
+struct detached
+{
+    struct promise_type
+    {
+        detached            get_return_object()     { return {}; }
+        suspend_never       initial_suspend()       { return {}; }
+        suspend_never       final_suspend() noexcept { return {}; }
+        void                return_void()           {}
+        void                unhandled_exception()   { abort(); }
+    };
+};
+
+struct counters
+{
+    atomic<uint64>  resumes{0};
+    atomic<uint64>  gaps{0};
+    atomic<uint64>  unexpected{0};
+    atomic<uint64>  finished{0};
+};
+
+static detached listen(RTPPlayoutStream& stream, counters& c)
+{
+    for (;;) {
+        RTPPlayoutStream::frame f = co_await stream.next();
+        if (f.result == RTPJitter::BUFFER_EMPTY) {
+            break;                                  // closed
+        }
+        if (f.result == RTPJitter::DROPPED_PACKET) {
+            c.gaps.fetch_add(1, memory_order_relaxed);
+        } else if ((f.result != RTPJitter::SUCCESS) || !f.packet) {
+            c.unexpected.fetch_add(1, memory_order_relaxed);
+        }
+        c.resumes.fetch_add(1, memory_order_relaxed);
+    }
+    c.finished.fetch_add(1, memory_order_relaxed);
+}
+
+static rawrtp_ptr make_packet(const uint16 sequence)
+{
+    uint8       data[RTP_HEADER_LENGTH + 160];
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(data);
+
+    memset(data, 0xff, sizeof(data));
+    rtp->flags = htons(RTP_VERSION << 14);
+    rtp->sequence = htons(sequence);
+    rtp->timestamp = htonl((uint32)sequence * 160);
+    rtp->ssrc = htonl(0x1234);
+    return make_shared<RTPPacket>(data, sizeof(data));
+}
+
+static double cpu_ns()
+{
+    rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    return (u.ru_utime.tv_sec + u.ru_stime.tv_sec) * 1e9 + (u.ru_utime.tv_usec + u.ru_stime.tv_usec) * 1e3;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    count   = (argc > 1) ? atoi(argv[1]) : 1000;
+    unsigned    seconds = (argc > 2) ? atoi(argv[2]) : 3;
+    unsigned    workers = (argc > 3) ? atoi(argv[3]) : 1;
+
+    if (count == 0) count = 1;
+    if (workers == 0) workers = 1;
+
+    // results go to the real stdout; library logging goes nowhere
+    FILE *out = fdopen(dup(fileno(stdout)), "w");
+    if ((out == nullptr) || (freopen("/dev/null", "w", stdout) == nullptr)) {
+        fprintf(stderr, "bench_await: could not redirect stdout\n");
+        return 1;
+    }
+
+    RTPPlayoutScheduler     scheduler(workers);
+    vector<unique_ptr<RTPJitter>>           buffers;
+    vector<unique_ptr<RTPPlayoutStream>>    streams;
+    counters                c;
+    mt19937                 rng(12345);
+    uniform_int_distribution<int> pct(0, 99);
+
+    for (unsigned i = 0; i < count; ++i) {
+        buffers.emplace_back(new RTPJitter(DEPTH_MS));
+    }
+    scheduler.start();
+    for (unsigned i = 0; i < count; ++i) {
+        streams.emplace_back(new RTPPlayoutStream(scheduler, *buffers[i], PACKET_MS));
+        listen(*streams.back(), c);
+    }
+
+    double      cpu0 = cpu_ns();
+    timepoint   next = stdclock::now();
+    unsigned    ticks = seconds * 1000 / PACKET_MS;
+    for (unsigned t = 0; t < ticks; ++t) {
+        for (auto& b : buffers) {
+            if (pct(rng) >= 5) {
+                b->push(make_packet((uint16)t));
+            }
+        }
+        next += clocks::milliseconds(PACKET_MS);
+        this_thread::sleep_until(next);
+    }
+    double cpu1 = cpu_ns();
+
+    streams.clear();                                // closes, ending every coroutine
+    scheduler.stop();
+
+    RTPPlayoutScheduler::lateness late = scheduler.get_lateness();
+    uint64 resumes = c.resumes.load();
+    int status = ((c.unexpected.load() == 0) && (c.finished.load() == count) && resumes) ? 0 : 1;
+
+    fprintf(out, "{\"bench\":\"rtp_await\",\"streams\":%u,\"seconds\":%u,\"workers\":%u,\"threads\":%u,"
+                 "\"resumes\":%llu,\"gaps\":%llu,\"unexpected\":%llu,\"finished\":%llu,"
+                 "\"cpu_ns_per_resume\":%.0f,\"lateness_p50_us\":%.1f,\"lateness_p99_us\":%.1f}\n",
+            count, seconds, workers, workers + 1,
+            (unsigned long long)resumes, (unsigned long long)c.gaps.load(),
+            (unsigned long long)c.unexpected.load(), (unsigned long long)c.finished.load(),
+            resumes ? (cpu1 - cpu0) / resumes : 0.0,
+            late.percentile_ns(0.50) / 1e3, late.percentile_ns(0.99) / 1e3);
+    return status;
+}
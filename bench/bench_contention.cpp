@@ -0,0 +1,377 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   multi-threaded contention and scaling benchmark for RTPJitter.
+*
+*   usage: bench_contention [max_pairs] [instances] [ms_per_run] [first_cpu]
+*
+*   For 1, 2, 4 ... max_pairs producer/consumer thread pairs, runs two
+*   topologies over 'instances' buffers:
+*
+*       partitioned - each pair owns its own slice of the buffers, so a
+*                     buffer is only shared by one producer and one consumer
+*       shared      - every thread walks every buffer, the worst case
+*
+*   Producers push() and consumers pop() as fast as they can.  Every 4th
+*   call is timed into a latency histogram.  Lock waits are timed by an
+*   observer with TIMED_LOCK, and cache misses come from perf_event_open if
+*   the kernel allows it (-1 if not).  Threads are pinned round robin from
+*   'first_cpu' (-1 for no pinning).  One JSON object per run:
+*
+*       {"bench":"rtp_contention","topology":"shared","pairs":4,
+*        "instances":4096,"push_mops":...,"pop_mops":...,
+*        "push_p50_ns":...,"push_p99_ns":...,"push_p999_ns":...,
+*        "pop_p50_ns":...,"pop_p99_ns":...,"pop_p999_ns":...,
+*        "lock_waits":...,"lock_wait_ns_per_op":...,"cache_misses_per_op":...}
+*
+******************************************************************************/
+
+#include "rtp_jitter_impl.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const unsigned   PACKET_BYTES = 172;
+static const unsigned   PACKET_MS    = 20;
+static const unsigned   DEPTH_MS     = 20;
+static const unsigned   RECYCLE      = 64;      // packets kept per producer per buffer
+static const unsigned   SAMPLE_EVERY = 4;
+
+
+
+// - lock timing --------------------------------------------------------------
+
+struct lock_timing : RTPJitterNullObserver
+{
+    static const bool TIMED_LOCK = true;
+
+    uint64  waits = 0;
+    uint64  wait_ns = 0;
+
+    void on_lock_wait(const uint64 ns) { ++waits; wait_ns += ns; }
+};
+
+typedef RTPJitterT<lock_timing>     timed_jitter;
+
+
+// - cache misses -------------------------------------------------------------
+
+// counts for this thread and every thread it creates after the call
+static int open_cache_misses()
+{
+    perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static int64 read_counter(const int fd)
+{
+    uint64 value = 0;
+    if ((fd < 0) || (read(fd, &value, sizeof(value)) != sizeof(value))) {
+        return -1;
+    }
+    return (int64)value;
+}
+
+
+// - threads ------------------------------------------------------------------
+
+struct worker
+{
+    vector<timed_jitter *>  buffers;
+    int                     cpu;
+    uint64                  ops;
+    RTPLatencyHistogram     latency;        // ns
+    vector<rawrtp_ptr>      packets;        // producers: RECYCLE per buffer
+    vector<uint16>          sequences;      // producers: next sequence per buffer
+};
+
+static void pin(const int cpu)
+{
+    if (cpu < 0) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static rawrtp_ptr make_packet(const uint16 sequence)
+{
+    uint8       data[PACKET_BYTES];
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(data);
+
+    memset(data, 0xff, sizeof(data));
+    rtp->flags = htons(RTP_VERSION << 14);
+    rtp->sequence = htons(sequence);
+    rtp->timestamp = htonl((uint32)sequence * 160);
+    rtp->ssrc = htonl(0x1234);
+
+    rawrtp_ptr packet = make_shared<RTPPacket>(data, sizeof(data));
+    packet->payload_ms = PACKET_MS;
+    packet->payload_bytes = PACKET_BYTES - RTP_HEADER_LENGTH;
+    return packet;
+}
+
+// re-stamps a packet we made earlier, or makes a new one if the last one
+//  with this slot is still referenced by a buffer or a consumer
+static rawrtp_ptr& next_packet(worker& w, const size_t b)
+{
+    uint16      sequence = w.sequences[b]++;
+    rawrtp_ptr& slot = w.packets[(b * RECYCLE) + (sequence % RECYCLE)];
+
+    if (!slot || (slot.use_count() > 1)) {
+        slot = make_packet(sequence);
+    } else {
+        RTPHeader *rtp = reinterpret_cast<RTPHeader *>(slot->pData);
+        rtp->sequence = htons(sequence);
+        rtp->timestamp = htonl((uint32)sequence * 160);
+    }
+    return slot;
+}
+
+static void producer(worker *w, const atomic<bool> *go, const atomic<bool> *run)
+{
+    pin(w->cpu);
+    while (!go->load()) {
+        this_thread::yield();
+    }
+
+    while (run->load(memory_order_relaxed)) {
+        for (size_t b = 0; b < w->buffers.size(); ++b) {
+            rawrtp_ptr& p = next_packet(*w, b);
+            if ((w->ops % SAMPLE_EVERY) == 0) {
+                timepoint t0 = stdclock::now();
+                w->buffers[b]->push(p);
+                w->latency.record(clocks::duration_cast<clocks::nanoseconds>(stdclock::now() - t0).count());
+            } else {
+                w->buffers[b]->push(p);
+            }
+            ++w->ops;
+        }
+    }
+}
+
+static void consumer(worker *w, const atomic<bool> *go, const atomic<bool> *run)
+{
+    rawrtp_ptr packet;
+
+    pin(w->cpu);
+    while (!go->load()) {
+        this_thread::yield();
+    }
+
+    while (run->load(memory_order_relaxed)) {
+        for (timed_jitter *buffer : w->buffers) {
+            if ((w->ops % SAMPLE_EVERY) == 0) {
+                timepoint t0 = stdclock::now();
+                buffer->pop(packet);
+                w->latency.record(clocks::duration_cast<clocks::nanoseconds>(stdclock::now() - t0).count());
+            } else {
+                buffer->pop(packet);
+            }
+            packet.reset();
+            ++w->ops;
+        }
+    }
+}
+
+
+// - one run ------------------------------------------------------------------
+
+struct percentiles
+{
+    uint64  p50, p99, p999;
+};
+
+static percentiles merge(const vector<worker *>& workers)
+{
+    vector<uint64>  counts(RTPLatencyHistogram::BUCKETS, 0);
+    uint64          total = 0;
+    uint64          largest = 0;
+
+    for (worker *w : workers) {
+        for (unsigned i = 0; i < RTPLatencyHistogram::BUCKETS; ++i) {
+            counts[i] += w->latency.bucket_count(i);
+        }
+        total += w->latency.count();
+        largest = max(largest, w->latency.max());
+    }
+
+    const double    q[3] = { 0.50, 0.99, 0.999 };
+    uint64          v[3] = { 0, 0, 0 };
+    for (unsigned k = 0; k < 3; ++k) {
+        uint64 target = max<uint64>(1, (uint64)(q[k] * total + 0.5));
+        uint64 seen = 0;
+        for (unsigned i = 0; (i < RTPLatencyHistogram::BUCKETS) && total; ++i) {
+            seen += counts[i];
+            if (seen >= target) {
+                v[k] = min(RTPLatencyHistogram::bucket_high(i), largest);
+                break;
+            }
+        }
+    }
+    return { v[0], v[1], v[2] };
+}
+
+static void run(const char *topology, const bool shared, const unsigned pairs,
+                const unsigned instances, const unsigned ms, const int first_cpu, FILE *out)
+{
+    unsigned cpus = thread::hardware_concurrency();
+    if (cpus == 0) cpus = 1;
+
+    vector<unique_ptr<timed_jitter>> buffers;
+    for (unsigned i = 0; i < instances; ++i) {
+        buffers.push_back(unique_ptr<timed_jitter>(new timed_jitter(DEPTH_MS)));
+    }
+
+    vector<unique_ptr<worker>> producers, consumers;
+    for (unsigned p = 0; p < pairs; ++p) {
+        for (int side = 0; side < 2; ++side) {
+            worker *w = new worker();
+            w->cpu = (first_cpu < 0) ? -1 : (int)((first_cpu + (2 * p) + side) % cpus);
+            w->ops = 0;
+            for (unsigned i = 0; i < instances; ++i) {
+                if (shared || ((i % pairs) == p)) {
+                    w->buffers.push_back(buffers[i].get());
+                }
+            }
+            if (side == 0) {
+                // in the shared topology producers interleave sequence
+                //  numbers on the same buffer; that is contention too,
+                //  just with more out-of-order work.
+                w->packets.resize(w->buffers.size() * RECYCLE);
+                w->sequences.assign(w->buffers.size(), (uint16)(p * 7919));
+                producers.push_back(unique_ptr<worker>(w));
+            } else {
+                consumers.push_back(unique_ptr<worker>(w));
+            }
+        }
+    }
+
+    atomic<bool>    go(false), running(true);
+    int             misses_fd = open_cache_misses();
+    vector<thread>  threads;
+
+    for (unsigned p = 0; p < pairs; ++p) {
+        threads.push_back(thread(producer, producers[p].get(), &go, &running));
+        threads.push_back(thread(consumer, consumers[p].get(), &go, &running));
+    }
+
+    if (misses_fd >= 0) {
+        ioctl(misses_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(misses_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    timepoint start = stdclock::now();
+    go = true;
+    this_thread::sleep_for(clocks::milliseconds(ms));
+    running = false;
+    for (thread& t : threads) {
+        t.join();
+    }
+    double seconds = clocks::duration<double>(stdclock::now() - start).count();
+    if (misses_fd >= 0) {
+        ioctl(misses_fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    int64 misses = read_counter(misses_fd);
+    if (misses_fd >= 0) {
+        close(misses_fd);
+    }
+
+    uint64 push_ops = 0, pop_ops = 0, waits = 0, wait_ns = 0;
+    vector<worker *> pushers, poppers;
+    for (unsigned p = 0; p < pairs; ++p) {
+        push_ops += producers[p]->ops;
+        pop_ops += consumers[p]->ops;
+        pushers.push_back(producers[p].get());
+        poppers.push_back(consumers[p].get());
+    }
+    for (auto& b : buffers) {
+        waits += b->observer().waits;
+        wait_ns += b->observer().wait_ns;
+    }
+
+    uint64      ops = push_ops + pop_ops;
+    percentiles push = merge(pushers);
+    percentiles pop = merge(poppers);
+
+    fprintf(out, "{\"bench\":\"rtp_contention\",\"topology\":\"%s\",\"pairs\":%u,\"instances\":%u,"
+                 "\"push_mops\":%.3f,\"pop_mops\":%.3f,"
+                 "\"push_p50_ns\":%llu,\"push_p99_ns\":%llu,\"push_p999_ns\":%llu,"
+                 "\"pop_p50_ns\":%llu,\"pop_p99_ns\":%llu,\"pop_p999_ns\":%llu,"
+                 "\"lock_waits\":%llu,\"lock_wait_ns_per_op\":%.2f,\"cache_misses_per_op\":%.3f}\n",
+            topology, pairs, instances,
+            push_ops / seconds / 1e6, pop_ops / seconds / 1e6,
+            (unsigned long long)push.p50, (unsigned long long)push.p99, (unsigned long long)push.p999,
+            (unsigned long long)pop.p50, (unsigned long long)pop.p99, (unsigned long long)pop.p999,
+            (unsigned long long)waits, ops ? (double)wait_ns / ops : 0.0,
+            (misses < 0) ? -1.0 : (ops ? (double)misses / ops : 0.0));
+    fflush(out);
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    max_pairs = (argc > 1) ? atoi(argv[1]) : 64;
+    unsigned    instances = (argc > 2) ? atoi(argv[2]) : 4096;
+    unsigned    ms        = (argc > 3) ? atoi(argv[3]) : 1000;
+    int         first_cpu = (argc > 4) ? atoi(argv[4]) : 0;
+
+    if (max_pairs == 0) max_pairs = 1;
+    if (instances == 0) instances = 1;
+
+    // results go to the real stdout; library logging goes nowhere
+    FILE *out = fdopen(dup(fileno(stdout)), "w");
+    if ((out == nullptr) || (freopen("/dev/null", "w", stdout) == nullptr)) {
+        fprintf(stderr, "bench_contention: could not redirect stdout\n");
+        return 1;
+    }
+
+    for (unsigned pairs = 1; pairs <= max_pairs; pairs *= 2) {
+        run("partitioned", false, pairs, max(instances, pairs), ms, first_cpu, out);
+        run("shared", true, pairs, instances, ms, first_cpu, out);
+    }
+    return 0;
+}
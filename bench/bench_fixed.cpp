@@ -0,0 +1,182 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   timing for the heap-free RTPFixedJitter.
+*
+*   usage: bench_fixed [packets] [runs]
+*
+*   Builds an RTPFixedPacketPool and an RTPFixedJitter, warms them up, then
+*   streams 'packets' packets through them -- in order, reordered, lost,
+*   overflowing and reset.  Writes one JSON object, e.g.
+*
+*       {"bench":"rtp_fixed","packets":200000,"runs":5,"push_ns_per_op":38.1,
+*        "pop_ns_per_op":35.0, ...}
+*
+*   test/test_fixed streams the same traffic and checks that none of it
+*   touches the heap.
+*
+******************************************************************************/
+
+#include "rtp_fixed.h"
+#include "rtp_log.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+// - the stream ---------------------------------------------------------------
+
+static const unsigned   PACKET_BYTES = 172;
+static const unsigned   PACKET_MS    = 20;
+static const unsigned   DEPTH_MS     = 60;
+static const unsigned   SLOTS        = 4;      // under the 120 ms max depth (6 packets), so bursts hit the ring's capacity
+static const unsigned   POOL         = 64;
+
+typedef RTPFixedJitter<SLOTS>               fixed_jitter;
+typedef RTPFixedPacketPool<POOL, 256>       fixed_pool;
+
+struct result
+{
+    double  push_ns;
+    double  pop_ns;
+    uint64  push_ops;
+    uint64  pop_ops;
+    uint64  overflows;
+    uint64  dropped;
+};
+
+// the i'th packet of the stream: every 7th swapped with its successor,
+//  every 50th lost, and a burst every 1000 that overflows the ring
+static uint16 sequence_at(const unsigned i)
+{
+    if ((i % 7) == 0) return (uint16)(i + 1);
+    if ((i % 7) == 1) return (uint16)(i - 1);
+    return (uint16)i;
+}
+
+static void stream(fixed_jitter& jitter, fixed_pool& pool, const unsigned packets, result *r)
+{
+    uint8       data[PACKET_BYTES];
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(data);
+    rawrtp_ptr  out;
+    timepoint   arrival = stdclock::now();
+
+    memset(data, 0xff, sizeof(data));
+    rtp->flags = htons((RTP_VERSION << 14) | RTP_PAYLOAD_G711U);
+    rtp->ssrc = htonl(0x1234);
+
+    for (unsigned i = 0; i < packets; ++i) {
+        uint16 sequence = sequence_at(i);
+
+        if ((i % 50) != 49) {
+            rtp->sequence = htons(sequence);
+            rtp->timestamp = htonl((uint32)sequence * 160);
+
+            timepoint t0 = stdclock::now();
+            rawrtp_ptr p = pool.acquire(data, sizeof(data));
+            RTPJitter::RESULT rc = p ? jitter.push(move(p), arrival) : RTPJitter::BUFFER_OVERFLOW;
+            timepoint t1 = stdclock::now();
+            if (r) {
+                r->push_ns += clocks::duration<double, nano>(t1 - t0).count();
+                r->push_ops++;
+                r->overflows += (rc == RTPJitter::BUFFER_OVERFLOW) ? 1 : 0;
+            }
+        }
+
+        // pop at the packet rate, except during the overflow bursts
+        if ((i % 1000) >= 40) {
+            timepoint t0 = stdclock::now();
+            RTPJitter::RESULT rc = jitter.pop(out, arrival);
+            out.reset();
+            timepoint t1 = stdclock::now();
+            if (r) {
+                r->pop_ns += clocks::duration<double, nano>(t1 - t0).count();
+                r->pop_ops++;
+                r->dropped += (rc == RTPJitter::DROPPED_PACKET) ? 1 : 0;
+            }
+        }
+        if ((i % 20000) == 19999) {
+            jitter.reset();
+        }
+        arrival += clocks::milliseconds(PACKET_MS);
+    }
+}
+
+static result run(const unsigned packets)
+{
+    static fixed_pool   pool;
+    static fixed_jitter jitter(DEPTH_MS);
+    result              r;
+
+    memset(&r, 0, sizeof(r));
+    jitter.reset();
+
+    // warm the caches; only what follows is timed
+    stream(jitter, pool, 20000, nullptr);
+    stream(jitter, pool, packets, &r);
+    return r;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    packets = (argc > 1) ? atoi(argv[1]) : 200000;
+    unsigned    runs    = (argc > 2) ? atoi(argv[2]) : 5;
+
+    if (runs == 0) runs = 1;
+
+    // results go to the real stdout; library logging goes nowhere
+    FILE *out = fdopen(dup(fileno(stdout)), "w");
+    if ((out == nullptr) || (freopen("/dev/null", "w", stdout) == nullptr)) {
+        fprintf(stderr, "bench_fixed: could not redirect stdout\n");
+        return 1;
+    }
+
+    RTPLog::attach_thread();
+
+    vector<result> results;
+    for (unsigned i = 0; i < runs; ++i) {
+        results.push_back(run(packets));
+    }
+    sort(results.begin(), results.end(), [](const result& a, const result& b) {
+        return (a.push_ns + a.pop_ns) < (b.push_ns + b.pop_ns);
+    });
+    const result& r = results[results.size() / 2];
+
+    fprintf(out, "{\"bench\":\"rtp_fixed\",\"packets\":%u,\"runs\":%u,"
+                 "\"push_ns_per_op\":%.2f,\"pop_ns_per_op\":%.2f,"
+                 "\"push_ops\":%llu,\"pop_ops\":%llu,\"overflows\":%llu,\"dropped\":%llu}\n",
+            packets, runs,
+            r.push_ns / r.push_ops, r.pop_ns / r.pop_ops,
+            (unsigned long long)r.push_ops, (unsigned long long)r.pop_ops,
+            (unsigned long long)r.overflows, (unsigned long long)r.dropped);
+    fflush(out);
+    return 0;
+}
@@ -0,0 +1,169 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   compares the RTPG711 decode kernels for speed and agreement.
+*
+*   usage: bench_g711 [frames] [runs]
+*
+*   Decodes 'frames' 20 ms frames (160 bytes) of random mu-law and of A-law
+*   with each kernel this CPU supports, and then whole PCMU packets through
+*   decode() into pooled blocks.  One JSON object per law and kernel, e.g.
+*
+*       {"bench":"rtp_g711","law":"ulaw","kernel":"avx2","ns_per_sample":0.1, ...}
+*
+*   Every kernel is first checked against the scalar tables for all 256
+*   codes and for the random frame; the exit status is 1 if any disagree.
+*
+******************************************************************************/
+
+#include "rtp_g711.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+
+static const unsigned   FRAME = 160;
+
+typedef void (*decoder)(const uint8 *, int16 *, const unsigned, const RTPG711::kernel);
+
+static bool agrees(decoder decode, const RTPG711::kernel k, const uint8 *frame)
+{
+    uint8   codes[256 + 7];                 // and an odd tail for the scalar finish
+    int16   expect[sizeof(codes)], got[sizeof(codes)];
+
+    for (unsigned i = 0; i < sizeof(codes); ++i) {
+        codes[i] = (uint8)i;
+    }
+    decode(codes, expect, sizeof(codes), RTPG711::KERNEL_SCALAR);
+    decode(codes, got, sizeof(codes), k);
+    if (memcmp(expect, got, sizeof(expect)) != 0) {
+        return false;
+    }
+
+    decode(frame, expect, FRAME, RTPG711::KERNEL_SCALAR);
+    decode(frame, got, FRAME, k);
+    return memcmp(expect, got, FRAME * sizeof(int16)) == 0;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    frames = (argc > 1) ? atoi(argv[1]) : 1000000;
+    unsigned    runs   = (argc > 2) ? atoi(argv[2]) : 5;
+    mt19937     rng(12345);
+    uint8       frame[FRAME];
+    int16       pcm[FRAME];
+    int         status = 0;
+
+    if (runs == 0) runs = 1;
+    uniform_int_distribution<int> byte(0, 255);
+    for (unsigned i = 0; i < FRAME; ++i) {
+        frame[i] = (uint8)byte(rng);
+    }
+
+    const struct { const char *law; decoder decode; } laws[] = {
+        { "ulaw", RTPG711::decode_ulaw },
+        { "alaw", RTPG711::decode_alaw }
+    };
+    const RTPG711::kernel kernels[] = { RTPG711::KERNEL_SCALAR, RTPG711::KERNEL_SSE41, RTPG711::KERNEL_AVX2 };
+
+    for (const auto& law : laws) {
+        for (RTPG711::kernel k : kernels) {
+            if ((k > RTPG711::best()) && (k != RTPG711::KERNEL_SCALAR)) {
+                continue;   // not on this CPU
+            }
+
+            bool            ok = agrees(law.decode, k, frame);
+            vector<double>  ns;
+            uint64          sink = 0;
+
+            for (unsigned r = 0; r < runs; ++r) {
+                timepoint t0 = stdclock::now();
+                for (unsigned f = 0; f < frames; ++f) {
+                    law.decode(frame, pcm, FRAME, k);
+                    sink += (uint16)pcm[f % FRAME];
+                    __asm__ __volatile__("" : : "r"(pcm) : "memory");
+                }
+                timepoint t1 = stdclock::now();
+                ns.push_back(clocks::duration<double, nano>(t1 - t0).count() / ((double)frames * FRAME));
+            }
+            sort(ns.begin(), ns.end());
+
+            if (!ok) {
+                status = 1;
+            }
+            printf("{\"bench\":\"rtp_g711\",\"law\":\"%s\",\"kernel\":\"%s\",\"frame\":%u,\"frames\":%u,\"runs\":%u,"
+                   "\"ns_per_sample\":%.3f,\"agrees\":%s,\"sink\":%llu}\n",
+                   law.law, RTPG711::name(k), FRAME, frames, runs,
+                   ns[ns.size() / 2], ok ? "true" : "false", (unsigned long long)(sink & 0xff));
+            fflush(stdout);
+        }
+    }
+
+    // the pop path: whole packets into pooled blocks, as a playout thread would
+    {
+        uint8               data[RTP_HEADER_LENGTH + FRAME];
+        RTPBufferPool       pool(FRAME * sizeof(int16), 4);
+        vector<double>      ns;
+        uint64              sink = 0;
+
+        memset(data, 0, RTP_HEADER_LENGTH);
+        data[0] = RTP_VERSION << 6;
+        data[1] = RTP_PAYLOAD_G711U;
+        memcpy(data + RTP_HEADER_LENGTH, frame, FRAME);
+        RTPPacket packet(data, sizeof(data));
+
+        unsigned samples = 0;
+        shared_ptr<int16> out = RTPG711::decode(packet, pool, samples);
+        RTPG711::decode_ulaw(frame, pcm, FRAME, RTPG711::KERNEL_SCALAR);
+        bool ok = out && (samples == FRAME) && (memcmp(out.get(), pcm, sizeof(pcm)) == 0);
+        out.reset();
+
+        for (unsigned r = 0; r < runs; ++r) {
+            timepoint t0 = stdclock::now();
+            for (unsigned f = 0; f < frames; ++f) {
+                out = RTPG711::decode(packet, pool, samples);
+                sink += (uint16)out.get()[f % FRAME];
+            }
+            timepoint t1 = stdclock::now();
+            ns.push_back(clocks::duration<double, nano>(t1 - t0).count() / frames);
+        }
+        sort(ns.begin(), ns.end());
+
+        if (!ok) {
+            status = 1;
+        }
+        printf("{\"bench\":\"rtp_g711\",\"law\":\"ulaw\",\"kernel\":\"%s\",\"path\":\"packet_pooled\",\"frame\":%u,"
+               "\"frames\":%u,\"runs\":%u,\"ns_per_packet\":%.3f,\"agrees\":%s,\"sink\":%llu}\n",
+               RTPG711::name(RTPG711::KERNEL_AUTO), FRAME, frames, runs,
+               ns[ns.size() / 2], ok ? "true" : "false", (unsigned long long)(sink & 0xff));
+    }
+    return status;
+}
@@ -0,0 +1,157 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   loopback benchmark for GRO-aware receive in RTPIngest.
+*
+*   usage: bench_gro [seconds] [segments] [flows] [port]
+*
+*   Senders use UDP_SEGMENT to emit 'segments' RTP packets per send call.
+*   The receiver runs once with UDP_GRO off (kernel splits every segment into
+*   its own datagram) and once with it on (segments arrive coalesced, are
+*   copied into one right-sized block and split into views of it).  One line
+*   of output per mode:
+*
+*       gro=0|1  segments=N  flows=F  seconds=S  rx_pps=P  rx_dgram_ps=D
+*
+******************************************************************************/
+
+#include "rtp_ingest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const unsigned   PACKET_BYTES = 172;     // 20ms of G.711 plus header
+static const unsigned   MAX_SEGMENTS = 64;
+
+
+
+/******************************************************************************
+*   Sends 'segments' back-to-back RTP packets per send() on every socket
+*   until told to stop.  Each socket has UDP_SEGMENT set, so the kernel
+*   carries the whole run as one GSO datagram.
+******************************************************************************/
+static void sender(const vector<int> *sockets, const unsigned segments, atomic<bool> *run)
+{
+    vector<uint8>   buffer(PACKET_BYTES * segments, 0xff);
+    uint16          sequence = 0;
+    uint32          timestamp = 0;
+
+    while (run->load(memory_order_relaxed)) {
+        for (unsigned i = 0; i < segments; ++i) {
+            RTPHeader *rtp = reinterpret_cast<RTPHeader *>(&buffer[i * PACKET_BYTES]);
+            rtp->flags = htons(RTP_VERSION << 14);
+            rtp->sequence = htons(++sequence);
+            rtp->timestamp = htonl(timestamp += 160);
+            rtp->ssrc = htonl(0x1234);
+        }
+        for (int s : *sockets) {
+            send(s, buffer.data(), buffer.size(), MSG_DONTWAIT);
+        }
+    }
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    seconds  = (argc > 1) ? atoi(argv[1]) : 2;
+    unsigned    segments = (argc > 2) ? atoi(argv[2]) : 32;
+    unsigned    flows    = (argc > 3) ? atoi(argv[3]) : 16;
+    uint16      port     = (argc > 4) ? atoi(argv[4]) : 40100;
+
+    if (segments == 0) segments = 1;
+    if (segments > MAX_SEGMENTS) segments = MAX_SEGMENTS;
+
+    sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (int gro = 0; gro <= 1; ++gro) {
+        RTPIngest::config cfg;
+        cfg.address = "127.0.0.1";
+        cfg.port = port;
+        cfg.rcvbuf = 8 * 1024 * 1024;
+        cfg.gro = (gro != 0);
+        cfg.batch = gro ? 8 : 32;
+
+        RTPIngest ingest(cfg);
+        ingest.set_shard_callback([](RTPIngest::Shard& shard) {
+            rawrtp_ptr packet;
+            for (auto& flow : shard.flows()) {
+                while (flow.second->pop(packet) == RTPJitter::SUCCESS) {
+                }
+            }
+        });
+        if (!ingest.start()) {
+            fprintf(stderr, "bench_gro: could not start ingest on port %d\n", port);
+            return 1;
+        }
+
+        vector<int> sockets;
+        int         gso_size = PACKET_BYTES;
+        for (unsigned f = 0; f < flows; ++f) {
+            int s = socket(AF_INET, SOCK_DGRAM, 0);
+            if (setsockopt(s, SOL_UDP, UDP_SEGMENT, &gso_size, sizeof(gso_size)) < 0) {
+                fprintf(stderr, "bench_gro: UDP_SEGMENT not supported\n");
+                return 1;
+            }
+            connect(s, reinterpret_cast<sockaddr *>(&to), sizeof(to));
+            sockets.push_back(s);
+        }
+
+        atomic<bool>    run(true);
+        thread          t(sender, &sockets, segments, &run);
+
+        this_thread::sleep_for(clocks::milliseconds(200));
+        uint64      start_packets = ingest.packets();
+        uint64      start_datagrams = ingest.datagrams();
+        timepoint   start = stdclock::now();
+
+        this_thread::sleep_for(clocks::seconds(seconds));
+
+        double elapsed = clocks::duration<double>(stdclock::now() - start).count();
+        uint64 packets = ingest.packets() - start_packets;
+        uint64 datagrams = ingest.datagrams() - start_datagrams;
+
+        run = false;
+        t.join();
+        ingest.stop();
+        for (int s : sockets) {
+            close(s);
+        }
+
+        printf("gro=%d  segments=%u  flows=%u  seconds=%.2f  rx_pps=%.0f  rx_dgram_ps=%.0f\n",
+               gro, segments, flows, elapsed, packets / elapsed, datagrams / elapsed);
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   loopback scaling benchmark for RTPIngest.
+*
+*   usage: bench_ingest [max_shards] [seconds] [flows] [port]
+*
+*   For 1..max_shards receive shards, blasts RTP packets at 127.0.0.1 from
+*   'flows' distinct source ports and reports the receive rate.  One line of
+*   output per shard count:
+*
+*       shards=N  flows=F  seconds=S  rx_pps=P  rx_mbps=M
+*
+******************************************************************************/
+
+#include "rtp_ingest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const unsigned   PACKET_BYTES = 172;     // 20ms of G.711 plus header
+static const unsigned   SEND_BATCH   = 32;
+
+
+
+/******************************************************************************
+*   Sends from a set of sockets (one per flow) until told to stop.
+******************************************************************************/
+static void sender(const vector<int> *sockets, const sockaddr_in *to, atomic<bool> *run)
+{
+    uint8       packet[PACKET_BYTES];
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(packet);
+    mmsghdr     msgs[SEND_BATCH];
+    iovec       iov;
+    uint16      sequence = 0;
+    uint32      timestamp = 0;
+
+    memset(packet, 0xff, sizeof(packet));
+    rtp->flags = htons(RTP_VERSION << 14);
+    rtp->ssrc = htonl(0x1234);
+
+    iov.iov_base = packet;
+    iov.iov_len = sizeof(packet);
+    for (unsigned i = 0; i < SEND_BATCH; ++i) {
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_name = (void *)to;
+        msgs[i].msg_hdr.msg_namelen = sizeof(*to);
+        msgs[i].msg_hdr.msg_iov = &iov;
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (run->load(memory_order_relaxed)) {
+        rtp->sequence = htons(++sequence);
+        rtp->timestamp = htonl(timestamp += 160);
+        for (int s : *sockets) {
+            sendmmsg(s, msgs, SEND_BATCH, MSG_DONTWAIT);
+        }
+    }
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    max_shards = (argc > 1) ? atoi(argv[1]) : thread::hardware_concurrency();
+    unsigned    seconds    = (argc > 2) ? atoi(argv[2]) : 2;
+    unsigned    flows      = (argc > 3) ? atoi(argv[3]) : 64;
+    uint16      port       = (argc > 4) ? atoi(argv[4]) : 40000;
+
+    if (max_shards == 0) max_shards = 1;
+
+    sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (unsigned shards = 1; shards <= max_shards; ++shards) {
+        RTPIngest::config cfg;
+        cfg.address = "127.0.0.1";
+        cfg.port = port;
+        cfg.shards = shards;
+        cfg.first_cpu = 0;
+        cfg.rcvbuf = 4 * 1024 * 1024;
+
+        RTPIngest ingest(cfg);
+
+        // keep every buffer drained from its own shard thread
+        ingest.set_shard_callback([](RTPIngest::Shard& shard) {
+            rawrtp_ptr packet;
+            for (auto& flow : shard.flows()) {
+                while (flow.second->pop(packet) == RTPJitter::SUCCESS) {
+                }
+            }
+        });
+        if (!ingest.start()) {
+            fprintf(stderr, "bench_ingest: could not start ingest on port %d\n", port);
+            return 1;
+        }
+
+        // one sender thread per shard, flows spread across them
+        unsigned            senders = shards;
+        vector<vector<int>> sockets(senders);
+        for (unsigned f = 0; f < flows; ++f) {
+            int s = socket(AF_INET, SOCK_DGRAM, 0);
+            connect(s, reinterpret_cast<sockaddr *>(&to), sizeof(to));
+            sockets[f % senders].push_back(s);
+        }
+
+        atomic<bool>    run(true);
+        vector<thread>  threads;
+        for (unsigned i = 0; i < senders; ++i) {
+            threads.push_back(thread(sender, &sockets[i], &to, &run));
+        }
+
+        // let the pipeline fill before measuring
+        this_thread::sleep_for(clocks::milliseconds(200));
+        uint64      start_packets = ingest.packets();
+        uint64      start_bytes = ingest.bytes();
+        timepoint   start = stdclock::now();
+
+        this_thread::sleep_for(clocks::seconds(seconds));
+
+        double elapsed = clocks::duration<double>(stdclock::now() - start).count();
+        uint64 packets = ingest.packets() - start_packets;
+        uint64 bytes = ingest.bytes() - start_bytes;
+
+        run = false;
+        for (auto& t : threads) {
+            t.join();
+        }
+        ingest.stop();
+        for (auto& group : sockets) {
+            for (int s : group) {
+                close(s);
+            }
+        }
+
+        printf("shards=%u  flows=%u  seconds=%.2f  rx_pps=%.0f  rx_mbps=%.1f\n",
+               shards, flows, elapsed, packets / elapsed, (bytes * 8.0) / elapsed / 1e6);
+        fflush(stdout);
+    }
+    return 0;
+}
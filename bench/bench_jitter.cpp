@@ -0,0 +1,323 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   micro-benchmarks for RTPJitter push()/pop() under realistic traffic.
+*
+*   usage: bench_jitter [packets] [runs] [scenario]
+*
+*   Each scenario synthesizes a stream of 20ms packets, pre-fills a 60ms
+*   buffer, then pushes in chunks and pops at the scenario's rate, timing
+*   push() and pop() separately and counting heap allocations made inside
+*   each.  One JSON object per scenario is written to stdout (the median
+*   run), e.g.
+*
+*       {"bench":"rtp_jitter","scenario":"in_order","packets":200000,
+*        "runs":5,"push_ns_per_op":41.2,"pop_ns_per_op":37.9,
+*        "push_allocs_per_op":0.03,"pop_allocs_per_op":0.00, ...}
+*
+*   so that results can be diffed/compared between versions.  Anything the
+*   library logs while under test is discarded.
+*
+*   in_order hands each packet to push() with std::move(); in_order_copied
+*   is the same traffic from a caller that keeps its own reference, which
+*   costs a reference count round trip per packet.  Popped packets are let
+*   go outside the timed region in both, so neither pays for freeing them.
+*
+******************************************************************************/
+
+#include "rtp_jitter.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+// - allocation counting -------------------------------------------------------
+
+static uint64 allocations = 0;
+
+void *operator new(size_t size)
+{
+    ++allocations;
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    ++allocations;
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept             { free(p); }
+void operator delete[](void *p) noexcept           { free(p); }
+void operator delete(void *p, size_t) noexcept     { free(p); }
+void operator delete[](void *p, size_t) noexcept   { free(p); }
+
+
+// - scenarios ----------------------------------------------------------------
+
+static const unsigned   PACKET_BYTES = 172;
+static const unsigned   PACKET_MS    = 20;
+static const unsigned   DEPTH_MS     = 60;
+static const unsigned   MAX_DEPTH_MS = 200;
+static const unsigned   CHUNK        = 4;
+
+struct scenario
+{
+    const char *name;
+    unsigned    pops_per_chunk;         // pop() calls after each chunk of pushes
+    function<void(vector<uint16>& seqs, const unsigned n, mt19937& rng)> make;
+    bool        residence;              // track residence time
+    bool        unlocked;               // RTPJitterUnlocked rather than RTPJitter
+    bool        copied;                 // push() copies, the caller keeps a reference
+};
+
+static void in_order(vector<uint16>& seqs, const unsigned n, uint16 first)
+{
+    for (unsigned i = 0; i < n; ++i) {
+        seqs.push_back((uint16)(first + i));
+    }
+}
+
+static void reorder(vector<uint16>& seqs, const unsigned n, const unsigned k)
+{
+    // every (k+1)th packet arrives k places late
+    in_order(seqs, n, 0);
+    for (unsigned i = 0; i + k < n; i += (k + 1)) {
+        rotate(seqs.begin() + i, seqs.begin() + i + 1, seqs.begin() + i + k + 1);
+    }
+}
+
+static vector<scenario> scenarios()
+{
+    vector<scenario> list;
+
+    list.push_back({ "in_order", CHUNK, [](vector<uint16>& s, const unsigned n, mt19937&) {
+        in_order(s, n, 0);
+    }});
+    list.push_back({ "in_order_residence", CHUNK, [](vector<uint16>& s, const unsigned n, mt19937&) {
+        in_order(s, n, 0);
+    }, true });
+    list.push_back({ "in_order_unlocked", CHUNK, [](vector<uint16>& s, const unsigned n, mt19937&) {
+        in_order(s, n, 0);
+    }, false, true });
+    list.push_back({ "in_order_copied", CHUNK, [](vector<uint16>& s, const unsigned n, mt19937&) {
+        in_order(s, n, 0);
+    }, false, false, true });
+    list.push_back({ "reorder_depth_1", CHUNK, [](vector<uint16>& s, const unsigned n, mt19937&) {
+        reorder(s, n, 1);
+    }});
+    list.push_back({ "reorder_depth_3", CHUNK, [](vector<uint16>& s, const unsigned n, mt19937&) {
+        reorder(s, n, 3);
+    }});
+    list.push_back({ "random_loss_5pct", CHUNK, [](vector<uint16>& s, const unsigned n, mt19937& rng) {
+        uniform_int_distribution<int> pct(0, 99);
+        for (unsigned i = 0; i < n; ++i) {
+            if (pct(rng) >= 5) s.push_back((uint16)i);
+        }
+    }});
+    list.push_back({ "burst_loss_5x100", CHUNK, [](vector<uint16>& s, const unsigned n, mt19937&) {
+        for (unsigned i = 0; i < n; ++i) {
+            if ((i % 100) >= 5) s.push_back((uint16)i);
+        }
+    }});
+    list.push_back({ "wraparound", CHUNK, [](vector<uint16>& s, const unsigned n, mt19937&) {
+        in_order(s, n, (uint16)(65536 - 64));
+    }});
+    list.push_back({ "duplicates_10pct", CHUNK, [](vector<uint16>& s, const unsigned n, mt19937&) {
+        for (unsigned i = 0; i < n; ++i) {
+            s.push_back((uint16)i);
+            if ((i % 10) == 0) s.push_back((uint16)i);
+        }
+    }});
+    list.push_back({ "overflow", CHUNK / 2, [](vector<uint16>& s, const unsigned n, mt19937&) {
+        in_order(s, n, 0);
+    }});
+    list.push_back({ "rebuffering", CHUNK * 2, [](vector<uint16>& s, const unsigned n, mt19937&) {
+        in_order(s, n, 0);
+    }});
+    return list;
+}
+
+
+// - measurement --------------------------------------------------------------
+
+struct result
+{
+    double  push_ns;
+    double  pop_ns;
+    uint64  push_ops;
+    uint64  pop_ops;
+    uint64  push_allocs;
+    uint64  pop_allocs;
+    uint64  pop_codes[RTPJitter::DROPPED_PACKET + 1];
+};
+
+static rawrtp_ptr make_packet(const uint16 sequence)
+{
+    uint8       data[PACKET_BYTES];
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(data);
+
+    memset(data, 0xff, sizeof(data));
+    rtp->flags = htons(RTP_VERSION << 14);
+    rtp->sequence = htons(sequence);
+    rtp->timestamp = htonl((uint32)sequence * 160);
+    rtp->ssrc = htonl(0x1234);
+
+    rawrtp_ptr packet = make_shared<RTPPacket>(data, sizeof(data));
+    packet->payload_ms = PACKET_MS;
+    packet->payload_bytes = PACKET_BYTES - RTP_HEADER_LENGTH;
+    return packet;
+}
+
+template<class Jitter>
+static result run(const scenario& sc, const vector<uint16>& seqs)
+{
+    result      r;
+    Jitter      jitter(DEPTH_MS);
+
+    memset(&r, 0, sizeof(r));
+    jitter.set_depth(DEPTH_MS, MAX_DEPTH_MS);
+    jitter.track_residence(sc.residence);
+
+    // build every packet up front so only the buffer is measured
+    vector<rawrtp_ptr> popped(sc.pops_per_chunk);
+    vector<rawrtp_ptr> packets;
+    packets.reserve(seqs.size());
+    for (uint16 sequence : seqs) {
+        packets.push_back(make_packet(sequence));
+    }
+
+    // fill to the nominal depth first so we measure the steady state
+    timepoint   arrival = stdclock::now();
+    size_t      prefill = min(packets.size(), (size_t)(DEPTH_MS / PACKET_MS));
+    for (size_t i = 0; i < prefill; ++i) {
+        jitter.push(move(packets[i]), arrival);
+    }
+
+    for (size_t i = prefill; i < packets.size(); i += CHUNK) {
+        size_t end = min(packets.size(), i + CHUNK);
+
+        uint64      a0 = allocations;
+        timepoint   t0 = stdclock::now();
+        for (size_t k = i; k < end; ++k) {
+            if (sc.copied) {
+                jitter.push(packets[k], arrival);
+            } else {
+                jitter.push(move(packets[k]), arrival);
+            }
+        }
+        timepoint   t1 = stdclock::now();
+        r.push_allocs += allocations - a0;
+        r.push_ns += clocks::duration<double, nano>(t1 - t0).count();
+        r.push_ops += (end - i);
+
+        a0 = allocations;
+        t0 = stdclock::now();
+        for (unsigned k = 0; k < sc.pops_per_chunk; ++k) {
+            r.pop_codes[jitter.pop(popped[k])]++;
+        }
+        t1 = stdclock::now();
+        r.pop_allocs += allocations - a0;
+        r.pop_ns += clocks::duration<double, nano>(t1 - t0).count();
+        r.pop_ops += sc.pops_per_chunk;
+
+        // let go of what was popped outside the timing, so freeing a
+        //  packet is not charged to pop() when the caller moved it in
+        for (unsigned k = 0; k < sc.pops_per_chunk; ++k) {
+            popped[k].reset();
+        }
+
+        arrival += clocks::milliseconds(PACKET_MS * CHUNK);
+    }
+    return r;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    packets = (argc > 1) ? atoi(argv[1]) : 200000;
+    unsigned    runs    = (argc > 2) ? atoi(argv[2]) : 5;
+    string      only    = (argc > 3) ? argv[3] : "";
+
+    if (runs == 0) runs = 1;
+
+    // results go to the real stdout; library logging goes nowhere
+    FILE *out = fdopen(dup(fileno(stdout)), "w");
+    if ((out == nullptr) || (freopen("/dev/null", "w", stdout) == nullptr)) {
+        fprintf(stderr, "bench_jitter: could not redirect stdout\n");
+        return 1;
+    }
+
+    mt19937 rng(12345);
+    for (const scenario& sc : scenarios()) {
+        if (!only.empty() && (only != sc.name)) {
+            continue;
+        }
+
+        vector<uint16> seqs;
+        sc.make(seqs, packets, rng);
+
+        vector<result> results;
+        for (unsigned i = 0; i < runs; ++i) {
+            results.push_back(sc.unlocked ? run<RTPJitterUnlocked>(sc, seqs) : run<RTPJitter>(sc, seqs));
+        }
+        sort(results.begin(), results.end(), [](const result& a, const result& b) {
+            return (a.push_ns + a.pop_ns) < (b.push_ns + b.pop_ns);
+        });
+        const result& r = results[results.size() / 2];
+
+        fprintf(out, "{\"bench\":\"rtp_jitter\",\"scenario\":\"%s\",\"packets\":%u,\"runs\":%u,"
+                     "\"push_ns_per_op\":%.2f,\"pop_ns_per_op\":%.2f,"
+                     "\"push_allocs_per_op\":%.3f,\"pop_allocs_per_op\":%.3f,"
+                     "\"push_ops\":%llu,\"pop_ops\":%llu,"
+                     "\"pop_success\":%llu,\"pop_buffering\":%llu,\"pop_dropped\":%llu}\n",
+                sc.name, packets, runs,
+                r.push_ns / r.push_ops, r.pop_ns / r.pop_ops,
+                (double)r.push_allocs / r.push_ops, (double)r.pop_allocs / r.pop_ops,
+                (unsigned long long)r.push_ops, (unsigned long long)r.pop_ops,
+                (unsigned long long)r.pop_codes[RTPJitter::SUCCESS],
+                (unsigned long long)r.pop_codes[RTPJitter::BUFFERING],
+                (unsigned long long)r.pop_codes[RTPJitter::DROPPED_PACKET]);
+        fflush(out);
+    }
+    return 0;
+}
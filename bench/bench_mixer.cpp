@@ -0,0 +1,235 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   conference mixing throughput and correctness for RTPMixer.
+*
+*   usage: bench_mixer [mixes] [runs]
+*
+*   First the mix_minus() kernels on their own, for conferences of 10, 100
+*   and 500 participants with everybody talking and with 3 talkers, on loud
+*   random frames so that saturation is exercised.  Then whole mix() calls
+*   over 100 RTPJitter buffers fed 20 ms PCMU packets with 5% loss, which
+*   includes the pop() and G.711 decode of every participant.  One JSON
+*   object per case, e.g.
+*
+*       {"bench":"rtp_mixer","kernel":"avx2","participants":500,"talkers":3,
+*        "ns_per_mix":1800.0,"participants_per_core":5500000, ...}
+*
+*   where participants_per_core is how many a core could mix every 20 ms at
+*   that rate.  Every kernel is checked against a direct sum of the other
+*   participants for each of them; the exit status is 1 on any difference.
+*   Anything the library logs is discarded.
+*
+******************************************************************************/
+
+#include "rtp_mixer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+static const unsigned   FRAME = 160;
+static const unsigned   PACKET_MS = 20;
+
+// what participant 'me' should hear, the slow way
+static bool check(const vector<int16>& in, const vector<uint8>& talking, const unsigned count,
+                  const vector<int16>& out, const vector<int16>& everyone)
+{
+    for (unsigned me = 0; me < count; ++me) {
+        for (unsigned s = 0; s < FRAME; ++s) {
+            int32 sum = 0;
+            for (unsigned i = 0; i < count; ++i) {
+                if (talking[i] && (i != me)) {
+                    sum += in[i * FRAME + s];
+                }
+            }
+            int16 expect = (int16)max(min(sum, (int32)INT16_MAX), (int32)INT16_MIN);
+            int16 got = talking[me] ? out[me * FRAME + s] : everyone[s];
+            if (got != expect) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static int kernels(FILE *out, const unsigned mixes, const unsigned runs, mt19937& rng)
+{
+    const unsigned  sizes[] = { 10, 100, 500 };
+    const RTPMixer::kernel kernels[] = { RTPMixer::KERNEL_SCALAR, RTPMixer::KERNEL_SSE41, RTPMixer::KERNEL_AVX2 };
+    uniform_int_distribution<int> sample(-12000, 12000);
+    int status = 0;
+
+    for (unsigned count : sizes) {
+        for (unsigned talkers : { count, 3u }) {
+            vector<int16>   in(count * FRAME), pcm(count * FRAME), everyone(FRAME);
+            vector<uint8>   talking(count, 0);
+            vector<int32>   sum(FRAME);
+
+            for (int16& s : in) {
+                s = (int16)sample(rng);
+            }
+            for (unsigned i = 0; i < talkers; ++i) {
+                talking[(i * count) / talkers] = 1;
+            }
+
+            for (RTPMixer::kernel k : kernels) {
+                if ((k > RTPMixer::best()) && (k != RTPMixer::KERNEL_SCALAR)) {
+                    continue;   // not on this CPU
+                }
+
+                RTPMixer::mix_minus(in.data(), talking.data(), count, FRAME, sum.data(), pcm.data(), everyone.data(), k);
+                bool ok = check(in, talking, count, pcm, everyone);
+                if (!ok) {
+                    status = 1;
+                }
+
+                // keep the big conferences to the same total work
+                unsigned n = max(1u, mixes / count);
+                vector<double> ns;
+                for (unsigned r = 0; r < runs; ++r) {
+                    timepoint t0 = stdclock::now();
+                    for (unsigned m = 0; m < n; ++m) {
+                        RTPMixer::mix_minus(in.data(), talking.data(), count, FRAME,
+                                            sum.data(), pcm.data(), everyone.data(), k);
+                        __asm__ __volatile__("" : : "r"(pcm.data()) : "memory");
+                    }
+                    timepoint t1 = stdclock::now();
+                    ns.push_back(clocks::duration<double, nano>(t1 - t0).count() / n);
+                }
+                sort(ns.begin(), ns.end());
+
+                double per_mix = ns[ns.size() / 2];
+                fprintf(out, "{\"bench\":\"rtp_mixer\",\"path\":\"mix_minus\",\"kernel\":\"%s\",\"participants\":%u,"
+                             "\"talkers\":%u,\"frame\":%u,\"mixes\":%u,\"runs\":%u,\"ns_per_mix\":%.1f,"
+                             "\"participants_per_core\":%.0f,\"agrees\":%s}\n",
+                        RTPMixer::name(k), count, talkers, FRAME, n, runs, per_mix,
+                        count * (PACKET_MS * 1e6 / per_mix), ok ? "true" : "false");
+                fflush(out);
+            }
+        }
+    }
+    return status;
+}
+
+static rawrtp_ptr make_packet(const uint16 sequence, const uint8 *payload)
+{
+    uint8       data[RTP_HEADER_LENGTH + FRAME];
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(data);
+
+    rtp->flags = htons((RTP_VERSION << 14) | RTP_PAYLOAD_G711U);
+    rtp->sequence = htons(sequence);
+    rtp->timestamp = htonl((uint32)sequence * FRAME);
+    rtp->ssrc = htonl(0x1234);
+    memcpy(data + RTP_HEADER_LENGTH, payload, FRAME);
+    return make_shared<RTPPacket>(data, sizeof(data));
+}
+
+static void conference(FILE *out, const unsigned mixes, const unsigned runs, mt19937& rng)
+{
+    const unsigned  count = 100;
+    uniform_int_distribution<int> byte(0, 255), pct(0, 99);
+    uint8           payload[FRAME];
+
+    for (uint8& b : payload) {
+        b = (uint8)byte(rng);
+    }
+
+    vector<double>  ns;
+    uint64          results[RTPJitter::DROPPED_PACKET + 1] = { 0 };
+    uint64          talkers = 0;
+
+    for (unsigned r = 0; r < runs; ++r) {
+        vector<unique_ptr<RTPJitter>>   buffers;
+        vector<RTPMixer::participant_id> ids;
+        RTPMixer    mixer(FRAME);
+        timepoint   now = stdclock::now();
+        double      total = 0;
+
+        for (unsigned i = 0; i < count; ++i) {
+            buffers.emplace_back(new RTPJitter(3 * PACKET_MS));
+            ids.push_back(mixer.add(buffers.back().get()));
+        }
+
+        for (unsigned m = 0; m < mixes; ++m) {
+            for (auto& b : buffers) {
+                if (pct(rng) >= 5) {
+                    b->push(make_packet((uint16)m, payload), now);
+                }
+            }
+
+            timepoint t0 = stdclock::now();
+            talkers += mixer.mix(now);
+            timepoint t1 = stdclock::now();
+            total += clocks::duration<double, nano>(t1 - t0).count();
+
+            for (RTPMixer::participant_id id : ids) {
+                results[mixer.result(id)]++;
+            }
+            now += clocks::milliseconds(PACKET_MS);
+        }
+        ns.push_back(total / mixes);
+    }
+    sort(ns.begin(), ns.end());
+
+    double per_mix = ns[ns.size() / 2];
+    fprintf(out, "{\"bench\":\"rtp_mixer\",\"path\":\"mix\",\"kernel\":\"%s\",\"participants\":%u,\"frame\":%u,"
+                 "\"mixes\":%u,\"runs\":%u,\"ns_per_mix\":%.1f,\"participants_per_core\":%.0f,"
+                 "\"talkers_per_mix\":%.1f,\"pop_success\":%llu,\"pop_buffering\":%llu,\"pop_dropped\":%llu}\n",
+            RTPMixer::name(RTPMixer::KERNEL_AUTO), count, FRAME, mixes, runs, per_mix,
+            count * (PACKET_MS * 1e6 / per_mix), (double)talkers / ((double)mixes * runs),
+            (unsigned long long)results[RTPJitter::SUCCESS],
+            (unsigned long long)results[RTPJitter::BUFFERING],
+            (unsigned long long)results[RTPJitter::DROPPED_PACKET]);
+    fflush(out);
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    mixes = (argc > 1) ? atoi(argv[1]) : 20000;
+    unsigned    runs  = (argc > 2) ? atoi(argv[2]) : 5;
+    mt19937     rng(12345);
+
+    if (mixes == 0) mixes = 1;
+    if (runs == 0) runs = 1;
+
+    // results go to the real stdout; library logging goes nowhere
+    FILE *out = fdopen(dup(fileno(stdout)), "w");
+    if ((out == nullptr) || (freopen("/dev/null", "w", stdout) == nullptr)) {
+        fprintf(stderr, "bench_mixer: could not redirect stdout\n");
+        return 1;
+    }
+
+    int status = kernels(out, mixes, runs, rng);
+    conference(out, mixes / 10, runs, rng);
+    return status;
+}
@@ -0,0 +1,186 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   compares the RTPHeaderBatch kernels for speed and agreement.
+*
+*   usage: bench_parse [batches] [runs]
+*
+*   Builds a receive batch of RTPHeaderBatch::MAX packets -- random headers,
+*   mostly valid, some with the wrong version, CSRC lists longer than the
+*   packet, or too short to hold a header at all -- and parses it 'batches'
+*   times with each kernel this CPU supports, plus a baseline of one
+*   ntohs()/ntohl() per field as push() used to do.  One JSON object per
+*   kernel, e.g.
+*
+*       {"bench":"rtp_parse","kernel":"avx2","batch":64,"ns_per_header":0.9, ...}
+*
+*   Every kernel's output is checked against the scalar kernel's; the exit
+*   status is 1 if any of them disagree.
+*
+******************************************************************************/
+
+#include "rtp_parse.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <arpa/inet.h>
+
+using namespace std;
+
+
+static const unsigned   BATCH = RTPHeaderBatch::MAX;
+
+struct packets
+{
+    vector<uint8>   storage;
+    const uint8    *data[BATCH];
+    uint32          lengths[BATCH];
+};
+
+static void make_packets(packets& p, mt19937& rng)
+{
+    uniform_int_distribution<int> byte(0, 255), pct(0, 99);
+
+    p.storage.assign(BATCH * 256, 0);
+    for (unsigned i = 0; i < BATCH; ++i) {
+        uint8 *h = &p.storage[i * 256];
+
+        for (unsigned k = 0; k < 256; ++k) {
+            h[k] = (uint8)byte(rng);
+        }
+        h[0] = (uint8)((RTP_VERSION << 6) | (h[0] & 0x3f));
+        p.lengths[i] = 172;
+
+        int kind = pct(rng);
+        if (kind < 5) {
+            h[0] = (uint8)(h[0] & 0x3f);                    // version 0
+        } else if (kind < 10) {
+            h[0] = (uint8)((h[0] & 0xf0) | 0x0f);           // 15 CSRCs ...
+            p.lengths[i] = RTP_HEADER_LENGTH + 40;          // ... but room for 10
+        } else if (kind < 13) {
+            p.lengths[i] = (uint32)(kind - 10) * 4;         // shorter than a header
+        } else if (kind < 15) {
+            p.lengths[i] = 0;
+            h = nullptr;
+        }
+        p.data[i] = h;
+    }
+}
+
+// the per-field conversions push() made before the batch kernels
+static void parse_fields(RTPHeaderBatch& out, const packets& p)
+{
+    for (unsigned i = 0; i < BATCH; ++i) {
+        const RTPHeader *rtp = reinterpret_cast<const RTPHeader *>(p.data[i]);
+        if ((rtp == nullptr) || (p.lengths[i] < RTP_HEADER_LENGTH)) {
+            out.valid[i] = 0;
+            continue;
+        }
+        uint16 flags = ntohs(rtp->flags);
+        out.sequence[i] = ntohs(rtp->sequence);
+        out.timestamp[i] = ntohl(rtp->timestamp);
+        out.ssrc[i] = ntohl(rtp->ssrc);
+        out.payload_type[i] = flags & RTP_FLAGS_PAYLOAD_TYPE;
+        out.marker[i] = (flags & RTP_FLAGS_MARKER_BIT) ? 1 : 0;
+        out.csrc_count[i] = (flags & RTP_FLAGS_CSRC_COUNT) >> 8;
+        out.valid[i] = ((flags >> 14) == RTP_VERSION)
+                    && (p.lengths[i] >= (uint32)(RTP_HEADER_LENGTH + 4 * out.csrc_count[i]));
+    }
+    out.count = BATCH;
+}
+
+static bool same(const RTPHeaderBatch& a, const RTPHeaderBatch& b)
+{
+    for (unsigned i = 0; i < BATCH; ++i) {
+        if (a.valid[i] != b.valid[i]) {
+            return false;
+        }
+        if (a.valid[i]
+         && ((a.sequence[i] != b.sequence[i]) || (a.timestamp[i] != b.timestamp[i])
+          || (a.ssrc[i] != b.ssrc[i]) || (a.payload_type[i] != b.payload_type[i])
+          || (a.marker[i] != b.marker[i]) || (a.csrc_count[i] != b.csrc_count[i])))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    batches = (argc > 1) ? atoi(argv[1]) : 200000;
+    unsigned    runs    = (argc > 2) ? atoi(argv[2]) : 5;
+    mt19937     rng(12345);
+    packets     p;
+    int         status = 0;
+
+    if (runs == 0) runs = 1;
+    make_packets(p, rng);
+
+    RTPHeaderBatch reference;
+    reference.parse(p.data, p.lengths, BATCH, RTPHeaderBatch::KERNEL_SCALAR);
+
+    const int kernels[] = { -1, RTPHeaderBatch::KERNEL_SCALAR, RTPHeaderBatch::KERNEL_SSE41, RTPHeaderBatch::KERNEL_AVX2 };
+    for (int k : kernels) {
+        RTPHeaderBatch::kernel kernel = (RTPHeaderBatch::kernel)k;
+        if ((k > RTPHeaderBatch::best()) && (k != RTPHeaderBatch::KERNEL_SCALAR)) {
+            continue;   // not on this CPU
+        }
+
+        RTPHeaderBatch  out;
+        vector<double>  ns;
+        uint64          sink = 0;
+
+        for (unsigned r = 0; r < runs; ++r) {
+            timepoint t0 = stdclock::now();
+            for (unsigned b = 0; b < batches; ++b) {
+                if (k < 0) {
+                    parse_fields(out, p);
+                } else {
+                    out.parse(p.data, p.lengths, BATCH, kernel);
+                }
+                sink += out.sequence[b % BATCH];
+                __asm__ __volatile__("" : : "r"(&out) : "memory");
+            }
+            timepoint t1 = stdclock::now();
+            ns.push_back(clocks::duration<double, nano>(t1 - t0).count() / ((double)batches * BATCH));
+        }
+        sort(ns.begin(), ns.end());
+
+        bool agrees = same(out, reference);
+        if (!agrees) {
+            status = 1;
+        }
+        printf("{\"bench\":\"rtp_parse\",\"kernel\":\"%s\",\"batch\":%u,\"batches\":%u,\"runs\":%u,"
+               "\"ns_per_header\":%.3f,\"agrees\":%s,\"sink\":%llu}\n",
+               (k < 0) ? "ntoh_per_field" : RTPHeaderBatch::name(kernel), BATCH, batches, runs,
+               ns[ns.size() / 2], agrees ? "true" : "false", (unsigned long long)(sink & 0xff));
+        fflush(stdout);
+    }
+    return status;
+}
@@ -0,0 +1,153 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   RTPResampler throughput and agreement between kernels.
+*
+*   usage: bench_resample [seconds] [runs]
+*
+*   Converts 'seconds' of audio, in 20 ms frames, for each common rate pair
+*   with each kernel this CPU supports.  One JSON object per pair and kernel,
+*   e.g.
+*
+*       {"bench":"rtp_resample","in_rate":8000,"out_rate":48000,"kernel":"avx2",
+*        "in_samples_per_sec":1.2e8,"streams_per_core":15000, ...}
+*
+*   where streams_per_core is how many real-time streams of that pair one
+*   core keeps up with.  The output of every kernel must match the scalar
+*   kernel's exactly, and the frame by frame output must match converting
+*   the whole signal in one call (the filter state carries across frames);
+*   the exit status is 1 otherwise.  'gain' is the RMS level of a 1 kHz tone
+*   after conversion relative to before, and should be close to 1.
+*
+******************************************************************************/
+
+#include "rtp_resample.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+
+static const unsigned   FRAME_MS = 20;
+
+static vector<int16> convert(RTPResampler& r, const vector<int16>& in, const unsigned frame)
+{
+    vector<int16>   out(r.max_output((unsigned)in.size()) + in.size() / frame + 1);
+    unsigned        written = 0;
+
+    for (size_t i = 0; i < in.size(); i += frame) {
+        unsigned n = (unsigned)min((size_t)frame, in.size() - i);
+        written += r.process(&in[i], n, &out[written], (unsigned)out.size() - written);
+    }
+    out.resize(written);
+    return out;
+}
+
+static double rms(const vector<int16>& x, const size_t from, const size_t to)
+{
+    double sum = 0;
+    for (size_t i = from; i < to; ++i) {
+        sum += (double)x[i] * x[i];
+    }
+    return sqrt(sum / (double)(to - from));
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    seconds = (argc > 1) ? atoi(argv[1]) : 20;
+    unsigned    runs    = (argc > 2) ? atoi(argv[2]) : 5;
+    mt19937     rng(12345);
+    int         status = 0;
+
+    if (seconds == 0) seconds = 1;
+    if (runs == 0) runs = 1;
+
+    const struct { uint32 in, out; } pairs[] = {
+        { 8000, 16000 }, { 8000, 48000 }, { 16000, 48000 }, { 44100, 48000 }, { 48000, 8000 }
+    };
+    const RTPResampler::kernel kernels[] = { RTPResampler::KERNEL_SCALAR, RTPResampler::KERNEL_SSE41,
+                                             RTPResampler::KERNEL_AVX2 };
+    normal_distribution<double> noise(0, 4000);
+
+    for (const auto& pair : pairs) {
+        unsigned        frame = pair.in * FRAME_MS / 1000;
+        vector<int16>   signal(pair.in * seconds), tone(pair.in);
+
+        for (size_t i = 0; i < signal.size(); ++i) {
+            double x = 8000 * sin(2 * M_PI * 440.0 * i / pair.in) + noise(rng);
+            signal[i] = (int16)max(-32768.0, min(32767.0, x));
+        }
+        for (size_t i = 0; i < tone.size(); ++i) {
+            tone[i] = (int16)(10000 * sin(2 * M_PI * 1000.0 * i / pair.in));
+        }
+
+        RTPResampler    whole(pair.in, pair.out, 16, RTPResampler::KERNEL_SCALAR);
+        vector<int16>   reference = convert(whole, signal, (unsigned)signal.size());
+
+        RTPResampler    gain_check(pair.in, pair.out);
+        vector<int16>   toned = convert(gain_check, tone, frame);
+        double          gain = rms(toned, toned.size() / 4, toned.size()) / rms(tone, tone.size() / 4, tone.size());
+
+        for (RTPResampler::kernel k : kernels) {
+            if ((k > RTPResampler::best()) && (k != RTPResampler::KERNEL_SCALAR)) {
+                continue;   // not on this CPU
+            }
+
+            vector<double>  ns;
+            bool            ok = true;
+            unsigned        taps = 0;
+
+            for (unsigned r = 0; r < runs; ++r) {
+                RTPResampler resampler(pair.in, pair.out, 16, k);
+                taps = resampler.taps_per_phase();
+
+                timepoint t0 = stdclock::now();
+                vector<int16> out = convert(resampler, signal, frame);
+                timepoint t1 = stdclock::now();
+                ns.push_back(clocks::duration<double, nano>(t1 - t0).count());
+
+                ok = ok && (out == reference);
+            }
+            sort(ns.begin(), ns.end());
+
+            if (!ok) {
+                status = 1;
+            }
+            double per_sec = signal.size() / (ns[ns.size() / 2] / 1e9);
+            printf("{\"bench\":\"rtp_resample\",\"in_rate\":%u,\"out_rate\":%u,\"kernel\":\"%s\",\"taps_per_phase\":%u,"
+                   "\"seconds\":%u,\"runs\":%u,\"in_samples_per_sec\":%.3g,\"out_samples_per_sec\":%.3g,"
+                   "\"streams_per_core\":%.0f,\"gain\":%.3f,\"agrees\":%s}\n",
+                   pair.in, pair.out, RTPResampler::name(k), taps, seconds, runs,
+                   per_sec, per_sec * pair.out / pair.in, per_sec / pair.in, gain, ok ? "true" : "false");
+            fflush(stdout);
+        }
+    }
+    return status;
+}
@@ -0,0 +1,173 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   stress runs of RTPJitter against RTPTrafficGenerator's impaired networks.
+*
+*   usage: bench_traffic [virtual_seconds] [seed]
+*
+*   For each network profile, simulates 'virtual_seconds' of a 20ms stream
+*   through a 60ms buffer on a virtual clock and reports, as one JSON object
+*   per line, what happened to the packets and how many packets per second
+*   of wall-clock time the generator + buffer sustained.  A final line gives
+*   the raw generator rate with no buffer attached.
+*
+******************************************************************************/
+
+#include "rtp_traffic.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+
+struct profile
+{
+    const char                     *name;
+    RTPTrafficGenerator::config     cfg;
+};
+
+static vector<profile> profiles(const uint64 seed)
+{
+    vector<profile>             list;
+    RTPTrafficGenerator::config base;
+
+    base.seed = seed;
+    base.jitter_ms = 5.0;
+
+    profile p;
+
+    p.name = "clean";
+    p.cfg = base;
+    list.push_back(p);
+
+    p.name = "pareto";
+    p.cfg = base;
+    p.cfg.delay = RTPTrafficGenerator::DELAY_PARETO;
+    p.cfg.pareto_scale_ms = 4.0;
+    p.cfg.pareto_shape = 1.5;
+    list.push_back(p);
+
+    p.name = "bimodal";
+    p.cfg = base;
+    p.cfg.delay = RTPTrafficGenerator::DELAY_BIMODAL;
+    p.cfg.bimodal_ms = 50.0;
+    p.cfg.bimodal_prob = 0.05;
+    list.push_back(p);
+
+    p.name = "spikes";
+    p.cfg = base;
+    p.cfg.delay = RTPTrafficGenerator::DELAY_SPIKES;
+    p.cfg.spike_ms = 300.0;
+    p.cfg.spike_prob = 0.002;
+    p.cfg.spike_packets = 15;
+    list.push_back(p);
+
+    p.name = "gilbert_elliott";
+    p.cfg = base;
+    p.cfg.ge_p = 0.01;
+    p.cfg.ge_r = 0.3;
+    p.cfg.loss_good = 0.001;
+    p.cfg.loss_bad = 0.7;
+    list.push_back(p);
+
+    p.name = "reorder_dup";
+    p.cfg = base;
+    p.cfg.reorder_prob = 0.05;
+    p.cfg.reorder_ms = 30.0;
+    p.cfg.dup_prob = 0.02;
+    list.push_back(p);
+
+    return list;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    seconds = (argc > 1) ? atoi(argv[1]) : 3600;
+    uint64      seed    = (argc > 2) ? strtoull(argv[2], nullptr, 0) : 1;
+
+    // results go to the real stdout; library logging goes nowhere
+    FILE *out = fdopen(dup(fileno(stdout)), "w");
+    if ((out == nullptr) || (freopen("/dev/null", "w", stdout) == nullptr)) {
+        fprintf(stderr, "bench_traffic: could not redirect stdout\n");
+        return 1;
+    }
+
+    for (const profile& p : profiles(seed)) {
+        RTPJitter           jitter(60);
+        RTPTrafficGenerator gen(p.cfg);
+
+        jitter.track_residence(true);
+        timepoint start = stdclock::now();
+        RTPTrafficGenerator::playout r = gen.simulate(jitter, seconds * 1000);
+        double elapsed = clocks::duration<double>(stdclock::now() - start).count();
+
+        const RTPTrafficGenerator::counters& c = gen.get_counters();
+        RTPJitter::statistics st = jitter.snapshot();
+        fprintf(out, "{\"bench\":\"rtp_traffic\",\"profile\":\"%s\",\"seed\":%llu,\"virtual_s\":%u,"
+                     "\"sent\":%llu,\"lost\":%llu,\"reordered\":%llu,\"duplicated\":%llu,"
+                     "\"pushed\":%llu,\"rejected\":%llu,\"overflows\":%llu,"
+                     "\"played\":%llu,\"concealed\":%llu,\"starved\":%llu,"
+                     "\"max_jitter\":%u,\"residence_p50_us\":%u,\"residence_p99_us\":%u,"
+                     "\"residence_max_us\":%u,\"wall_pps\":%.0f}\n",
+                p.name, (unsigned long long)seed, seconds,
+                (unsigned long long)c.sent, (unsigned long long)c.lost,
+                (unsigned long long)c.reordered, (unsigned long long)c.duplicated,
+                (unsigned long long)r.pushed, (unsigned long long)r.rejected,
+                (unsigned long long)r.overflows, (unsigned long long)r.played,
+                (unsigned long long)r.concealed, (unsigned long long)r.starved,
+                st.max_jitter, st.residence_p50_us, st.residence_p99_us,
+                st.residence_max_us, r.pushed / elapsed);
+        fflush(out);
+    }
+
+    // raw generator rate, worst-case profile, no buffer
+    {
+        RTPTrafficGenerator::config cfg = profiles(seed).back().cfg;
+        cfg.delay = RTPTrafficGenerator::DELAY_PARETO;
+        RTPTrafficGenerator gen(cfg);
+
+        vector<RTPTrafficGenerator::arrival> arrivals;
+        arrivals.reserve(1024);
+
+        timepoint   start = stdclock::now();
+        timepoint   t = gen.now();
+        uint64      packets = 0;
+        for (unsigned i = 0; i < seconds * 50; ++i) {
+            t += clocks::milliseconds(20);
+            arrivals.clear();
+            packets += gen.generate(t, arrivals);
+        }
+        double elapsed = clocks::duration<double>(stdclock::now() - start).count();
+
+        fprintf(out, "{\"bench\":\"rtp_traffic\",\"profile\":\"generator_only\",\"seed\":%llu,"
+                     "\"packets\":%llu,\"wall_pps\":%.0f}\n",
+                (unsigned long long)seed, (unsigned long long)packets, packets / elapsed);
+    }
+    return 0;
+}
@@ -0,0 +1,251 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   polling every buffer against RTPPlayoutWheel, for many mostly idle streams.
+*
+*   usage: bench_wheel [streams] [talking_pct] [seconds]
+*
+*   Simulates 'seconds' of 'streams' conference legs, of which about
+*   'talking_pct' percent are in a talk spurt at any time; a spurt lasts 1-4
+*   seconds of 20 ms packets, after which the stream is silent and its
+*   buffer drains back to buffering.  Every spurt ends in time to be played
+*   out before the run does.  Time is simulated, in 1 ms steps, so the run
+*   is as fast as the CPU allows.
+*
+*   Two ways to play the same traffic out, each on its own set of buffers:
+*
+*       poll    - pop() every buffer once per 20 ms, spread evenly over the
+*                 milliseconds, as a thread per shard would have to
+*       wheel   - pushed() after each push and advance() each millisecond;
+*                 only buffers with something to play are popped
+*
+*   One JSON object per method, e.g.
+*
+*       {"bench":"rtp_wheel","method":"wheel","streams":100000,"pops":..,
+*        "ns_per_sim_second":..,"cpu_pct_per_core":..}
+*
+*   where the time counts pop()/pushed()/advance() but not the push()es
+*   themselves, which both pay alike.  The exit status is 1 if the two
+*   methods did not play the same number of packets.
+*
+******************************************************************************/
+
+#include "rtp_playout.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+static const unsigned   PACKET_MS = 20;
+static const unsigned   DEPTH_MS  = 60;
+
+struct result
+{
+    double  ns;
+    uint64  pops;
+    uint64  played;             // SUCCESS
+};
+
+// when each stream talks: start ms and length in packets, one spurt at a
+//  time per stream, generated up front so both methods see the same traffic
+struct spurt
+{
+    unsigned    stream;
+    unsigned    start_ms;
+    unsigned    packets;
+};
+
+static vector<spurt> make_traffic(const unsigned streams, const unsigned talking_pct, const unsigned seconds, mt19937& rng)
+{
+    vector<spurt>   spurts;
+    vector<unsigned> busy_until(streams, 0);
+    uniform_int_distribution<unsigned> pick(0, streams - 1), length(50, 200);
+
+    // start spurts so that on average talking_pct percent are talking
+    double mean_ms = 125 * PACKET_MS;
+    double starts_per_ms = streams * (talking_pct / 100.0) / mean_ms;
+    double owed = streams * (talking_pct / 100.0);      // start the first lot at once
+
+    for (unsigned ms = 0; ms < seconds * 1000; ++ms) {
+        owed += starts_per_ms;
+        while (owed >= 1.0) {
+            owed -= 1.0;
+            unsigned s = pick(rng);
+            if (busy_until[s] > ms) {
+                continue;
+            }
+            spurt sp = { s, ms, length(rng) };
+            busy_until[s] = ms + sp.packets * PACKET_MS + DEPTH_MS * 2;
+            if (busy_until[s] <= seconds * 1000) {
+                spurts.push_back(sp);       // over, and played out, by the end
+            }
+        }
+    }
+    return spurts;
+}
+
+static rawrtp_ptr make_packet(const unsigned stream, const uint16 sequence)
+{
+    uint8       data[RTP_HEADER_LENGTH + 160];
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(data);
+
+    memset(data, 0xff, sizeof(data));
+    rtp->flags = htons(RTP_VERSION << 14);
+    rtp->sequence = htons(sequence);
+    rtp->timestamp = htonl((uint32)sequence * 160);
+    rtp->ssrc = htonl(stream);
+    return make_shared<RTPPacket>(data, sizeof(data));
+}
+
+// feeds the packets due at 'ms' and returns the streams that got one
+template<class Push>
+static void feed(const vector<spurt>& spurts, size_t& first, vector<size_t>& live, const unsigned ms, Push push)
+{
+    while ((first < spurts.size()) && (spurts[first].start_ms <= ms)) {
+        live.push_back(first++);
+    }
+    for (size_t i = 0; i < live.size(); ) {
+        const spurt& sp = spurts[live[i]];
+        unsigned elapsed = ms - sp.start_ms;
+        if (elapsed % PACKET_MS == 0) {
+            push(sp.stream, (uint16)(sp.start_ms + elapsed / PACKET_MS));
+        }
+        if (elapsed + 1 >= sp.packets * PACKET_MS) {
+            live[i] = live.back();
+            live.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+static result run_poll(const unsigned streams, const unsigned seconds, const vector<spurt>& spurts, const timepoint start)
+{
+    vector<unique_ptr<RTPJitter>>   buffers;
+    vector<size_t>                  live;
+    size_t                          first = 0;
+    result                          r = { 0, 0, 0 };
+    rawrtp_ptr                      packet;
+
+    for (unsigned i = 0; i < streams; ++i) {
+        buffers.emplace_back(new RTPJitter(DEPTH_MS));
+    }
+
+    for (unsigned ms = 0; ms < seconds * 1000; ++ms) {
+        timepoint now = start + clocks::milliseconds(ms);
+        feed(spurts, first, live, ms, [&](const unsigned s, const uint16 seq) {
+            buffers[s]->push(make_packet(s, seq), now);
+        });
+
+        timepoint t0 = stdclock::now();
+        for (unsigned s = ms % PACKET_MS; s < streams; s += PACKET_MS) {
+            if (buffers[s]->pop(packet, now) == RTPJitter::SUCCESS) {
+                ++r.played;
+            }
+            ++r.pops;
+        }
+        packet.reset();
+        r.ns += clocks::duration<double, nano>(stdclock::now() - t0).count();
+    }
+    return r;
+}
+
+static result run_wheel(const unsigned streams, const unsigned seconds, const vector<spurt>& spurts, const timepoint start)
+{
+    vector<unique_ptr<RTPJitter>>       buffers;
+    vector<RTPPlayoutWheel::stream_id>  ids;
+    vector<size_t>                      live;
+    size_t                              first = 0;
+    result                              r = { 0, 0, 0 };
+    RTPPlayoutWheel                     wheel(start);
+
+    for (unsigned i = 0; i < streams; ++i) {
+        buffers.emplace_back(new RTPJitter(DEPTH_MS));
+        ids.push_back(wheel.add(buffers.back().get(), PACKET_MS,
+            [&r](RTPPlayoutWheel::stream_id, RTPJitter&, RTPJitter::RESULT rc, rawrtp_ptr&) {
+                if (rc == RTPJitter::SUCCESS) {
+                    ++r.played;
+                }
+            }));
+    }
+
+    vector<unsigned>                    fed;
+
+    for (unsigned ms = 0; ms < seconds * 1000; ++ms) {
+        timepoint now = start + clocks::milliseconds(ms);
+        fed.clear();
+        feed(spurts, first, live, ms, [&](const unsigned s, const uint16 seq) {
+            buffers[s]->push(make_packet(s, seq), now);
+            fed.push_back(s);
+        });
+
+        timepoint t0 = stdclock::now();
+        for (unsigned s : fed) {
+            wheel.pushed(ids[s]);
+        }
+        r.pops += wheel.advance(now);
+        r.ns += clocks::duration<double, nano>(stdclock::now() - t0).count();
+    }
+    return r;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned    streams     = (argc > 1) ? atoi(argv[1]) : 100000;
+    unsigned    talking_pct = (argc > 2) ? atoi(argv[2]) : 2;
+    unsigned    seconds     = (argc > 3) ? atoi(argv[3]) : 10;
+    mt19937     rng(12345);
+
+    if (streams == 0) streams = 1;
+    if (seconds == 0) seconds = 1;
+
+    // results go to the real stdout; library logging goes nowhere
+    FILE *out = fdopen(dup(fileno(stdout)), "w");
+    if ((out == nullptr) || (freopen("/dev/null", "w", stdout) == nullptr)) {
+        fprintf(stderr, "bench_wheel: could not redirect stdout\n");
+        return 1;
+    }
+
+    vector<spurt>   spurts = make_traffic(streams, talking_pct, seconds, rng);
+    timepoint       start = stdclock::now();
+    result          poll = run_poll(streams, seconds, spurts, start);
+    result          wheel = run_wheel(streams, seconds, spurts, start);
+
+    const struct { const char *method; const result& r; } methods[] = { { "poll", poll }, { "wheel", wheel } };
+    for (const auto& m : methods) {
+        double per_second = m.r.ns / seconds;
+        fprintf(out, "{\"bench\":\"rtp_wheel\",\"method\":\"%s\",\"streams\":%u,\"talking_pct\":%u,\"seconds\":%u,"
+                     "\"spurts\":%zu,\"pops\":%llu,\"played\":%llu,\"ns_per_sim_second\":%.0f,\"cpu_pct_per_core\":%.2f}\n",
+                m.method, streams, talking_pct, seconds, spurts.size(),
+                (unsigned long long)m.r.pops, (unsigned long long)m.r.played, per_second, per_second / 1e7);
+    }
+    return (poll.played == wheel.played) ? 0 : 1;
+}
@@ -27,6 +27,7 @@
 #define RTP_H_a657e19c_e611_413c_86c1_e2263a9d1b07
 
 #include <cstring>
+#include <memory>
 #include "stdinc.h"
 
 // from RFC 3550, fixed headers for RTP.  This should be all
@@ -81,6 +82,7 @@
     // RTP payload types -----
 #define RTP_PAYLOAD_G711U       0x00
 #define RTP_PAYLOAD_GSM         0x03
+#define RTP_PAYLOAD_G711A       0x08
 #define RTP_PAYLOAD_L16         0x0b
 #define RTP_PAYLOAD_G729A       0x12
 #define RTP_PAYLOAD_SPEEX       0x61
@@ -115,13 +117,22 @@ public:
     uint8   payload_type;
     uint16  payload_bytes;
     bool    use_redundant_payload;
+    timepoint enqueued;             // set by RTPJitter::push() for residence stats
 
-    RTPPacket(uint8 *pIn, short nInLen) : pData(NULL), nLen(nInLen)
+    // when set, pData is a view into this block (e.g. one segment of a
+    //  GRO-coalesced receive buffer) and is not ours to delete.
+    //  backing_share is how much of the block this view answers for in
+    //  memory accounting, so a block's views between them cover all of it.
+    std::shared_ptr<uint8>  backing;
+    uint32                  backing_share;
+
+    RTPPacket(uint8 *pIn, short nInLen) : pData(NULL), nLen(nInLen), backing_share(0)
     {
         payload_ms = 0;
         payload_type = RTP_PAYLOAD_G711U;
         payload_bytes = 0;
         use_redundant_payload = false;
+        enqueued = timepoint::min();
         if (pIn && nLen) {
             pData = new uint8[nLen];
             if (pData) {
@@ -129,7 +140,23 @@ public:
             };
         }
     }
-    ~RTPPacket() { if (pData) delete[] pData; };
+
+    // zero-copy view of nInLen bytes at pIn, which must lie within 'block';
+    //  it answers for its own bytes of the block unless given a share
+    RTPPacket(std::shared_ptr<uint8> block, uint8 *pIn, uint16 nInLen)
+        : RTPPacket(std::move(block), pIn, nInLen, nInLen) {}
+
+    RTPPacket(std::shared_ptr<uint8> block, uint8 *pIn, uint16 nInLen, uint32 share)
+        : pData(pIn), nLen(nInLen), backing(std::move(block)), backing_share(share)
+    {
+        payload_ms = 0;
+        payload_type = RTP_PAYLOAD_G711U;
+        payload_bytes = 0;
+        use_redundant_payload = false;
+        enqueued = timepoint::min();
+    }
+
+    ~RTPPacket() { if (pData && !backing) delete[] pData; };
 };
 
 typedef std::shared_ptr<RTPPacket>  rawrtp_ptr;
@@ -0,0 +1,215 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_AWAIT_H_3d8b5f12_c7e4_4a90_b21f_86e0a4d9c573
+#define RTP_AWAIT_H_3d8b5f12_c7e4_4a90_b21f_86e0a4d9c573
+
+// - the coroutine interface needs C++20; the rest of the library, and any
+//  translation unit built as C++11, sees an empty header
+#if (__cplusplus >= 202002L) && defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include "stdinc.h"
+#include "rtp_jitter.h"
+#include "rtp_playout.h"
+
+#define RTP_HAVE_COROUTINES 1
+
+
+
+/******************************************************************************
+*   A jitter buffer as a stream of playout events for coroutines:
+*
+*       RTPPlayoutStream stream(scheduler, jitter, 20);
+*       for (;;) {
+*           auto frame = co_await stream.next();
+*           if (frame.result == RTPJitter::DROPPED_PACKET) conceal(); ...
+*       }
+*
+*   The stream registers the buffer with an RTPPlayoutScheduler, which pops
+*   it once per ptime as usual.  While the buffer is BUFFERING (or empty)
+*   nothing is due and the coroutine stays suspended; a SUCCESS or a
+*   DROPPED_PACKET resumes it.  No thread belongs to the stream and nobody
+*   polls: the coroutine is resumed on the worker that owns the stream, or
+*   handed to 'executor' if one is given.
+*
+*   Frames that fall due while the coroutine is busy wait in a backlog of up
+*   to 'backlog' frames; beyond that the oldest are discarded and counted in
+*   overruns().  close(), which the destructor calls, stops the stream and
+*   resumes a waiting coroutine with BUFFER_EMPTY and no packet.
+******************************************************************************/
+class RTPPlayoutStream
+{
+public:
+    typedef std::function<void(std::coroutine_handle<>)> executor;
+
+    struct frame
+    {
+        RTPJitter::RESULT   result;         // SUCCESS, DROPPED_PACKET, or BUFFER_EMPTY once closed
+        rawrtp_ptr          packet;         // null unless SUCCESS
+    };
+
+    class awaiter
+    {
+    public:
+        explicit awaiter(RTPPlayoutStream& stream) : _stream(stream) {}
+
+        bool    await_ready()                               { return _stream._ready(); }
+        bool    await_suspend(std::coroutine_handle<> h)    { return _stream._suspend(h); }
+        frame   await_resume()                              { return _stream._take(); }
+
+    private:
+        RTPPlayoutStream&   _stream;
+    };
+
+    RTPPlayoutStream(RTPPlayoutScheduler& scheduler, RTPJitter& jitter, const unsigned ptime_ms,
+                     executor ex = nullptr, const size_t backlog = 8)
+        : _scheduler(scheduler), _executor(std::move(ex)), _backlog(backlog ? backlog : 1),
+          _overruns(0), _closed(false)
+    {
+        _id = _scheduler.add(&jitter, ptime_ms,
+            [this](RTPPlayoutScheduler::stream_id, RTPJitter&, RTPJitter::RESULT rc, rawrtp_ptr& packet) {
+                _on_pop(rc, packet);
+            });
+    }
+
+    ~RTPPlayoutStream()                                     { close(); }
+
+    RTPPlayoutStream(const RTPPlayoutStream&) = delete;
+    RTPPlayoutStream& operator=(const RTPPlayoutStream&) = delete;
+
+    // - co_await stream.next() for the next frame that is due
+    awaiter     next()                                      { return awaiter(*this); }
+
+    void close()
+    {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_closed) {
+                return;
+            }
+            _closed = true;
+        }
+        _scheduler.remove(_id);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            waiter = _waiter;
+            _waiter = nullptr;
+        }
+        _resume(waiter);
+    }
+
+    size_t pending()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _frames.size();
+    }
+
+    uint64 overruns()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _overruns;
+    }
+
+private:
+    RTPPlayoutScheduler&        _scheduler;
+    RTPPlayoutScheduler::stream_id  _id;
+    executor                    _executor;
+    size_t                      _backlog;
+    std::mutex                  _mutex;
+    std::deque<frame>           _frames;
+    std::coroutine_handle<>     _waiter;
+    uint64                      _overruns;
+    bool                        _closed;
+
+    bool _ready()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return !_frames.empty() || _closed;
+    }
+
+    // false resumes the coroutine at once: something became due, or the
+    //  stream closed, since await_ready() looked
+    bool _suspend(std::coroutine_handle<> h)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_frames.empty() || _closed) {
+            return false;
+        }
+        _waiter = h;
+        return true;
+    }
+
+    frame _take()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_frames.empty()) {
+            return frame{ RTPJitter::BUFFER_EMPTY, nullptr };
+        }
+        frame f = std::move(_frames.front());
+        _frames.pop_front();
+        return f;
+    }
+
+    // on the scheduler's worker, once per ptime
+    void _on_pop(const RTPJitter::RESULT rc, rawrtp_ptr& packet)
+    {
+        if ((rc != RTPJitter::SUCCESS) && (rc != RTPJitter::DROPPED_PACKET)) {
+            return;                         // still buffering: nothing is due
+        }
+
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_frames.size() >= _backlog) {
+                _frames.pop_front();
+                ++_overruns;
+            }
+            _frames.push_back(frame{ rc, (rc == RTPJitter::SUCCESS) ? packet : nullptr });
+            waiter = _waiter;
+            _waiter = nullptr;
+        }
+        _resume(waiter);
+    }
+
+    void _resume(std::coroutine_handle<> h)
+    {
+        if (!h) {
+            return;
+        }
+        if (_executor) {
+            _executor(h);
+        } else {
+            h.resume();
+        }
+    }
+};
+
+#endif  // C++20 coroutines
+
+#endif  // RTP_AWAIT_H_3d8b5f12_c7e4_4a90_b21f_86e0a4d9c573
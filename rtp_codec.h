@@ -0,0 +1,143 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_CODEC_H_7c2a95e0_3b18_4d6f_a4c9_01e8d5b36f72
+#define RTP_CODEC_H_7c2a95e0_3b18_4d6f_a4c9_01e8d5b36f72
+
+#include <arpa/inet.h>
+#include "stdinc.h"
+#include "rtp.h"
+
+
+
+/******************************************************************************
+*   What the jitter buffer needs to know about a payload type to work out how
+*   much audio a packet holds.  Frame based codecs give samples and bytes per
+*   frame; sample based ones are a "frame" of one sample.  frame_bytes is 0
+*   where the size varies (VBR), in which case only the RTP timestamps can
+*   tell the duration.
+******************************************************************************/
+struct RTPCodec
+{
+    uint8       payload_type;
+    const char *name;
+    uint32      clock_rate;         // RTP timestamp units per second, 0 if unknown
+    uint16      frame_samples;
+    uint16      frame_bytes;        // 0 if variable
+    uint16      ptime_ms;           // default packet time
+};
+
+constexpr RTPCodec RTP_CODECS[] = {
+    //  type                    name        clock   samples bytes   ptime
+    { RTP_PAYLOAD_G711U,        "PCMU",     8000,   1,      1,      20 },
+    { RTP_PAYLOAD_GSM,          "GSM",      8000,   160,    33,     20 },
+    { RTP_PAYLOAD_G711A,        "PCMA",     8000,   1,      1,      20 },
+    { RTP_PAYLOAD_L16,          "L16",      44100,  1,      2,      20 },   // mono, RFC 3551 PT 11
+    { RTP_PAYLOAD_G729A,        "G729",     8000,   80,     10,     20 },
+    { RTP_PAYLOAD_SPEEX,        "speex",    8000,   160,    0,      20 },   // narrowband, VBR
+    { RTP_PAYLOAD_DYNAMIC,      "red",      8000,   80,     0,      20 },   // RFC 2198 around G.729
+};
+
+constexpr unsigned RTP_CODEC_COUNT = sizeof(RTP_CODECS) / sizeof(RTP_CODECS[0]);
+constexpr RTPCodec RTP_CODEC_UNKNOWN = { 0xff, "unknown", 0, 0, 0, 0 };
+
+
+/******************************************************************************
+*   Looks up a payload type.  A constant expression, so descriptors for the
+*   static types cost nothing at run time:
+*
+*       constexpr RTPCodec pcmu = rtp_codec(RTP_PAYLOAD_G711U);
+*
+*   Returns the descriptor, or RTP_CODEC_UNKNOWN
+******************************************************************************/
+constexpr RTPCodec rtp_codec(const uint8 payload_type, const unsigned i = 0)
+{
+    return (i >= RTP_CODEC_COUNT)                       ? RTP_CODEC_UNKNOWN
+         : (RTP_CODECS[i].payload_type == payload_type) ? RTP_CODECS[i]
+         : rtp_codec(payload_type, i + 1);
+}
+
+
+/******************************************************************************
+*   Milliseconds of audio in 'bytes' of payload, from the frame size alone.
+*
+*   Returns duration, 0 where the codec is unknown or variable rate
+******************************************************************************/
+constexpr unsigned rtp_payload_ms(const RTPCodec& codec, const unsigned bytes)
+{
+    return ((codec.frame_bytes == 0) || (codec.clock_rate == 0)) ? 0
+         : (unsigned)(((uint64)(bytes / codec.frame_bytes) * codec.frame_samples * 1000) / codec.clock_rate);
+}
+
+static_assert(rtp_codec(RTP_PAYLOAD_G711U).clock_rate == 8000, "PCMU is 8kHz");
+static_assert(rtp_payload_ms(rtp_codec(RTP_PAYLOAD_G711U), 160) == 20, "160 bytes of PCMU is 20ms");
+static_assert(rtp_payload_ms(rtp_codec(RTP_PAYLOAD_GSM), 33 * 2) == 40, "GSM is 33 byte 20ms frames");
+static_assert(rtp_payload_ms(rtp_codec(RTP_PAYLOAD_G729A), 20) == 20, "G.729 is 10 byte 10ms frames");
+static_assert(rtp_payload_ms(rtp_codec(RTP_PAYLOAD_L16), 1764) == 20, "882 samples of L16 is 20ms");
+static_assert(rtp_payload_ms(rtp_codec(RTP_PAYLOAD_SPEEX), 38) == 0, "speex is variable rate");
+static_assert(rtp_codec(0x7f).clock_rate == 0, "unlisted types are unknown");
+
+
+/******************************************************************************
+*   Where the payload of a 'len' byte RTP packet starts: after the fixed
+*   header, the CSRC list and any header extension.
+*
+*   Returns offset of the payload, len or more if the packet is too short
+*   to hold its headers
+******************************************************************************/
+inline unsigned rtp_payload_offset(const uint8 *data, const unsigned len)
+{
+    if ((data == nullptr) || (len < RTP_HEADER_LENGTH)) {
+        return len;
+    }
+
+    uint16      flags = ntohs(reinterpret_cast<const RTPHeader *>(data)->flags);
+    unsigned    header = RTP_HEADER_LENGTH + 4 * ((flags & RTP_FLAGS_CSRC_COUNT) >> 8);
+
+    if ((flags & RTP_FLAGS_EXTENSION) && (header + 4 <= len)) {
+        header += 4 + 4 * ((data[header + 2] << 8) | data[header + 3]);
+    }
+    return header;
+}
+
+
+/******************************************************************************
+*   Size of the payload of a 'len' byte RTP packet: what follows the headers,
+*   less any padding.
+*
+*   Returns payload length, 0 if the packet is too short to hold its headers
+******************************************************************************/
+inline unsigned rtp_payload_length(const uint8 *data, const unsigned len)
+{
+    unsigned header = rtp_payload_offset(data, len);
+
+    if (header >= len) {
+        return 0;
+    }
+    unsigned padding = (data[0] & (RTP_FLAGS_PADDING >> 8)) ? data[len - 1] : 0;
+
+    return (header + padding < len) ? (len - header - padding) : 0;
+}
+
+#endif  // RTP_CODEC_H_7c2a95e0_3b18_4d6f_a4c9_01e8d5b36f72
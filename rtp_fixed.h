@@ -0,0 +1,241 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_FIXED_H_e5b3097a_1c64_4a2d_b8f0_6d92c74e1a53
+#define RTP_FIXED_H_e5b3097a_1c64_4a2d_b8f0_6d92c74e1a53
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include "stdinc.h"
+#include "rtp.h"
+#include "rtp_memory.h"
+#include "rtp_jitter_impl.h"
+
+// a jitter buffer that never touches the heap once it is built:
+//
+//      static RTPFixedPacketPool<64>   pool;       // packets, with their payloads inline
+//      RTPFixedJitter<32>              jitter(60); // room for 32 packets
+//
+//      rawrtp_ptr p = pool.acquire(datagram, len);
+//      if (p) jitter.push(p, arrival);
+//
+//  push(), pop() and reset() behave as for RTPJitter, except that a push
+//  into a full buffer drops the oldest packet as an overflow.  Residence
+//  tracking allocates its histogram when it is turned on, so turn it on
+//  before the audio starts if it is wanted.
+
+
+
+/******************************************************************************
+*   StoragePolicy for RTPJitterT: a ring of N slots held inside the buffer
+*   object.  The allocator is accepted, to fit in with the other storage
+*   policies, and never used.
+******************************************************************************/
+template<size_t N>
+struct RTPRingStorage
+{
+    static const size_t CAPACITY = N;
+
+    template<class Alloc>
+    class queue
+    {
+    public:
+        typedef Alloc       allocator_type;
+        typedef rawrtp_ptr  value_type;
+
+        class iterator
+        {
+        public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef rawrtp_ptr          value_type;
+            typedef ptrdiff_t           difference_type;
+            typedef rawrtp_ptr         *pointer;
+            typedef rawrtp_ptr&         reference;
+
+            iterator(queue *q, const size_t i) : _q(q), _i(i) {}
+
+            rawrtp_ptr& operator*() const       { return _q->_at(_i); }
+            rawrtp_ptr *operator->() const      { return &_q->_at(_i); }
+            iterator&   operator++()            { ++_i; return *this; }
+            iterator&   operator--()            { --_i; return *this; }
+            bool operator==(const iterator& o) const    { return _i == o._i; }
+            bool operator!=(const iterator& o) const    { return _i != o._i; }
+
+        private:
+            friend class queue;
+            queue  *_q;
+            size_t  _i;                 // position from the front
+        };
+
+        explicit queue(const Alloc&) : _head(0), _count(0) {}
+
+        bool        empty() const       { return _count == 0; }
+        size_t      size() const        { return _count; }
+        rawrtp_ptr& front()             { return _slots[_head]; }
+        iterator    begin()             { return iterator(this, 0); }
+        iterator    end()               { return iterator(this, _count); }
+
+        // - all of these expect the ring not to be full; RTPJitterT makes
+        //  room first, by CAPACITY.
+        void push_back(rawrtp_ptr p)
+        {
+            _at(_count) = std::move(p);
+            ++_count;
+        }
+
+        void push_front(rawrtp_ptr p)
+        {
+            _head = (_head == 0) ? (N - 1) : (_head - 1);
+            _slots[_head] = std::move(p);
+            ++_count;
+        }
+
+        iterator insert(const iterator position, rawrtp_ptr p)
+        {
+            for (size_t i = _count; i > position._i; --i) {
+                _at(i) = std::move(_at(i - 1));
+            }
+            _at(position._i) = std::move(p);
+            ++_count;
+            return position;
+        }
+
+        void pop_front()
+        {
+            _slots[_head].reset();
+            _head = (_head + 1 == N) ? 0 : (_head + 1);
+            --_count;
+        }
+
+        void clear()
+        {
+            while (_count != 0) {
+                pop_front();
+            }
+            _head = 0;
+        }
+
+    private:
+        std::array<rawrtp_ptr, N>   _slots;
+        size_t                      _head;
+        size_t                      _count;
+
+        rawrtp_ptr& _at(const size_t i)
+        {
+            size_t slot = _head + i;
+            return _slots[(slot >= N) ? (slot - N) : slot];
+        }
+    };
+};
+
+template<size_t N, class Observer = RTPJitterNullObserver, class LockPolicy = std::recursive_mutex>
+using RTPFixedJitter = RTPJitterT<Observer, LockPolicy, RTPSteadyClock, RTPRingStorage<N> >;
+
+
+
+/******************************************************************************
+*   N packets of up to BYTES each, built when the pool is.  acquire() copies
+*   a datagram into a free one; a packet is free again once every holder
+*   (jitter buffer, application) has let go of it, so nothing is allocated
+*   or freed per packet.  acquire() must only be called from one thread at
+*   a time; packets may be released on any.
+*
+*   Unlike RTPBufferPool, the packets point into the pool itself, so the pool
+*   must outlive everything that might still hold one.
+******************************************************************************/
+template<size_t N, size_t BYTES = 1500>
+class RTPFixedPacketPool
+{
+public:
+    RTPFixedPacketPool() : _next(0)
+    {
+        // the arena is not ours to free; the packets only view it, and
+        //  answer for none of it -- it is counted once, below
+        std::shared_ptr<uint8> arena(_arena.data(), [](uint8 *) {});
+
+        for (size_t i = 0; i < N; ++i) {
+            _packets[i] = std::make_shared<RTPPacket>(arena, _arena.data() + (i * BYTES), (uint16)0, (uint32)0);
+        }
+        RTPMemory::add(RTPMemory::RESERVED, (int64)(sizeof(*this) + N * sizeof(RTPPacket)));
+    }
+
+    ~RTPFixedPacketPool()
+    {
+        RTPMemory::add(RTPMemory::RESERVED, -(int64)(sizeof(*this) + N * sizeof(RTPPacket)));
+    }
+
+    RTPFixedPacketPool(const RTPFixedPacketPool&) = delete;
+    RTPFixedPacketPool& operator=(const RTPFixedPacketPool&) = delete;
+
+    // copies 'len' bytes into a free packet, reset as the RTPPacket
+    //  constructor would leave it.  nullptr if all N are in use or the
+    //  datagram is bigger than BYTES.
+    rawrtp_ptr acquire(const uint8 *data, const size_t len)
+    {
+        if (len > BYTES) {
+            return nullptr;
+        }
+        for (size_t n = 0; n < N; ++n) {
+            rawrtp_ptr& p = _packets[_next];
+
+            _next = (_next + 1 == N) ? 0 : (_next + 1);
+            if (p.use_count() == 1) {
+                // the last holder's release happens-before our reuse
+                std::atomic_thread_fence(std::memory_order_acquire);
+                memcpy(p->pData, data, len);
+                p->nLen = (uint16)len;
+                p->payload_ms = 0;
+                p->payload_type = RTP_PAYLOAD_G711U;
+                p->payload_bytes = 0;
+                p->use_redundant_payload = false;
+                p->enqueued = timepoint::min();
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    // packets not held by anyone but the pool, for diagnostics
+    size_t available() const
+    {
+        size_t n = 0;
+        for (const rawrtp_ptr& p : _packets) {
+            n += (p.use_count() == 1) ? 1 : 0;
+        }
+        return n;
+    }
+
+    static const size_t CAPACITY = N;
+    static const size_t PACKET_BYTES = BYTES;
+
+private:
+    std::array<uint8, N * BYTES>    _arena;
+    std::array<rawrtp_ptr, N>       _packets;
+    size_t                          _next;
+};
+
+#endif  // RTP_FIXED_H_e5b3097a_1c64_4a2d_b8f0_6d92c74e1a53
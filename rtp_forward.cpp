@@ -0,0 +1,324 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   batched sendmmsg()/GSO forwarding sink for popped RTP packets.
+*
+*   See rtp_forward.h for usage.
+*
+******************************************************************************/
+
+#include "rtp_forward.h"
+#include "rtp_log.h"
+#include <cerrno>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+/******************************************************************************
+*   Uses the given UDP socket, or opens an IPv4 one if socket is negative.
+*   (Pass your own socket to forward to IPv6 destinations.)
+*
+*   Returns n/a
+******************************************************************************/
+RTPForwarder::RTPForwarder(const int socket /* = -1 */, const bool gso /* = false */)
+    : _socket(socket), _own_socket(false), _gso(gso),
+      _packets_sent(0), _datagrams_sent(0), _send_calls(0), _send_errors(0)
+{
+    if (_socket < 0) {
+        _socket = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        _own_socket = true;
+        if (_socket < 0) {
+            LOGD("RTPForwarder(): socket() failed: %d\n", errno);
+        }
+    }
+}
+
+
+
+/******************************************************************************
+*   Anything still queued is dropped (not sent).
+*
+*   Returns n/a
+******************************************************************************/
+RTPForwarder::~RTPForwarder()
+{
+    if (_own_socket && (_socket >= 0)) {
+        close(_socket);
+    }
+}
+
+
+
+/******************************************************************************
+*   Registers a destination and how its packets are to be rewritten.
+*
+*   Returns id for use with queue()
+******************************************************************************/
+RTPForwarder::destination_id RTPForwarder::add_destination(const sockaddr *addr, const socklen_t addr_len,
+                                                           const rewrite& rw /* = rewrite() */)
+{
+    destination d;
+
+    memset(&d.addr, 0, sizeof(d.addr));
+    memcpy(&d.addr, addr, (addr_len < sizeof(d.addr)) ? addr_len : sizeof(d.addr));
+    d.addr_len = addr_len;
+    d.rw = rw;
+    d.have_offset = false;
+    d.sequence_offset = 0;
+    d.send_errors = 0;
+
+    _destinations.push_back(move(d));
+    return (destination_id)(_destinations.size() - 1);
+}
+
+
+
+/******************************************************************************
+*   Queues a packet for the next flush(), rewriting its header if configured
+*   for the destination.  Takes over the caller's reference.
+*
+*   Returns none
+******************************************************************************/
+void RTPForwarder::queue(const destination_id dest, rawrtp_ptr& packet)
+{
+    if ((dest >= _destinations.size()) || (packet == nullptr)
+     || (packet->pData == nullptr) || (packet->nLen < RTP_HEADER_LENGTH))
+    {
+        packet.reset();
+        return;
+    }
+
+    destination& d = _destinations[dest];
+    if (d.rw.ssrc || d.rw.sequence) {
+        _rewrite(d, packet);
+    }
+    if (d.queued.empty()) {
+        _active.push_back(dest);
+    }
+    d.queued.push_back(move(packet));
+}
+
+
+
+/******************************************************************************
+*   Sends everything queued since the last flush in as few syscalls as
+*   possible, then releases the packets.  Send failures are counted and the
+*   packets dropped; a relay has no use for late audio.
+*
+*   Returns number of packets handed to the kernel
+******************************************************************************/
+unsigned RTPForwarder::flush()
+{
+    size_t total = 0;
+    for (destination_id dest : _active) {
+        total += _destinations[dest].queued.size();
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    // worst case is one message per packet; size everything up front so the
+    //  pointers we hand the kernel stay put.
+    _msgs.resize(total);
+    _iovs.resize(total);
+    _msg_packets.resize(total);
+    _msg_dest.resize(total);
+    _control.resize(total * CMSG_SPACE(sizeof(uint16)));
+
+    unsigned m = 0;
+    unsigned v = 0;
+    for (destination_id dest : _active) {
+        destination& d = _destinations[dest];
+        bool gso = _gso && (d.queued.size() > 1) && _gso_eligible(d);
+
+        unsigned per_msg = 1;
+        if (gso) {
+            unsigned segment = d.queued.front()->nLen;
+            per_msg = 65507 / segment;
+            if (per_msg > MAX_GSO_SEGMENTS) per_msg = MAX_GSO_SEGMENTS;
+            if (per_msg == 0) per_msg = 1;
+        }
+
+        for (size_t i = 0; i < d.queued.size(); i += per_msg) {
+            unsigned count = (unsigned)min<size_t>(per_msg, d.queued.size() - i);
+
+            msghdr& hdr = _msgs[m].msg_hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_name = &d.addr;
+            hdr.msg_namelen = d.addr_len;
+            hdr.msg_iov = &_iovs[v];
+            hdr.msg_iovlen = count;
+
+            for (unsigned k = 0; k < count; ++k) {
+                _iovs[v].iov_base = d.queued[i + k]->pData;
+                _iovs[v].iov_len = d.queued[i + k]->nLen;
+                ++v;
+            }
+
+            if (gso && (count > 1)) {
+                hdr.msg_control = &_control[m * CMSG_SPACE(sizeof(uint16))];
+                hdr.msg_controllen = CMSG_SPACE(sizeof(uint16));
+
+                cmsghdr *cm = CMSG_FIRSTHDR(&hdr);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint16));
+                uint16 segment = d.queued.front()->nLen;
+                memcpy(CMSG_DATA(cm), &segment, sizeof(segment));
+            }
+
+            _msg_packets[m] = count;
+            _msg_dest[m] = dest;
+            ++m;
+        }
+    }
+
+    _send(m);
+    unsigned sent = 0;
+    for (unsigned i = 0; i < m; ++i) {
+        if (_msg_packets[i] != 0) {
+            sent += _msg_packets[i];
+            _datagrams_sent++;
+        }
+    }
+    _packets_sent += sent;
+
+    // let go of the packets -- pooled buffers go home from here
+    for (destination_id dest : _active) {
+        _destinations[dest].queued.clear();
+    }
+    _active.clear();
+
+    return sent;
+}
+
+
+
+/******************************************************************************
+*   Rewrites SSRC and/or sequence number in place.  If anyone else still
+*   holds the packet we work on a private copy instead.
+*
+*   Returns none -- 'packet' may be replaced by the copy
+******************************************************************************/
+void RTPForwarder::_rewrite(destination& d, rawrtp_ptr& packet)
+{
+    if (packet.use_count() > 1) {
+        rawrtp_ptr copy = make_shared<RTPPacket>(packet->pData, packet->nLen);
+        copy->payload_ms = packet->payload_ms;
+        copy->payload_type = packet->payload_type;
+        copy->payload_bytes = packet->payload_bytes;
+        copy->use_redundant_payload = packet->use_redundant_payload;
+        packet = move(copy);
+    }
+
+    RTPHeader *rtp = reinterpret_cast<PRTPHeader>(packet->pData);
+    if (d.rw.ssrc) {
+        rtp->ssrc = htonl(d.rw.new_ssrc);
+    }
+    if (d.rw.sequence) {
+        uint16 sequence = ntohs(rtp->sequence);
+        if (!d.have_offset) {
+            d.sequence_offset = (uint16)(d.rw.first_sequence - sequence);
+            d.have_offset = true;
+        }
+        rtp->sequence = htons((uint16)(sequence + d.sequence_offset));
+    }
+}
+
+
+
+/******************************************************************************
+*   UDP_SEGMENT requires every segment but the last to be the same size, and
+*   the last to be no larger.
+*
+*   Returns true if the destination's queue can go out as GSO datagrams
+******************************************************************************/
+bool RTPForwarder::_gso_eligible(const destination& d)
+{
+    uint16 segment = d.queued.front()->nLen;
+
+    for (size_t i = 1; i < d.queued.size(); ++i) {
+        uint16 len = d.queued[i]->nLen;
+        if ((len > segment) || ((len < segment) && (i != d.queued.size() - 1))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
+/******************************************************************************
+*   Hands 'count' prepared messages to the kernel, retrying partial sends.
+*   sendmmsg() stops at the first message that fails; that message is charged
+*   to its destination and skipped so one bad peer cannot starve the rest of
+*   the batch.
+*
+*   Returns number of messages sent
+******************************************************************************/
+unsigned RTPForwarder::_send(unsigned count)
+{
+    unsigned sent = 0;
+    unsigned done = 0;
+
+    while (done < count) {
+        int rc = sendmmsg(_socket, &_msgs[done], count - done, 0);
+        _send_calls++;
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            RTPLOG(FORWARD_SEND_FAILED, errno);
+            _fail(done++);
+            continue;
+        }
+        if (rc == 0) {
+            RTPLOG(FORWARD_SEND_FAILED, 0);
+            _fail(done++);
+            continue;
+        }
+        done += rc;
+        sent += rc;
+    }
+    return sent;
+}
+
+
+
+/******************************************************************************
+*   Charges message 'msg' to its destination's error count and marks it as
+*   carrying nothing.
+*
+*   Returns nothing
+******************************************************************************/
+void RTPForwarder::_fail(unsigned msg)
+{
+    _destinations[_msg_dest[msg]].send_errors += _msg_packets[msg];
+    _send_errors += _msg_packets[msg];
+    _msg_packets[msg] = 0;
+}
@@ -0,0 +1,124 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_FORWARD_H_47c1b8e3_92d6_4e0a_a5f7_13b8e6d0c2a9
+#define RTP_FORWARD_H_47c1b8e3_92d6_4e0a_a5f7_13b8e6d0c2a9
+
+#include <vector>
+#include <sys/socket.h>
+#include "stdinc.h"
+#include "rtp.h"
+
+
+
+/******************************************************************************
+*   Forwarding sink for relays that de-jitter and then send packets on.
+*   Packets popped during one scheduler tick are queue()d per destination,
+*   then flush() sends the lot with a single sendmmsg() and drops our
+*   references, which returns pool-backed buffers to their pool.
+*
+*   With GSO enabled, a destination's batch of equally sized packets goes out
+*   as one UDP_SEGMENT datagram (the kernel splits it on the wire); batches
+*   that don't qualify fall back to one message per packet.
+*
+*   SSRC and sequence rewriting, when configured for a destination, is done
+*   in place on the packet header.  A packet that is still referenced
+*   elsewhere (e.g. the redundant copy kept in an RTPJitter) is copied first.
+*   Sequence numbers are remapped by a fixed offset so gaps are preserved.
+*
+*   Not thread safe: use one forwarder per scheduler worker, flushing it from
+*   that worker's tick callback.
+******************************************************************************/
+class RTPForwarder
+{
+public:
+    typedef unsigned destination_id;
+
+    struct rewrite
+    {
+        bool    ssrc;               // replace SSRC with new_ssrc
+        uint32  new_ssrc;
+        bool    sequence;           // renumber, first packet becomes first_sequence
+        uint16  first_sequence;
+
+        rewrite() : ssrc(false), new_ssrc(0), sequence(false), first_sequence(0) {}
+    };
+
+    static const unsigned MAX_GSO_SEGMENTS = 64;    // kernel UDP_MAX_SEGMENTS
+
+    RTPForwarder(const int socket = -1, const bool gso = false);
+    ~RTPForwarder();
+
+    destination_id  add_destination(const sockaddr *addr, const socklen_t addr_len,
+                                    const rewrite& rw = rewrite());
+    void            queue(const destination_id dest, rawrtp_ptr& packet);
+    unsigned        flush();
+
+    int     socket() const              { return _socket; }
+
+    // - statistics retrieval
+    uint64  packets_sent() const        { return _packets_sent; }
+    uint64  datagrams_sent() const      { return _datagrams_sent; }
+    uint64  send_calls() const          { return _send_calls; }
+    uint64  send_errors() const         { return _send_errors; }
+    uint64  send_errors(const destination_id dest) const
+                                        { return _destinations[dest].send_errors; }
+
+private:
+    struct destination
+    {
+        sockaddr_storage        addr;
+        socklen_t               addr_len;
+        rewrite                 rw;
+        bool                    have_offset;
+        uint16                  sequence_offset;
+        uint64                  send_errors;        // packets the kernel refused
+        std::vector<rawrtp_ptr> queued;
+    };
+
+    int                         _socket;
+    bool                        _own_socket;
+    bool                        _gso;
+    std::vector<destination>    _destinations;
+    std::vector<destination_id> _active;            // destinations with queued packets
+
+    // - scratch space reused across flushes
+    std::vector<mmsghdr>        _msgs;
+    std::vector<iovec>          _iovs;
+    std::vector<uint8>          _control;
+    std::vector<unsigned>       _msg_packets;       // packets carried by each message
+    std::vector<destination_id> _msg_dest;          // destination of each message
+
+    uint64                      _packets_sent;
+    uint64                      _datagrams_sent;
+    uint64                      _send_calls;
+    uint64                      _send_errors;
+
+    void        _rewrite(destination& d, rawrtp_ptr& packet);
+    bool        _gso_eligible(const destination& d);
+    unsigned    _send(unsigned count);
+    void        _fail(unsigned msg);
+};
+
+#endif  // RTP_FORWARD_H_47c1b8e3_92d6_4e0a_a5f7_13b8e6d0c2a9
@@ -0,0 +1,311 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   G.711 mu-law and A-law decoding.
+*
+******************************************************************************/
+
+#include "rtp_g711.h"
+#include "rtp_codec.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RTP_G711_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+namespace {
+
+const int16 ULAW_BIAS = 0x84;
+
+// the ITU reference expansions (as in the well known Sun g711.c)
+int16 ulaw_sample(uint8 u)
+{
+    u = ~u;
+    int16 t = (int16)((((u & 0x0f) << 3) + ULAW_BIAS) << ((u & 0x70) >> 4));
+    return (u & 0x80) ? (int16)(ULAW_BIAS - t) : (int16)(t - ULAW_BIAS);
+}
+
+int16 alaw_sample(uint8 a)
+{
+    a ^= 0x55;
+    int16       t = (int16)((a & 0x0f) << 4);
+    unsigned    segment = (a & 0x70) >> 4;
+
+    if (segment == 0) {
+        t += 8;
+    } else {
+        t = (int16)((t + 0x108) << (segment - 1));
+    }
+    return (a & 0x80) ? t : (int16)-t;
+}
+
+struct tables
+{
+    int16   ulaw[256];
+    int16   alaw[256];
+
+    tables()
+    {
+        for (unsigned i = 0; i < 256; ++i) {
+            ulaw[i] = ulaw_sample((uint8)i);
+            alaw[i] = alaw_sample((uint8)i);
+        }
+    }
+};
+
+const tables TABLES;
+
+
+#ifdef RTP_G711_X86
+
+// 2^segment for mu-law, 2^(segment - 1) (and 1 for segment 0) for A-law,
+//  as the low byte of each 16 bit lane; the 0x80 high index byte zeroes
+//  the high byte
+#define ULAW_POWERS     1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0
+#define ALAW_POWERS     1, 1, 2, 4, 8, 16, 32, 64, 0, 0, 0, 0, 0, 0, 0, 0
+
+__attribute__((target("sse4.1")))
+inline __m128i ulaw_8(const __m128i x)
+{
+    const __m128i powers = _mm_setr_epi8(ULAW_POWERS);
+
+    __m128i u = _mm_xor_si128(x, _mm_set1_epi16(0xff));
+    __m128i segment = _mm_and_si128(_mm_srli_epi16(u, 4), _mm_set1_epi16(7));
+    __m128i scale = _mm_shuffle_epi8(powers, _mm_or_si128(segment, _mm_set1_epi16((short)0x8000)));
+    __m128i t = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(u, _mm_set1_epi16(0x0f)), 3), _mm_set1_epi16(ULAW_BIAS));
+    t = _mm_sub_epi16(_mm_mullo_epi16(t, scale), _mm_set1_epi16(ULAW_BIAS));
+
+    __m128i negative = _mm_cmpgt_epi16(u, _mm_set1_epi16(0x7f));
+    return _mm_sub_epi16(_mm_xor_si128(t, negative), negative);
+}
+
+__attribute__((target("sse4.1")))
+inline __m128i alaw_8(const __m128i x)
+{
+    const __m128i powers = _mm_setr_epi8(ALAW_POWERS);
+
+    __m128i a = _mm_xor_si128(x, _mm_set1_epi16(0x55));
+    __m128i segment = _mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi16(7));
+    __m128i scale = _mm_shuffle_epi8(powers, _mm_or_si128(segment, _mm_set1_epi16((short)0x8000)));
+    // segment 0 adds 8, the others 0x108
+    __m128i bias = _mm_blendv_epi8(_mm_set1_epi16(0x108), _mm_set1_epi16(8),
+                                   _mm_cmpeq_epi16(segment, _mm_setzero_si128()));
+    __m128i t = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(a, _mm_set1_epi16(0x0f)), 4), bias);
+    t = _mm_mullo_epi16(t, scale);
+
+    // A-law's sign bit set means positive
+    __m128i negative = _mm_cmpgt_epi16(_mm_set1_epi16(0x80), a);
+    return _mm_sub_epi16(_mm_xor_si128(t, negative), negative);
+}
+
+__attribute__((target("avx2")))
+inline __m256i ulaw_16(const __m256i x)
+{
+    const __m256i powers = _mm256_setr_epi8(ULAW_POWERS, ULAW_POWERS);
+
+    __m256i u = _mm256_xor_si256(x, _mm256_set1_epi16(0xff));
+    __m256i segment = _mm256_and_si256(_mm256_srli_epi16(u, 4), _mm256_set1_epi16(7));
+    __m256i scale = _mm256_shuffle_epi8(powers, _mm256_or_si256(segment, _mm256_set1_epi16((short)0x8000)));
+    __m256i t = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(u, _mm256_set1_epi16(0x0f)), 3),
+                                 _mm256_set1_epi16(ULAW_BIAS));
+    t = _mm256_sub_epi16(_mm256_mullo_epi16(t, scale), _mm256_set1_epi16(ULAW_BIAS));
+
+    __m256i negative = _mm256_cmpgt_epi16(u, _mm256_set1_epi16(0x7f));
+    return _mm256_sub_epi16(_mm256_xor_si256(t, negative), negative);
+}
+
+__attribute__((target("avx2")))
+inline __m256i alaw_16(const __m256i x)
+{
+    const __m256i powers = _mm256_setr_epi8(ALAW_POWERS, ALAW_POWERS);
+
+    __m256i a = _mm256_xor_si256(x, _mm256_set1_epi16(0x55));
+    __m256i segment = _mm256_and_si256(_mm256_srli_epi16(a, 4), _mm256_set1_epi16(7));
+    __m256i scale = _mm256_shuffle_epi8(powers, _mm256_or_si256(segment, _mm256_set1_epi16((short)0x8000)));
+    __m256i bias = _mm256_blendv_epi8(_mm256_set1_epi16(0x108), _mm256_set1_epi16(8),
+                                      _mm256_cmpeq_epi16(segment, _mm256_setzero_si256()));
+    __m256i t = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x0f)), 4), bias);
+    t = _mm256_mullo_epi16(t, scale);
+
+    __m256i negative = _mm256_cmpgt_epi16(_mm256_set1_epi16(0x80), a);
+    return _mm256_sub_epi16(_mm256_xor_si256(t, negative), negative);
+}
+
+
+/******************************************************************************
+*   The vector loops.  Each widens 8 (SSE4.1) or 16 (AVX2) bytes to 16 bit
+*   lanes and decodes them in place.
+*
+*   Returns the number of samples done; the caller finishes the rest
+******************************************************************************/
+__attribute__((target("sse4.1")))
+unsigned decode_sse41(const uint8 *in, int16 *out, const unsigned count, const bool ulaw)
+{
+    unsigned i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)(in + i)));
+        _mm_storeu_si128((__m128i *)(out + i), ulaw ? ulaw_8(x) : alaw_8(x));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+unsigned decode_avx2(const uint8 *in, int16 *out, const unsigned count, const bool ulaw)
+{
+    unsigned i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(in + i)));
+        _mm256_storeu_si256((__m256i *)(out + i), ulaw ? ulaw_16(x) : alaw_16(x));
+    }
+    return i;
+}
+
+#endif  // RTP_G711_X86
+
+
+void decode_with(const uint8 *in, int16 *out, const unsigned count, const bool ulaw, RTPG711::kernel k)
+{
+    unsigned done = 0;
+
+    switch ((k == RTPG711::KERNEL_AUTO) ? RTPG711::best() : k) {
+#ifdef RTP_G711_X86
+    case RTPG711::KERNEL_AVX2:
+        done = decode_avx2(in, out, count, ulaw);
+        break;
+    case RTPG711::KERNEL_SSE41:
+        done = decode_sse41(in, out, count, ulaw);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    const int16 *table = ulaw ? TABLES.ulaw : TABLES.alaw;
+    for (unsigned i = done; i < count; ++i) {
+        out[i] = table[in[i]];
+    }
+}
+
+}   // namespace
+
+
+
+/******************************************************************************
+*   Expands 'count' mu-law or A-law bytes to 16 bit samples.
+*
+*   Returns none
+******************************************************************************/
+void RTPG711::decode_ulaw(const uint8 *in, int16 *out, const unsigned count, const kernel k /* = KERNEL_AUTO */)
+{
+    decode_with(in, out, count, true, k);
+}
+
+void RTPG711::decode_alaw(const uint8 *in, int16 *out, const unsigned count, const kernel k /* = KERNEL_AUTO */)
+{
+    decode_with(in, out, count, false, k);
+}
+
+
+
+/******************************************************************************
+*   Decodes a popped packet's payload into the caller's buffer, truncating to
+*   'capacity' samples.
+*
+*   Returns number of samples written, 0 if the packet is not G.711
+******************************************************************************/
+unsigned RTPG711::decode(const RTPPacket& packet, int16 *out, const unsigned capacity, const kernel k /* = KERNEL_AUTO */)
+{
+    if ((packet.pData == nullptr) || (packet.nLen < RTP_HEADER_LENGTH)) {
+        return 0;
+    }
+
+    uint8       payload_type = packet.pData[1] & RTP_FLAGS_PAYLOAD_TYPE;
+    unsigned    length = rtp_payload_length(packet.pData, packet.nLen);
+    unsigned    count = (length < capacity) ? length : capacity;
+    const uint8 *payload = packet.pData + rtp_payload_offset(packet.pData, packet.nLen);
+
+    if ((payload_type != RTP_PAYLOAD_G711U) && (payload_type != RTP_PAYLOAD_G711A)) {
+        return 0;
+    }
+    decode_with(payload, out, count, payload_type == RTP_PAYLOAD_G711U, k);
+    return count;
+}
+
+
+
+/******************************************************************************
+*   As above, into a block from 'pool', which must hold at least 2 bytes per
+*   sample; samples beyond the block are dropped.  Nothing is allocated if
+*   the pool has a free block.
+*
+*   Returns the samples (sharing ownership of the block), nullptr if the
+*   packet is not G.711; 'samples' receives the count
+******************************************************************************/
+shared_ptr<int16> RTPG711::decode(const RTPPacket& packet, RTPBufferPool& pool, unsigned& samples,
+                                  const kernel k /* = KERNEL_AUTO */)
+{
+    shared_ptr<uint8> block = pool.acquire();
+    int16 *out = reinterpret_cast<int16 *>(block.get());
+
+    samples = decode(packet, out, (unsigned)(pool.block_size() / sizeof(int16)), k);
+    if (samples == 0) {
+        return nullptr;
+    }
+    return shared_ptr<int16>(block, out);
+}
+
+
+
+/******************************************************************************
+*   The fastest kernel this CPU supports, checked once.
+*
+*   Returns kernel
+******************************************************************************/
+RTPG711::kernel RTPG711::best()
+{
+#ifdef RTP_G711_X86
+    __builtin_cpu_init();
+    static const kernel chosen = __builtin_cpu_supports("avx2")   ? KERNEL_AVX2
+                               : __builtin_cpu_supports("sse4.1") ? KERNEL_SSE41
+                               : KERNEL_SCALAR;
+    return chosen;
+#else
+    return KERNEL_SCALAR;
+#endif
+}
+
+const char *RTPG711::name(const kernel k)
+{
+    switch (k) {
+    case KERNEL_SCALAR: return "scalar";
+    case KERNEL_SSE41:  return "sse4.1";
+    case KERNEL_AVX2:   return "avx2";
+    default:            return name(best());
+    }
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_G711_H_1f8d6b27_94c3_4e0a_a572_c3b08e9d1f64
+#define RTP_G711_H_1f8d6b27_94c3_4e0a_a572_c3b08e9d1f64
+
+#include <memory>
+#include "stdinc.h"
+#include "rtp.h"
+#include "rtp_pool.h"
+
+
+
+/******************************************************************************
+*   G.711 decoding of popped packets to 16 bit linear PCM.
+*
+*   The vector kernels decode arithmetically, 16 samples per step with AVX2
+*   and 8 with SSE4.1: the segment (exponent) picks a power of two through a
+*   byte shuffle, which scales the mantissa with a 16 bit multiply.  The
+*   scalar kernel is the usual 256 entry table and is the reference; all of
+*   them give identical samples for every input byte.
+******************************************************************************/
+class RTPG711
+{
+public:
+    enum kernel
+    {
+        KERNEL_AUTO = 0,            // the best this CPU runs
+        KERNEL_SCALAR,
+        KERNEL_SSE41,
+        KERNEL_AVX2
+    };
+
+    static void decode_ulaw(const uint8 *in, int16 *out, const unsigned count, const kernel k = KERNEL_AUTO);
+    static void decode_alaw(const uint8 *in, int16 *out, const unsigned count, const kernel k = KERNEL_AUTO);
+
+    // - decodes a PCMU or PCMA packet's payload, by the payload type in its
+    //  header, into 'out' (room for 'capacity' samples) or into a block from
+    //  'pool'.  Other payload types decode to nothing.
+    static unsigned decode(const RTPPacket& packet, int16 *out, const unsigned capacity, const kernel k = KERNEL_AUTO);
+    static std::shared_ptr<int16> decode(const RTPPacket& packet, RTPBufferPool& pool, unsigned& samples,
+                                         const kernel k = KERNEL_AUTO);
+
+    static kernel       best();
+    static const char  *name(const kernel k);
+};
+
+#endif  // RTP_G711_H_1f8d6b27_94c3_4e0a_a572_c3b08e9d1f64
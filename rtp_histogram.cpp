@@ -0,0 +1,159 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   log-linear latency histogram.
+*
+******************************************************************************/
+
+#include "rtp_histogram.h"
+
+using namespace std;
+
+
+/******************************************************************************
+*   Starts out empty.
+*
+*   Returns n/a
+******************************************************************************/
+RTPLatencyHistogram::RTPLatencyHistogram()
+{
+    clear();
+}
+
+
+
+/******************************************************************************
+*   Counts one value.  Only one thread may record at a time, so the counts
+*   are bumped with a plain load and store rather than a locked add.
+*
+*   Returns none
+******************************************************************************/
+void RTPLatencyHistogram::record(const uint64 value)
+{
+    atomic<uint64>& bucket = _buckets[bucket_index(value)];
+
+    bucket.store(bucket.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    _count.store(_count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    _sum.store(_sum.load(memory_order_relaxed) + value, memory_order_relaxed);
+    if (value > _max.load(memory_order_relaxed)) {
+        _max.store(value, memory_order_relaxed);
+    }
+}
+
+
+
+/******************************************************************************
+*   Forgets everything recorded so far.  Same threading rules as record().
+*
+*   Returns none
+******************************************************************************/
+void RTPLatencyHistogram::clear()
+{
+    for (unsigned i = 0; i < BUCKETS; ++i) {
+        _buckets[i].store(0, memory_order_relaxed);
+    }
+    _count.store(0, memory_order_relaxed);
+    _max.store(0, memory_order_relaxed);
+    _sum.store(0, memory_order_relaxed);
+}
+
+
+
+/******************************************************************************
+*   Finds the value at quantile 'q' (0.0 - 1.0), reported as the highest value
+*   that falls in the same bucket -- i.e. "q of the values were at most this"
+*   -- but never more than the largest value actually recorded.
+*
+*   Returns the value, or 0 if nothing has been recorded
+******************************************************************************/
+uint64 RTPLatencyHistogram::percentile(const double q) const
+{
+    uint64  total = count();
+    uint64  largest = max();
+    uint64  seen = 0;
+
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64 target = (uint64)(q * (double)total + 0.5);
+    if (target < 1) target = 1;
+    if (target > total) target = total;
+
+    for (unsigned i = 0; i < BUCKETS; ++i) {
+        seen += bucket_count(i);
+        if (seen >= target) {
+            uint64 high = bucket_high(i);
+            return (high < largest) ? high : largest;
+        }
+    }
+    return largest;
+}
+
+
+
+/******************************************************************************
+*   Maps a value to its bucket.  The first 2 * SUB_BUCKETS values map to
+*   themselves; after that the bucket is chosen by the position of the top bit
+*   (which power of two) and the SUB_BUCKET_BITS bits below it.
+*
+*   Returns bucket index
+******************************************************************************/
+unsigned RTPLatencyHistogram::bucket_index(const uint64 value)
+{
+    if (value > MAX_VALUE) {
+        return BUCKETS - 1;
+    }
+    if (value < (2 * SUB_BUCKETS)) {
+        return (unsigned)value;
+    }
+
+    unsigned top_bit = 63 - __builtin_clzll(value);
+    unsigned shift = top_bit - SUB_BUCKET_BITS;
+    return (shift * SUB_BUCKETS) + (unsigned)(value >> shift);
+}
+
+
+
+/******************************************************************************
+*   Lowest value that maps to the given bucket.
+******************************************************************************/
+uint64 RTPLatencyHistogram::bucket_low(const unsigned index)
+{
+    unsigned shift = (index < (2 * SUB_BUCKETS)) ? 0 : (index / SUB_BUCKETS) - 1;
+    uint64 sub = index - (shift * SUB_BUCKETS);
+    return sub << shift;
+}
+
+
+
+/******************************************************************************
+*   Highest value that maps to the given bucket.
+******************************************************************************/
+uint64 RTPLatencyHistogram::bucket_high(const unsigned index)
+{
+    unsigned shift = (index < (2 * SUB_BUCKETS)) ? 0 : (index / SUB_BUCKETS) - 1;
+    uint64 sub = index - (shift * SUB_BUCKETS);
+    return ((sub + 1) << shift) - 1;
+}
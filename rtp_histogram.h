@@ -0,0 +1,78 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_HISTOGRAM_H_3c7a1e52_94d8_4b06_8f2e_a61b5d0c7e94
+#define RTP_HISTOGRAM_H_3c7a1e52_94d8_4b06_8f2e_a61b5d0c7e94
+
+#include <atomic>
+#include "stdinc.h"
+
+
+
+/******************************************************************************
+*   Fixed-bucket log-linear histogram in the style of HdrHistogram.  Values
+*   below 32 get a bucket each; above that, every power of two is split into
+*   16 linear sub-buckets, so any recorded value is known to within 1/16
+*   (about 6%).  Values past MAX_VALUE are counted in the last bucket.
+*
+*   record() is constant time -- one count-leading-zeros and a couple of
+*   shifts.  It must only be called by one thread at a time (RTPJitter calls
+*   it under its lock), but the counts are atomics so any thread may read
+*   percentiles concurrently without locking; such a read is approximate
+*   only in that a record() may land part way through it.
+******************************************************************************/
+class RTPLatencyHistogram
+{
+public:
+    static const unsigned SUB_BUCKET_BITS = 4;
+    static const unsigned SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+    static const unsigned MAX_SHIFT       = 26;
+    static const unsigned BUCKETS         = (MAX_SHIFT + 2) * SUB_BUCKETS;
+    static const uint64   MAX_VALUE       = ((uint64)(2 * SUB_BUCKETS) << MAX_SHIFT) - 1;
+
+    RTPLatencyHistogram();
+
+    void    record(const uint64 value);
+    void    clear();
+
+    uint64  count() const               { return _count.load(std::memory_order_relaxed); }
+    uint64  max() const                 { return _max.load(std::memory_order_relaxed); }
+    uint64  sum() const                 { return _sum.load(std::memory_order_relaxed); }
+    uint64  bucket_count(const unsigned index) const
+                                        { return _buckets[index].load(std::memory_order_relaxed); }
+    uint64  percentile(const double q) const;
+
+    // value range covered by a bucket
+    static unsigned bucket_index(const uint64 value);
+    static uint64   bucket_low(const unsigned index);
+    static uint64   bucket_high(const unsigned index);
+
+private:
+    std::atomic<uint64>     _buckets[BUCKETS];
+    std::atomic<uint64>     _count;
+    std::atomic<uint64>     _max;
+    std::atomic<uint64>     _sum;
+};
+
+#endif  // RTP_HISTOGRAM_H_3c7a1e52_94d8_4b06_8f2e_a61b5d0c7e94
@@ -0,0 +1,556 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   sharded SO_REUSEPORT receiver feeding per-flow RTPJitter instances.
+*
+*   See rtp_ingest.h for a description of the threading model.
+*
+******************************************************************************/
+
+#include "rtp_ingest.h"
+#include "rtp_log.h"
+#include <cerrno>
+#include <ctime>
+#include <arpa/inet.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+/******************************************************************************
+*   FNV-1a over the significant bytes of the key.  The kernel has already
+*   spread flows across shards; this only needs to spread them across buckets.
+******************************************************************************/
+size_t RTPFlowKeyHash::operator()(const RTPFlowKey& key) const
+{
+    uint64  h = 14695981039346656037ULL;
+    size_t  len = (key.family == AF_INET6) ? 16 : 4;
+
+    for (size_t i = 0; i < len; ++i) {
+        h = (h ^ key.addr[i]) * 1099511628211ULL;
+    }
+    h = (h ^ (key.port & 0xff)) * 1099511628211ULL;
+    h = (h ^ (key.port >> 8)) * 1099511628211ULL;
+
+    return (size_t)h;
+}
+
+
+
+/******************************************************************************
+*   Nothing is opened until start().
+*
+*   Returns n/a
+******************************************************************************/
+RTPIngest::RTPIngest(const config& cfg) : _config(cfg), _running(false)
+{
+    if (_config.shards == 0) {
+        _config.shards = 1;
+    }
+    if (_config.batch == 0) {
+        _config.batch = 1;
+    }
+}
+
+
+
+/******************************************************************************
+*   Stops the receive threads; the flows (and their buffers) die with the
+*   shards.
+*
+*   Returns n/a
+******************************************************************************/
+RTPIngest::~RTPIngest()
+{
+    stop();
+}
+
+
+
+/******************************************************************************
+*   Opens one SO_REUSEPORT socket per shard and starts the receive threads.
+*   All sockets are opened before any thread starts so that the kernel's
+*   reuseport group is complete before the first packet is hashed.
+*
+*   Returns true on success, false if any socket could not be opened/bound
+******************************************************************************/
+bool RTPIngest::start()
+{
+    if (_running.load()) {
+        return true;
+    }
+
+    _shards.clear();
+    for (unsigned i = 0; i < _config.shards; ++i) {
+        unique_ptr<Shard> shard(new Shard());
+        shard->_index = i;
+        shard->_socket = _open_socket();
+        if (shard->_socket < 0) {
+            _close_sockets();
+            _shards.clear();
+            return false;
+        }
+        if (_config.first_cpu >= 0) {
+            unsigned cpus = thread::hardware_concurrency();
+            shard->_cpu = (_config.first_cpu + i) % (cpus ? cpus : 1);
+        }
+        shard->_rx_control.resize(_config.batch * MAX_CONTROL);
+        shard->_rx_buffers.resize(_config.batch * (_config.gro ? MAX_GRO_DATAGRAM : MAX_DATAGRAM));
+        _shards.push_back(move(shard));
+    }
+
+    _running = true;
+    for (auto& shard : _shards) {
+        shard->_thread = thread(&RTPIngest::_receive, this, shard.get());
+    }
+    return true;
+}
+
+
+
+/******************************************************************************
+*   Signals the receive threads to exit and waits for them.  Receive threads
+*   wake up at least every poll_ms, so this does not block for long.
+*
+*   Returns none
+******************************************************************************/
+void RTPIngest::stop()
+{
+    if (!_running.exchange(false)) {
+        return;
+    }
+    for (auto& shard : _shards) {
+        if (shard->_thread.joinable()) {
+            shard->_thread.join();
+        }
+    }
+    _close_sockets();
+}
+
+
+
+/******************************************************************************
+*   Sums the per-shard counters.  Values are approximate while running.
+******************************************************************************/
+uint64 RTPIngest::packets() const
+{
+    uint64 total = 0;
+    for (auto& shard : _shards) {
+        total += shard->packets();
+    }
+    return total;
+}
+
+uint64 RTPIngest::datagrams() const
+{
+    uint64 total = 0;
+    for (auto& shard : _shards) {
+        total += shard->datagrams();
+    }
+    return total;
+}
+
+uint64 RTPIngest::bytes() const
+{
+    uint64 total = 0;
+    for (auto& shard : _shards) {
+        total += shard->bytes();
+    }
+    return total;
+}
+
+
+
+/******************************************************************************
+*   Creates a UDP socket bound to the configured address and port with
+*   SO_REUSEPORT set, so that every shard can bind the same port.
+*
+*   Returns socket descriptor, -1 on error
+******************************************************************************/
+int RTPIngest::_open_socket()
+{
+    sockaddr_storage    local;
+    socklen_t           local_len;
+    int                 one = 1;
+
+    memset(&local, 0, sizeof(local));
+
+    sockaddr_in     *v4 = reinterpret_cast<sockaddr_in *>(&local);
+    sockaddr_in6    *v6 = reinterpret_cast<sockaddr_in6 *>(&local);
+    if (_config.address.empty()
+     || (inet_pton(AF_INET, _config.address.c_str(), &v4->sin_addr) == 1))
+    {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(_config.port);
+        local_len = sizeof(sockaddr_in);
+    } else if (inet_pton(AF_INET6, _config.address.c_str(), &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(_config.port);
+        local_len = sizeof(sockaddr_in6);
+    } else {
+        LOGD("RTPIngest::_open_socket(): bad address: %s\n", _config.address.c_str());
+        return -1;
+    }
+
+    int s = socket(local.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (s < 0) {
+        LOGD("RTPIngest::_open_socket(): socket() failed: %d\n", errno);
+        return -1;
+    }
+
+    if (setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        LOGD("RTPIngest::_open_socket(): SO_REUSEPORT failed: %d\n", errno);
+        close(s);
+        return -1;
+    }
+    if (_config.rcvbuf > 0) {
+        setsockopt(s, SOL_SOCKET, SO_RCVBUF, &_config.rcvbuf, sizeof(_config.rcvbuf));
+    }
+    if (!_enable_timestamps(s)) {
+        close(s);
+        return -1;
+    }
+    if (_config.gro && (setsockopt(s, SOL_UDP, UDP_GRO, &one, sizeof(one)) < 0)) {
+        LOGD("RTPIngest::_open_socket(): UDP_GRO failed: %d\n", errno);
+        close(s);
+        return -1;
+    }
+    if (::bind(s, reinterpret_cast<sockaddr *>(&local), local_len) < 0) {
+        LOGD("RTPIngest::_open_socket(): bind() to port %d failed: %d\n", _config.port, errno);
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+
+
+/******************************************************************************
+*   Asks the kernel to attach receive timestamps to every datagram, as
+*   selected by config.timestamps.  Hardware stamps additionally require the
+*   NIC to be configured (SIOCSHWTSTAMP), which is left to the host setup.
+*
+*   Returns true on success, or when no timestamps were requested
+******************************************************************************/
+bool RTPIngest::_enable_timestamps(const int s)
+{
+    int rc = 0;
+    int flags = 0;
+    int one = 1;
+
+    switch (_config.timestamps) {
+    case TIMESTAMP_NS:
+        rc = setsockopt(s, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one));
+        break;
+    case TIMESTAMP_SOFTWARE:
+        flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        rc = setsockopt(s, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+        break;
+    case TIMESTAMP_HARDWARE:
+        flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+        rc = setsockopt(s, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+        break;
+    default:
+        break;
+    }
+
+    if (rc < 0) {
+        LOGD("RTPIngest::_enable_timestamps(): setsockopt failed: %d\n", errno);
+    }
+    return (rc == 0);
+}
+
+
+
+/******************************************************************************
+*   Pulls the kernel receive timestamp out of a datagram's control messages.
+*   Kernel stamps are CLOCK_REALTIME and our buffers run on the steady
+*   clock; the realtime-to-steady offset is sampled once per receive batch by
+*   the caller rather than once per packet.
+*
+*   Returns arrival time, or stdclock::now() if the datagram carried no stamp
+******************************************************************************/
+timepoint RTPIngest::_arrival(msghdr& msg, const int64 realtime_offset_ns)
+{
+    const timespec *ts = nullptr;
+
+    for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+        if (cm->cmsg_type == SCM_TIMESTAMPNS) {
+            ts = reinterpret_cast<const timespec *>(CMSG_DATA(cm));
+        } else if (cm->cmsg_type == SCM_TIMESTAMPING) {
+            // [0] is the software stamp, [2] the raw hardware stamp
+            const scm_timestamping *tss = reinterpret_cast<const scm_timestamping *>(CMSG_DATA(cm));
+            ts = (_config.timestamps == TIMESTAMP_HARDWARE) ? &tss->ts[2] : &tss->ts[0];
+        }
+    }
+
+    if ((ts == nullptr) || ((ts->tv_sec == 0) && (ts->tv_nsec == 0))) {
+        return stdclock::now();
+    }
+
+    int64 real_ns = ((int64)ts->tv_sec * 1000000000LL) + ts->tv_nsec;
+    return timepoint(clocks::nanoseconds(real_ns - realtime_offset_ns));
+}
+
+
+
+/******************************************************************************
+*   Closes any sockets still open.
+*
+*   Returns none
+******************************************************************************/
+void RTPIngest::_close_sockets()
+{
+    for (auto& shard : _shards) {
+        if (shard->_socket >= 0) {
+            close(shard->_socket);
+            shard->_socket = -1;
+        }
+    }
+}
+
+
+
+/******************************************************************************
+*   Receive loop for one shard.  Pulls up to 'batch' datagrams per recvmmsg()
+*   call, pushes each into the buffer owned for its flow, and then hands the
+*   shard to the application so it can service its buffers on this thread.
+*
+*   Datagrams land in receive buffers that are reused on the next call, so
+*   each is copied out before it is pushed: a plain one into its own
+*   RTPPacket, a GRO-coalesced one -- many same-flow RTP packets -- into one
+*   block of exactly its length, which _push_segments() splits into views.
+*
+*   Returns none
+******************************************************************************/
+void RTPIngest::_receive(Shard *shard)
+{
+    const unsigned          batch = _config.batch;
+    vector<mmsghdr>         msgs(batch);
+    vector<iovec>           iovs(batch);
+    vector<sockaddr_storage> addrs(batch);
+
+    if (shard->_cpu >= 0) {
+        _pin_thread(shard->_cpu);
+    }
+    RTPLog::attach_thread();
+
+    const unsigned          rx_size = _config.gro ? MAX_GRO_DATAGRAM : MAX_DATAGRAM;
+    for (unsigned i = 0; i < batch; ++i) {
+        iovs[i].iov_base = &shard->_rx_buffers[i * rx_size];
+        iovs[i].iov_len = rx_size;
+    }
+
+    pollfd pfd;
+    pfd.fd = shard->_socket;
+    pfd.events = POLLIN;
+
+    const bool want_control = (_config.timestamps != TIMESTAMP_NONE) || _config.gro;
+
+    while (_running.load(memory_order_relaxed)) {
+        int n = 0;
+        if (poll(&pfd, 1, _config.poll_ms) > 0) {
+            for (unsigned i = 0; i < batch; ++i) {
+                memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+                msgs[i].msg_hdr.msg_name = &addrs[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                if (want_control) {
+                    msgs[i].msg_hdr.msg_control = &shard->_rx_control[i * MAX_CONTROL];
+                    msgs[i].msg_hdr.msg_controllen = MAX_CONTROL;
+                }
+            }
+            n = recvmmsg(shard->_socket, msgs.data(), batch, MSG_DONTWAIT, nullptr);
+        }
+
+        // realtime minus steady, sampled once for the whole batch
+        int64 realtime_offset_ns = 0;
+        if ((n > 0) && (_config.timestamps != TIMESTAMP_NONE)) {
+            timespec real_now;
+            clock_gettime(CLOCK_REALTIME, &real_now);
+            realtime_offset_ns = ((int64)real_now.tv_sec * 1000000000LL) + real_now.tv_nsec
+                               - clocks::duration_cast<clocks::nanoseconds>(stdclock::now().time_since_epoch()).count();
+        }
+
+        for (int i = 0; i < n; ++i) {
+            unsigned len = msgs[i].msg_len;
+            shard->_bytes.fetch_add(len, memory_order_relaxed);
+            shard->_datagrams.fetch_add(1, memory_order_relaxed);
+
+            if ((len < RTP_HEADER_LENGTH) || (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)) {
+                shard->_packets.fetch_add(1, memory_order_relaxed);
+                shard->_bad_packets.fetch_add(1, memory_order_relaxed);
+                continue;
+            }
+
+            RTPFlowKey key;
+            memset(&key, 0, sizeof(key));
+            key.family = (uint8)addrs[i].ss_family;
+            if (key.family == AF_INET6) {
+                sockaddr_in6 *from = reinterpret_cast<sockaddr_in6 *>(&addrs[i]);
+                memcpy(key.addr, &from->sin6_addr, 16);
+                key.port = from->sin6_port;
+            } else {
+                sockaddr_in *from = reinterpret_cast<sockaddr_in *>(&addrs[i]);
+                memcpy(key.addr, &from->sin_addr, 4);
+                key.port = from->sin_port;
+            }
+
+            RTPJitter *jitter = _get_flow(shard, key);
+            timepoint arrival = (_config.timestamps != TIMESTAMP_NONE)
+                              ? _arrival(msgs[i].msg_hdr, realtime_offset_ns)
+                              : stdclock::now();
+
+            unsigned segment_size = _config.gro ? _gro_segment_size(msgs[i].msg_hdr) : 0;
+            if ((segment_size > 0) && (segment_size < len)) {
+                _push_segments(shard, jitter, (const uint8 *)iovs[i].iov_base, len, segment_size, arrival);
+            } else {
+                shard->_packets.fetch_add(1, memory_order_relaxed);
+                rawrtp_ptr packet = make_shared<RTPPacket>((uint8 *)iovs[i].iov_base, len);
+                if (jitter->push(move(packet), arrival) == RTPJitter::BAD_PACKET) {
+                    shard->_bad_packets.fetch_add(1, memory_order_relaxed);
+                }
+            }
+        }
+
+        if (_on_shard) {
+            _on_shard(*shard);
+        }
+    }
+}
+
+
+
+/******************************************************************************
+*   Splits a GRO-coalesced datagram into one RTPPacket per segment and pushes
+*   them to the flow's buffer as a single batch.  Every segment is
+*   segment_size bytes except possibly the last.
+*
+*   The datagram is copied out of the 64 KB receive buffer, which is reused,
+*   into one block of exactly 'len' bytes; the packets are views into it and
+*   each answers for its own bytes, so together they account for the block.
+*
+*   Returns none
+******************************************************************************/
+void RTPIngest::_push_segments(Shard *shard, RTPJitter *jitter, const uint8 *data,
+                               const unsigned len, const unsigned segment_size, const timepoint arrival)
+{
+    vector<rawrtp_ptr>& segments = shard->_segments;
+    unsigned            step = segment_size;
+    shared_ptr<uint8>   block(new uint8[len], default_delete<uint8[]>());
+
+    memcpy(block.get(), data, len);
+    segments.clear();
+    for (unsigned offset = 0; offset < len; offset += step) {
+        unsigned seg_len = ((len - offset) < step) ? (len - offset) : step;
+        if (seg_len < RTP_HEADER_LENGTH) {
+            shard->_bad_packets.fetch_add(1, memory_order_relaxed);
+            continue;
+        }
+        segments.push_back(make_shared<RTPPacket>(block, block.get() + offset, (uint16)seg_len));
+    }
+
+    unsigned count = (unsigned)segments.size();
+    unsigned accepted = jitter->push_batch(segments.data(), count, arrival);
+
+    shard->_packets.fetch_add(count, memory_order_relaxed);
+    shard->_bad_packets.fetch_add(count - accepted, memory_order_relaxed);
+    segments.clear();
+}
+
+
+
+/******************************************************************************
+*   Finds the UDP_GRO control message giving the size of each coalesced
+*   segment.
+*
+*   Returns segment size, or 0 if the datagram was not coalesced
+******************************************************************************/
+unsigned RTPIngest::_gro_segment_size(msghdr& msg)
+{
+    for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+        if ((cm->cmsg_level == SOL_UDP) && (cm->cmsg_type == UDP_GRO)) {
+            int size;
+            memcpy(&size, CMSG_DATA(cm), sizeof(size));
+            return (size > 0) ? (unsigned)size : 0;
+        }
+    }
+    return 0;
+}
+
+
+
+/******************************************************************************
+*   Looks up the buffer owned for the given flow, creating it (and telling the
+*   application about it) on first sight.
+*
+*   Returns pointer to the flow's jitter buffer
+******************************************************************************/
+RTPJitter *RTPIngest::_get_flow(Shard *shard, const RTPFlowKey& key)
+{
+    flow_map::iterator i = shard->_flows.find(key);
+    if (i != shard->_flows.end()) {
+        return i->second.get();
+    }
+
+    RTPJitter *jitter = new RTPJitter(_config.depth_ms, _config.sample_rate);
+    shard->_flows[key].reset(jitter);
+    shard->_flow_count.fetch_add(1, memory_order_relaxed);
+    if (_on_flow) {
+        _on_flow(*shard, key, *jitter);
+    }
+    return jitter;
+}
+
+
+
+/******************************************************************************
+*   Pins the calling thread to a single CPU.
+*
+*   Returns true on success
+******************************************************************************/
+bool RTPIngest::_pin_thread(const int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) {
+        LOGD("RTPIngest::_pin_thread(): could not pin to cpu %d: %d\n", cpu, rc);
+    }
+    return (rc == 0);
+}
@@ -0,0 +1,203 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_INGEST_H_5b0f2d8e_6c41_4a97_b1e3_2f7d9a0c8e15
+#define RTP_INGEST_H_5b0f2d8e_6c41_4a97_b1e3_2f7d9a0c8e15
+
+#include <atomic>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include "stdinc.h"
+#include "rtp_jitter.h"
+
+
+
+/******************************************************************************
+*   Identifies a single RTP flow as the kernel sees it: the remote address and
+*   port.  SO_REUSEPORT hashes on the 4-tuple, so every packet of a given flow
+*   lands on the same socket -- and therefore the same shard.
+******************************************************************************/
+struct RTPFlowKey
+{
+    uint8   addr[16];           // IPv4 addresses use the first 4 bytes
+    uint16  port;               // network byte order
+    uint8   family;             // AF_INET or AF_INET6
+
+    bool operator==(const RTPFlowKey& other) const
+    {
+        return (port == other.port)
+            && (family == other.family)
+            && (memcmp(addr, other.addr, sizeof(addr)) == 0);
+    }
+};
+
+struct RTPFlowKeyHash
+{
+    size_t operator()(const RTPFlowKey& key) const;
+};
+
+
+
+/******************************************************************************
+*   Multi-socket RTP receiver.  Opens one SO_REUSEPORT socket per shard on the
+*   same port and runs one receive thread per shard, optionally pinned to its
+*   own core.  Each shard exclusively owns the RTPJitter instances for the
+*   flows the kernel hashes to its socket, so push() is never called for the
+*   same buffer from two cores.
+*
+*   The application gets at its buffers through two callbacks, both of which
+*   are invoked on the owning shard's thread:
+*
+*       flow_callback   - a new flow was seen and its buffer was created
+*       shard_callback  - after every receive batch (or poll timeout); this is
+*                         the place to pop() the shard's buffers without
+*                         crossing cores.
+******************************************************************************/
+class RTPIngest
+{
+public:
+    // where packet arrival times come from
+    enum timestamp_source
+    {
+        TIMESTAMP_NONE = 0,         // stdclock::now() when the packet is pushed
+        TIMESTAMP_NS,               // SO_TIMESTAMPNS
+        TIMESTAMP_SOFTWARE,         // SO_TIMESTAMPING, kernel software rx stamp
+        TIMESTAMP_HARDWARE          // SO_TIMESTAMPING, raw NIC stamp (PHC must track CLOCK_REALTIME)
+    };
+
+    struct config
+    {
+        std::string address;        // local address to bind, "" for any
+        uint16      port;
+        unsigned    shards;         // number of SO_REUSEPORT sockets/threads
+        int         first_cpu;      // shard n pinned to first_cpu + n; -1 = no pinning
+        unsigned    depth_ms;       // nominal depth of each new RTPJitter
+        uint32      sample_rate;
+        unsigned    batch;          // datagrams per recvmmsg() call
+        int         rcvbuf;         // SO_RCVBUF in bytes, 0 for system default
+        int         poll_ms;        // shard_callback cadence when idle
+        timestamp_source timestamps;
+        bool        gro;            // UDP_GRO: receive coalesced same-flow datagrams
+                                    //  (up to 64 KB per receive buffer).  Each one is
+                                    //  copied once, into a block of its own length,
+                                    //  and its packets are views into that block --
+                                    //  receiving straight into blocks the packets
+                                    //  keep would pin 64 KB for every datagram that
+                                    //  sits in a buffer, however short it is.
+
+        config()
+            : port(0), shards(1), first_cpu(-1), depth_ms(60),
+              sample_rate(8000), batch(32), rcvbuf(0), poll_ms(10),
+              timestamps(TIMESTAMP_NS), gro(false) {}
+    };
+
+    class Shard;
+
+    typedef std::unordered_map<RTPFlowKey, std::unique_ptr<RTPJitter>, RTPFlowKeyHash> flow_map;
+    typedef std::function<void(Shard& shard, const RTPFlowKey& key, RTPJitter& jitter)> flow_callback;
+    typedef std::function<void(Shard& shard)> shard_callback;
+
+    // one socket, one thread, and the flows it owns.  Everything except the
+    //  counters must only be touched from the shard's own thread.
+    class Shard
+    {
+    public:
+        unsigned    index() const           { return _index; }
+        flow_map&   flows()                 { return _flows; }
+
+        uint64      packets() const         { return _packets.load(std::memory_order_relaxed); }
+        uint64      datagrams() const       { return _datagrams.load(std::memory_order_relaxed); }
+        uint64      bytes() const           { return _bytes.load(std::memory_order_relaxed); }
+        uint64      bad_packets() const     { return _bad_packets.load(std::memory_order_relaxed); }
+        uint64      flow_count() const      { return _flow_count.load(std::memory_order_relaxed); }
+
+    private:
+        friend class RTPIngest;
+
+        unsigned                _index;
+        int                     _socket;
+        int                     _cpu;
+        std::thread             _thread;
+        flow_map                _flows;
+        std::vector<uint8>      _rx_buffers;        // reused; packets get copies
+        std::vector<uint8>      _rx_control;
+        std::vector<rawrtp_ptr> _segments;
+        std::atomic<uint64>     _packets;           // RTP packets, after GRO split
+        std::atomic<uint64>     _datagrams;         // as returned by recvmmsg()
+        std::atomic<uint64>     _bytes;
+        std::atomic<uint64>     _bad_packets;
+        std::atomic<uint64>     _flow_count;
+
+        Shard() : _index(0), _socket(-1), _cpu(-1),
+                  _packets(0), _datagrams(0), _bytes(0), _bad_packets(0), _flow_count(0) {}
+    };
+
+    static const unsigned MAX_DATAGRAM = 2048;
+    static const unsigned MAX_CONTROL  = 128;
+    static const unsigned MAX_GRO_DATAGRAM = 65536;
+
+    RTPIngest(const config& cfg);
+    ~RTPIngest();
+
+    void    set_flow_callback(flow_callback cb)     { _on_flow = cb; }
+    void    set_shard_callback(shard_callback cb)   { _on_shard = cb; }
+
+    bool    start();
+    void    stop();
+    bool    running() const                         { return _running.load(); }
+
+    unsigned    shard_count() const                 { return (unsigned)_shards.size(); }
+    Shard&      shard(const unsigned n)             { return *_shards[n]; }
+
+    // - aggregate counters across all shards
+    uint64  packets() const;
+    uint64  datagrams() const;
+    uint64  bytes() const;
+
+private:
+    config                              _config;
+    std::vector<std::unique_ptr<Shard>> _shards;
+    std::atomic<bool>                   _running;
+    flow_callback                       _on_flow;
+    shard_callback                      _on_shard;
+
+    int         _open_socket();
+    void        _close_sockets();
+    bool        _enable_timestamps(const int s);
+    timepoint   _arrival(msghdr& msg, const int64 realtime_offset_ns);
+    void        _receive(Shard *shard);
+    void        _push_segments(Shard *shard, RTPJitter *jitter, const uint8 *data,
+                               const unsigned len, const unsigned segment_size, const timepoint arrival);
+    static unsigned _gro_segment_size(msghdr& msg);
+    RTPJitter  *_get_flow(Shard *shard, const RTPFlowKey& key);
+    static bool _pin_thread(const int cpu);
+};
+
+#endif  // RTP_INGEST_H_5b0f2d8e_6c41_4a97_b1e3_2f7d9a0c8e15
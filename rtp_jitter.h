@@ -25,14 +25,22 @@
 #ifndef RTP_JITTER_H_cc8e302e_b008_4588_a29a_79a9f555804d
 #define RTP_JITTER_H_cc8e302e_b008_4588_a29a_79a9f555804d
 
-#include <deque>
+#include <atomic>
 #include <memory>
 #include "stdinc.h"
 #include "rtp.h"
+#include "rtp_histogram.h"
+#include "rtp_jitter_policy.h"
+#include "rtp_memory.h"
+#include "rtp_parse.h"
+#include "rtp_rtcp.h"
 
 
 
-class RTPJitter
+/******************************************************************************
+*   Result codes and statistics shared by every RTPJitterT instantiation.
+******************************************************************************/
+class RTPJitterBase
 {
 public:
     enum RESULT
@@ -45,40 +53,160 @@ public:
         DROPPED_PACKET
     };
 
+    // a consistent copy of the buffer's counters and depths, see snapshot()
+    struct statistics {
+        uint32  overflow_count;
+        uint32  ooo_count;
+        uint32  empty_count;
+        uint32  dropped_count;      // pops that found the next packet missing
+        uint32  bad_count;          // pushes rejected as BAD_PACKET
+        uint32  jitter;             // RFC 3550 interarrival jitter, timestamp units
+        uint32  max_jitter;
+        uint32  depth;              // packets
+        uint32  depth_ms;
+        uint32  nominal_depth_ms;
+        uint32  max_depth_ms;
+        uint32  sample_rate;
+        bool    buffering;
+        uint64  residence_count;    // packets popped while residence tracking was on
+        uint32  residence_p50_us;   // time between push() and pop(), 0 if not tracked
+        uint32  residence_p99_us;
+        uint32  residence_max_us;
+        uint64  memory_bytes;       // the buffer object, its queue and the packets it holds
+        uint64  memory_high_water;
+        uint64  lifetime_overflow_count;    // the counts above, kept through reset() and init()
+        uint64  lifetime_ooo_count;
+        uint64  lifetime_empty_count;
+        uint64  lifetime_dropped_count;
+        uint64  lifetime_bad_count;
+    };
+};
+
+
+
+/******************************************************************************
+*   Observer hooks.  RTPJitterT calls these inline, under its lock, as the
+*   buffer changes state; a replacement observer derives from this and hides
+*   the hooks it cares about (and may keep state -- see
+*   RTPJitterT::observer()).  Hooks must be quick and must not block.  The
+*   default does nothing, so the calls compile away.
+*
+*   Setting TIMED_LOCK makes the buffer try the lock first and, only if that
+*   fails, time how long it waits for it and report that to on_lock_wait().
+******************************************************************************/
+struct RTPJitterNullObserver
+{
+    static const bool TIMED_LOCK = false;
+
+    void on_lock_wait(const uint64 /* ns */)                            {}  // contended acquisitions only
+    void on_buffering_start(const timepoint /* now */)                  {}
+    void on_buffering_end(const timepoint /* now */, const unsigned /* depth_ms */) {}
+    void on_overflow(const RTPPacket& /* dropped */)                    {}
+    void on_bad_packet(const RTPPacket * /* packet */)                  {}  // null if none given
+    void on_out_of_order(const RTPPacket& /* packet */, const uint16 /* sequence */) {}
+    void on_dropped(const uint16 /* sequence */)                        {}  // the missing packet
+};
+
 
-    RTPJitter(const unsigned depth, const uint32 sample_rate = 8000);
-    ~RTPJitter();
+
+/******************************************************************************
+*   The jitter buffer.  Use it as RTPJitter, or as RTPJitterUnlocked where
+*   one thread does all the pushing and popping.  The template parameters
+*   only matter when a non-default observer or policy (rtp_jitter_policy.h)
+*   is wanted, in which case include rtp_jitter_impl.h to get the member
+*   definitions:
+*
+*       struct drops : RTPJitterNullObserver { unsigned n = 0; void on_dropped(uint16) { ++n; } };
+*       RTPJitterT<drops> jitter(60);
+*       RTPJitterT<RTPJitterNullObserver, RTPSpinLock, RTPCoarseClock> pinned(60);
+******************************************************************************/
+template<class Observer      = RTPJitterNullObserver,
+         class LockPolicy    = std::recursive_mutex,
+         class ClockPolicy   = RTPSteadyClock,
+         class StoragePolicy = RTPDequeStorage>
+class RTPJitterT : public RTPJitterBase
+{
+public:
+
+    RTPJitterT(const unsigned depth, const uint32 sample_rate = 8000);
+    ~RTPJitterT();
 
     void    init(const unsigned depth, const uint32 sample_rate = 8000);
     RESULT  push(rawrtp_ptr packet);
+    RESULT  push(rawrtp_ptr packet, const timepoint arrival);
+    unsigned push_batch(rawrtp_ptr *packets, const unsigned count, const timepoint arrival, RESULT *results = nullptr);
     RESULT  pop(rawrtp_ptr& packet);
+    RESULT  pop(rawrtp_ptr& packet, const timepoint now);
     RESULT  reset();
     void    set_depth(const unsigned ms_depth, const unsigned max_depth = 0);
     int     get_depth();
     int     get_depth_ms();
     int     get_nominal_depth();
-    bool    buffering()         { return _buffering; }
+    bool    buffering()         { return _published.buffering.load(std::memory_order_relaxed); }
+    timepoint playable_at();
     void    eot_detected();
 
-    // - statistics retrieval
-    int overflow_count()        { return _stats.overflow_count; }
-    int out_of_order_count()    { return _stats.ooo_count; }
-    int empty_count()           { return _stats.empty_count; }
-    uint32 jitter()             { return (uint32)_stats.jitter; }
-    uint32 max_jitter()         { return (uint32)_stats.max_jitter; }
+    // - statistics retrieval.  None of these take the lock; each reads the
+    //  value published by the last push/pop.  Use snapshot() when several
+    //  values must agree with each other.
+    statistics snapshot() const;
+    int overflow_count()        { return (int)_published.overflow_count.load(std::memory_order_relaxed); }
+    int out_of_order_count()    { return (int)_published.ooo_count.load(std::memory_order_relaxed); }
+    int empty_count()           { return (int)_published.empty_count.load(std::memory_order_relaxed); }
+    int dropped_count()         { return (int)_published.dropped_count.load(std::memory_order_relaxed); }
+    int bad_packet_count()      { return (int)_published.bad_count.load(std::memory_order_relaxed); }
+    uint32 jitter()             { return _published.jitter.load(std::memory_order_relaxed); }
+    uint32 max_jitter()         { return _published.max_jitter.load(std::memory_order_relaxed); }
+
+    // - residence time: how long each popped packet sat in the buffer, which
+    //  is the latency the buffer adds.  Off by default; costs one histogram
+    //  record() per pop when on.  The histogram is never cleared.
+    void    track_residence(const bool enable);
+    uint64  residence_percentile_us(const double q) const;
+    const RTPLatencyHistogram *residence() const    { return _residence.load(std::memory_order_acquire); }
+
+    // - RTCP reception report for this source (RFC 3550 6.4.1), from the
+    //  sequence and jitter state push() keeps.  Each call starts a new
+    //  reporting interval for 'fraction lost'.  fill_reports() does the same
+    //  for many buffers into one contiguous array; 'senders' may be null, or
+    //  hold null entries, where no SRs are tracked.
+    bool    report(RTCPReportBlock& block, const timepoint now, const RTCPSenderTracker *sender = nullptr);
+    static unsigned fill_reports(RTPJitterT *const *buffers, const RTCPSenderTracker *const *senders,
+                                 const unsigned count, const timepoint now, RTCPReportBlock *out);
+
+    // - memory: bytes held by this buffer, counting the object itself, the
+    //  queue's storage and each queued packet (header plus payload; a view
+    //  counts its header and its share of the block it points into).
+    //  A budget caps the packets alone, the part that dropping them can
+    //  free: push() drops the oldest as overflows rather than go over it,
+    //  but never below the nominal depth, so a budget too small for that
+    //  is exceeded rather than starve playout.  The process-wide total is
+    //  in RTPMemory, whose budget also makes every push() to a buffer above
+    //  its nominal depth shed one old packet.
+    void    set_memory_budget(const uint64 bytes);      // 0 for none
+    uint64  memory_bytes()      { return _published.memory_bytes.load(std::memory_order_relaxed); }
+
+    Observer&   observer()      { return _observer; }
 
 private:
     static const int DEFAULT_BUFFER_ELEMENTS = 18;  // 360ms given 20ms packets
     static const int DEFAULT_MS_PER_PACKET   = 20;
+    static const uint16 MAX_DROPOUT          = 3000;    // sequence jumps, RFC 3550 appendix A.1
+    static const uint16 MAX_MISORDER         = 100;
 
-    // TODO: there should be no need for a recursive mutex unless there
-    //  is a possibility of a single thread calling one function from
-    //  another where it will attempt to get the lock twice, but I don't
-    //  think such a case exists.  Certainly there are probably 2 threads
-    //  accessing an instance of this class i.e. packets are pushed in
-    //  from a socket thread and popped off by an application thread.
-    std::recursive_mutex    _mutex;
-    std::deque<rawrtp_ptr>  _buffer;
+    // packets are usually pushed in from a socket thread and popped off by
+    //  an application thread, hence the lock.  No member takes it twice,
+    //  so it need not be recursive; the default still is, in case an
+    //  observer calls back into the buffer.
+    typedef typename StoragePolicy::template queue<RTPCountingAllocator<rawrtp_ptr> > packet_queue;
+    typedef std::lock_guard<LockPolicy> guard;
+
+    LockPolicy              _mutex;
+    int64                   _memory_bytes;          // counted by _buffer's allocator too, so declared first
+    uint64                  _memory_high_water;
+    uint64                  _memory_budget;
+    uint64                  _packet_bytes;          // the part of _memory_bytes that dropping packets frees
+    packet_queue            _buffer;
     unsigned                _nominal_depth_ms;      // requested buffer depth - may dynamically adjust
     int                     _max_buffer_depth;      // as measured in milliseconds
     unsigned                _payload_sample_rate;   // rate of audio in packet payloads
@@ -86,6 +214,8 @@ private:
     uint16                  _first_buf_sequence;    // at head of buffer (next to be popped)
     uint16                  _last_buf_sequence;     // at tail of buffer (most recent arrival)
     uint16                  _last_pop_sequence;
+    bool                    _played;                // something has been popped (or dropped) ...
+    uint16                  _played_sequence;       //  ... and this was the last of it
     bool                    _buffering;             // while buffering, don't pop packets
 
     timepoint               _buffering_timestamp;   // the time we start buffering
@@ -94,20 +224,118 @@ private:
         uint32      ooo_count;          // count of out of order packets
         uint32      empty_count;        // how many times was buffer empty
         uint32      overflow_count;     //
+        uint32      dropped_count;      // missing packets reported by pop()
+        uint32      bad_count;          // packets rejected by push()
         double      jitter;
         double      max_jitter;
-        uint32      prev_arrival;
         uint32      prev_transit;
+        timepoint   first_rx_timestamp;     // arrival times are measured from here
         timepoint   prev_rx_timestamp;
         int         conversion_factor_timestamp_units;
     } _stats;
 
-    void        _calc_jitter(RTPHeader *rtp);
+    // what earlier reset()s and init()s cleared from the counts above
+    struct retired {
+        uint64      overflow_count;
+        uint64      ooo_count;
+        uint64      empty_count;
+        uint64      dropped_count;
+        uint64      bad_count;
+    } _retired;
+
+    // what readers see: a copy of the above, written under _mutex at the
+    //  end of every operation and guarded by a seqlock so snapshot() never
+    //  has to take the lock.  'sequence' is odd while a write is underway.
+    struct published {
+        std::atomic<uint32> sequence;
+        std::atomic<uint32> overflow_count;
+        std::atomic<uint32> ooo_count;
+        std::atomic<uint32> empty_count;
+        std::atomic<uint32> dropped_count;
+        std::atomic<uint32> bad_count;
+        std::atomic<uint32> jitter;
+        std::atomic<uint32> max_jitter;
+        std::atomic<uint32> depth;
+        std::atomic<uint32> depth_ms;
+        std::atomic<uint32> nominal_depth_ms;
+        std::atomic<uint32> max_depth_ms;
+        std::atomic<uint32> sample_rate;
+        std::atomic<bool>   buffering;
+        std::atomic<uint64> memory_bytes;
+        std::atomic<uint64> memory_high_water;
+        std::atomic<uint64> retired_overflow_count;
+        std::atomic<uint64> retired_ooo_count;
+        std::atomic<uint64> retired_empty_count;
+        std::atomic<uint64> retired_dropped_count;
+        std::atomic<uint64> retired_bad_count;
+    } _published;
+
+    // per-source reception state, RFC 3550 appendix A.1
+    struct source {
+        bool        started;
+        uint32      ssrc;
+        uint16      max_seq;            // highest sequence number seen
+        uint32      cycles;             // shifted count of sequence number cycles
+        uint32      base_seq;
+        uint32      bad_seq;            // last 'bad' sequence number + 1
+        uint32      received;
+        uint32      expected_prior;     // as of the last report
+        uint32      received_prior;
+    } _source;
+
+    // the last packet push() saw, for working out durations the caller
+    //  didn't give us from the RTP timestamps
+    struct timing {
+        bool        valid;
+        uint16      sequence;
+        uint32      timestamp;
+        uint16      ms;                 // last duration worked out
+    } _timing;
+
+    Observer                _observer;
+    bool                    _track_residence;
+    std::atomic<RTPLatencyHistogram *> _residence;  // created on first track_residence(true)
+
+    void        _init(const unsigned depth, const uint32 sample_rate);
+    void        _retire_stats();
+    void        _set_depth(const unsigned ms_depth, const unsigned max_depth);
+    RESULT      _push(rawrtp_ptr& p, const timepoint arrival, const RTPHeaderBatch& headers, const unsigned n);
+    RESULT      _pop(rawrtp_ptr& packet, const timepoint now);
+    void        _publish();
+    static int16 _seq_diff(const uint16 a, const uint16 b) { return (int16)(uint16)(a - b); }
+    void        _calc_jitter(const uint32 rtp_timestamp, const timepoint arrival);
+    void        _set_duration(RTPPacket& packet, const uint8 payload_type, const uint32 timestamp, const uint16 sequence);
+    void        _update_source(const uint32 ssrc, const uint16 sequence);
+
+    // locks _mutex, timing the wait if the observer wants that; use as
+    //  guard lock(_lock(), std::adopt_lock)
+    LockPolicy& _lock()
+    {
+        if (Observer::TIMED_LOCK && !_mutex.try_lock()) {
+            timepoint start = stdclock::now();
+            _mutex.lock();
+            _observer.on_lock_wait(clocks::duration_cast<clocks::nanoseconds>(stdclock::now() - start).count());
+        } else if (!Observer::TIMED_LOCK) {
+            _mutex.lock();
+        }
+        return _mutex;
+    }
     void        _clean_buffer();
+    void        _account(const rawrtp_ptr& p, const int sign);
+    static uint64 _cost(const RTPPacket& p) { return sizeof(RTPPacket) + (p.backing ? p.backing_share : p.nLen); }
+    void        _drop_front();
     uint8       _get_payload_type(RTPHeader *packet);
     uint8      *_get_payload(RTPHeader *packet);
     void        _log(std::string s);
     void        _reset_buffer_stats(const uint32 sample_rate);
 };
 
+typedef RTPJitterT<>    RTPJitter;
+typedef RTPJitterT<RTPJitterNullObserver, RTPNoLock>    RTPJitterUnlocked;
+
+// the default buffer and the single-threaded one are compiled once, in
+//  rtp_jitter.cpp
+extern template class RTPJitterT<RTPJitterNullObserver>;
+extern template class RTPJitterT<RTPJitterNullObserver, RTPNoLock>;
+
 #endif  // RTP_JITTER_H_cc8e302e_b008_4588_a29a_79a9f555804d
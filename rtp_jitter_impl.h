@@ -0,0 +1,1171 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_JITTER_IMPL_H_2b6e9f13_7d4a_4c58_a0e1_93f5c8d2b760
+#define RTP_JITTER_IMPL_H_2b6e9f13_7d4a_4c58_a0e1_93f5c8d2b760
+
+// member definitions of RTPJitterT.  Include this only where an observer
+//  other than the default is instantiated; everyone else gets RTPJitter
+//  from rtp_jitter.o.
+
+#include "rtp_jitter.h"
+#include "rtp_codec.h"
+#include "rtp_log.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <arpa/inet.h>
+
+
+
+/******************************************************************************
+*   Just call _init to get initialization "things" done.
+*
+*   Returns n/a
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::RTPJitterT(const unsigned depth, const uint32 sample_rate /* = 8000 */)
+    : _memory_bytes(0), _memory_high_water(0), _memory_budget(0), _packet_bytes(0),
+      _buffer(typename packet_queue::allocator_type(&_memory_bytes)), _retired()
+{
+    _memory_bytes += sizeof(*this);
+    RTPMemory::add(RTPMemory::JITTER_BUFFERS, sizeof(*this));
+    _published.sequence.store(0, std::memory_order_relaxed);
+    _track_residence = false;
+    _residence.store(nullptr, std::memory_order_relaxed);
+    _init(depth, sample_rate);
+}
+
+
+
+/******************************************************************************
+*   Need to clean out the memory we own in the buffer (unless we're expecting
+*   the caller to be responsible for that).
+*
+*   Returns n/a
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::~RTPJitterT()
+{
+    guard lock(_lock(), std::adopt_lock);
+
+    _clean_buffer();
+    if (_residence.load(std::memory_order_relaxed) != nullptr) {
+        delete _residence.load(std::memory_order_relaxed);
+        RTPMemory::add(RTPMemory::JITTER_BUFFERS, -(int64)sizeof(RTPLatencyHistogram));
+    }
+    RTPMemory::add(RTPMemory::JITTER_BUFFERS, -(int64)sizeof(*this));
+    // _buffer's own storage is released through its allocator afterwards
+}
+
+
+
+/******************************************************************************
+*   Ensure a new empty buffer and associated parameters.  Reset buffer stats.
+*
+*   Returns none
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::init(const unsigned depth, const uint32 sample_rate /* = 8000 */)
+{
+    guard lock(_lock(), std::adopt_lock);
+
+    _retire_stats();
+    _init(depth, sample_rate);
+}
+
+
+
+/******************************************************************************
+*   Does the work of init().  Caller must hold the lock (or be the
+*   constructor).
+*
+*   Returns none
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_init(const unsigned depth, const uint32 sample_rate)
+{
+    if (!_buffer.empty()) {
+        _clean_buffer();
+    }
+
+    _depth_ms = 0;
+    _first_buf_sequence = 0;
+    _last_buf_sequence = 0;
+    _last_pop_sequence = 0;
+    _played = false;
+    _played_sequence = 0;
+    _payload_sample_rate = sample_rate;
+
+    _buffering = true;
+    _buffering_timestamp = timepoint::min();
+    memset(&_timing, 0, sizeof(_timing));
+    _reset_buffer_stats(sample_rate);
+    _set_depth(depth, 0);
+    _publish();
+}
+
+
+
+/******************************************************************************
+*   Adds the given packet, stamping its arrival with the current time.  Prefer
+*   the overload below when the receiver has a kernel receive timestamp.
+*
+*   Returns rtp jitter result code
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+RTPJitterBase::RESULT RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::push(rawrtp_ptr p)
+{
+    return push(std::move(p), ClockPolicy::now());
+}
+
+
+
+/******************************************************************************
+*   Adds the given packet to the buffer.  'arrival' is when the packet reached
+*   the host (e.g. from SO_TIMESTAMPNS, converted to stdclock); it drives both
+*   the jitter statistics and the buffering timer so that queueing delay in
+*   the application does not count as network jitter.
+*
+*   The packet is moved, not copied, into the buffer: a caller that hands it
+*   over with std::move() causes no reference count traffic at all.
+*
+*   Returns rtp jitter result code
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+RTPJitterBase::RESULT RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::push(rawrtp_ptr p, const timepoint arrival)
+{
+    RTPHeaderBatch header;
+    header.parse(&p, 1, RTPHeaderBatch::KERNEL_SCALAR);
+
+    guard lock(_lock(), std::adopt_lock);
+    RESULT rc = _push(p, arrival, header, 0);
+    _publish();
+    return rc;
+}
+
+
+
+/******************************************************************************
+*   Adds a batch of packets that arrived together -- e.g. the segments of one
+*   GRO-coalesced datagram.  The headers are parsed RTPHeaderBatch::MAX at a
+*   time with the vector kernels, before the lock is taken, and the lock is
+*   then taken once for each such group.  If 'results' is given, it receives
+*   the result code for each packet.  Packets that are accepted are moved out
+*   of 'packets', leaving those entries empty.
+*
+*   Returns the number of packets that were not rejected as BAD_PACKET
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+unsigned RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::push_batch(rawrtp_ptr *packets, const unsigned count, const timepoint arrival, RESULT *results /* = nullptr */)
+{
+    unsigned        accepted = 0;
+    RTPHeaderBatch  headers;
+
+    for (unsigned base = 0; base < count; base += RTPHeaderBatch::MAX) {
+        unsigned n = headers.parse(packets + base, count - base);
+
+        guard lock(_lock(), std::adopt_lock);
+        for (unsigned i = 0; i < n; ++i) {
+            RESULT rc = _push(packets[base + i], arrival, headers, i);
+            if (rc != BAD_PACKET) {
+                ++accepted;
+            }
+            if (results != nullptr) {
+                results[base + i] = rc;
+            }
+        }
+        _publish();
+    }
+    return accepted;
+}
+
+
+
+/******************************************************************************
+*   Adds the given packet to the end of the buffer, or inserts it earlier in
+*   the buffer if it is out of order.  'headers' holds the packet's parsed
+*   header at index 'n'; a packet whose header is not valid RTP is rejected.
+*   Caller must hold the lock.
+*
+*   Returns rtp jitter result code
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+RTPJitterBase::RESULT RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_push(rawrtp_ptr& p, const timepoint arrival, const RTPHeaderBatch& headers, const unsigned n)
+{
+    uint16      rtp_sequence = 0;
+    RESULT      rc = SUCCESS;
+
+    if ((p != nullptr) && headers.valid[n]) {
+        rtp_sequence = headers.sequence[n];
+        p->enqueued = arrival;
+        _set_duration(*p, headers.payload_type[n], headers.timestamp[n], rtp_sequence);
+
+        if ((_depth_ms > _max_buffer_depth) && !_buffer.empty()) {
+            RTPLOG(JITTER_OVERFLOW, _depth_ms, rtp_sequence);
+            rc = BUFFER_OVERFLOW;
+            _stats.overflow_count++;
+
+            // we are overflowing ... drop the front packet
+            _drop_front();
+        } else if (StoragePolicy::CAPACITY && (_buffer.size() >= StoragePolicy::CAPACITY)) {
+            // ... likewise when a fixed size buffer is out of room
+            RTPLOG(JITTER_OVERFLOW, _depth_ms, rtp_sequence);
+            rc = BUFFER_OVERFLOW;
+            _stats.overflow_count++;
+            _drop_front();
+        }
+
+        // the same goes for memory: shed old packets until this one fits
+        //  the buffer's budget, and one per push while the process as a
+        //  whole is over its budget -- but either way only from a buffer
+        //  holding more than its nominal depth, so playout is never starved
+        if (RTPMemory::over_budget() && !_buffer.empty() && (_depth_ms > _nominal_depth_ms)) {
+            RTPLOG(JITTER_OVERFLOW, _depth_ms, rtp_sequence);
+            rc = BUFFER_OVERFLOW;
+            _stats.overflow_count++;
+            _drop_front();
+        }
+        if (_memory_budget != 0) {
+            uint64 cost = _cost(*p);
+            while (!_buffer.empty() && (_depth_ms > _nominal_depth_ms) && (_packet_bytes + cost > _memory_budget)) {
+                RTPLOG(JITTER_OVERFLOW, _depth_ms, rtp_sequence);
+                rc = BUFFER_OVERFLOW;
+                _stats.overflow_count++;
+                _drop_front();
+            }
+        }
+
+        // if this is our first packet since init, start the buffering clock ...
+        if (_buffering && (_buffering_timestamp == timepoint::min())) {
+            _buffering_timestamp = arrival;
+        }
+
+        // for every packet, update jitter stats
+        _calc_jitter(headers.timestamp[n], arrival);
+        _update_source(headers.ssrc[n], rtp_sequence);
+
+        // sequence numbers are only 16 bits and wrap around fairly often,
+        //  so they are compared using serial number arithmetic (RFC 1982):
+        //  'a' follows 'b' if (a - b) mod 2^16 is less than half the space.
+        //  This keeps us in step across a wrap even when the packets
+        //  either side of it go missing.
+        //
+        // 'played' is a packet at or just behind the last one popped: a
+        //  late duplicate, or one already given up as dropped.  Playing it
+        //  now would put it out twice, or out of order, even when the
+        //  buffer has run dry and anything else would restart it.  Further
+        //  back than MAX_MISORDER, the source is taken to have restarted.
+        int16 behind = _seq_diff(rtp_sequence, _played_sequence);
+        bool played = _played && (behind <= 0) && (behind > -(int16)MAX_MISORDER);
+
+        if (_buffer.empty() ? !played : (_seq_diff(rtp_sequence, _last_buf_sequence) >= 0)) {
+            // if this packet has a sequence number greater than
+            //  any other I've seen so far, then we can be certain
+            //  that this one belongs at the end.  As a caveat, I
+            //  suppose packets could arrive with the same sequnce
+            //  number.  If so, this goes right after the one we
+            //  already have -- in this case, it still goes on the
+            //  back end ... and we don't consider it to be out of
+            //  order.
+            _last_buf_sequence = rtp_sequence;
+            _depth_ms += p->payload_ms;
+            _account(p, 1);
+            _buffer.push_back(std::move(p));
+
+            // if this is the only packet we have, it obviously
+            //  serves as both the first and last element.  Also,
+            //  we will set the _last_pop_sequence as well so when
+            //  we're popping, we don't think there was a dropped
+            //  packet i.e. _first_buf == _last_pop means all good.
+            if (_buffer.size() == 1) {
+                _first_buf_sequence = _last_pop_sequence = rtp_sequence;
+            }
+        } else {
+            RTPLOG(JITTER_OUT_OF_ORDER, rtp_sequence);
+            _observer.on_out_of_order(*p, rtp_sequence);
+            ++_stats.ooo_count;
+            // This is an out-of-order packet.  One of these scenarios:
+            //
+            // 1. we've already popped past it (or declared it dropped)
+            //      - packet is too old to use, ignore it; with the buffer
+            //        empty this is the only case that gets here
+            // 2. preceeds the front packet, but is still in the future
+            //      - packet is just in time, stick on front
+            // 3. belongs in the middle of the buffer
+            //      - find the home and insert
+            //
+            // _last_pop == _first_buf means nothing has been popped since
+            //  this run of packets started, so there is no "too old" yet;
+            //  keep it that way if we add a new front packet.
+            bool fresh = (_last_pop_sequence == _first_buf_sequence);
+
+            if (played || (!fresh && (_seq_diff(rtp_sequence, _last_pop_sequence) <= 0))) {
+                rc = BAD_PACKET;
+                ++_stats.bad_count;
+                _observer.on_bad_packet(p.get());
+            } else if (_seq_diff(rtp_sequence, _first_buf_sequence) < 0) {
+                _first_buf_sequence = rtp_sequence;
+                if (fresh) {
+                    _last_pop_sequence = rtp_sequence;
+                }
+                _depth_ms += p->payload_ms;
+                _account(p, 1);
+                _buffer.push_front(std::move(p));
+            } else {
+                // this packet has a sequence number that is strictly
+                //  less than the last packet in our buffer, and greater
+                //  than or equal to the first packet.  Either way, this
+                //  one can go is anywhere from index 1 to n-2
+                for (typename packet_queue::iterator i = _buffer.begin(); i != _buffer.end(); ++i) {
+                    RTPHeader *item = reinterpret_cast<PRTPHeader>((*i)->pData);
+                    if (_seq_diff(rtp_sequence, ntohs(item->sequence)) < 0) {
+                        _depth_ms += p->payload_ms;
+                        _account(p, 1);
+                        _buffer.insert(i, std::move(p));
+                        break;
+                    }
+                }
+            }
+        }
+    } else {
+        // no packet, or not one we can make sense of
+        rc = BAD_PACKET;
+        ++_stats.bad_count;
+        _observer.on_bad_packet(p.get());
+    }
+    return rc;
+}
+
+
+
+/******************************************************************************
+*   Retrieves the next packet as of the current time.  The packet is moved
+*   out of the buffer into 'packet', so the refcount does not change on the
+*   way out.
+*
+*   Returns rtp jitter result code
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+RTPJitterBase::RESULT RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::pop(rawrtp_ptr& packet)
+{
+    return pop(packet, ClockPolicy::now());
+}
+
+
+
+/******************************************************************************
+*   Retrieves the RTP packet from the front of the buffer, or nothing if the
+*   expected packet is missing.  'now' is the playout time used against the
+*   buffering timer; together with push(packet, arrival) it lets the buffer
+*   run on a virtual clock (simulation, replay) or a scheduler's deadline.
+*
+*   Returns rtp jitter result code
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+RTPJitterBase::RESULT RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::pop(rawrtp_ptr& packet, const timepoint now)
+{
+    guard lock(_lock(), std::adopt_lock);
+    RESULT rc = _pop(packet, now);
+    _publish();
+    return rc;
+}
+
+
+
+/******************************************************************************
+*   Does the work of pop().  Caller must hold the lock.
+*
+*   NOTE: be very careful in this routine -- I broke the "one entry, one exit"
+*   rule.
+*
+*   Returns rtp jitter result code
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+RTPJitterBase::RESULT RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_pop(rawrtp_ptr& packet, const timepoint now)
+{
+    // first things first -- do we need to enter or exit the buffering state?
+    if (_buffer.empty()) {
+        // the buffer is empty ... do we need to go back to buffering?  If the
+        //  _buffering flag is not yet set, then yes.
+        if (!_buffering) {
+            _buffering = true;
+            _observer.on_buffering_start(now);
+        }
+        _stats.empty_count++;
+    } else {
+        if (_buffering) {
+            // check the time... come out of buffering once the buffering
+            //  timer reaches the nominal jitter depth, or if we get a burst
+            //  of packets that deepens the buffer to the nominal depth.
+            //
+            // It's possible that packets came bursting in i.e. we've reached
+            //  our depth before the buffering delay expires.  In this case,
+            //  we also come out of the buffering state.
+            int buffer_time = clocks::duration_cast<clocks::milliseconds>(now - _buffering_timestamp).count();
+            if ((buffer_time >= _nominal_depth_ms)
+             || (_depth_ms >= _nominal_depth_ms))
+            {
+                _buffering = false;
+                _buffering_timestamp = timepoint::min();
+                _observer.on_buffering_end(now, _depth_ms);
+            }
+        }
+    }
+
+    if (_buffering) {
+        return BUFFERING;
+    }
+
+    // take a look at the packet at the front of the buffer; only a packet
+    //  that stays there is copied out, the rest are moved
+    const RTPPacket& front = *_buffer.front();
+
+    // let's see if we should take what's on the front of the buffer, or
+    //  if we need to return nothing and indicate a dropped packet.
+    //  There's a lot of logic here, so tread lightly.
+    //
+    //  good sequences:
+    //      _last_pop and _first_buf are equal
+    //      _last_pop is one less than _first_buf
+    //      _last_pop is UINT16_MAX and _first_buf is 0
+    //      dynamic payloads and _last_pop is 2 less than _first_buf
+    if ((_last_pop_sequence == _first_buf_sequence)
+     || (_last_pop_sequence == (_first_buf_sequence - 1))
+     || ((_last_pop_sequence == UINT16_MAX) && (_first_buf_sequence == 0))
+     || ((front.payload_type == RTP_PAYLOAD_DYNAMIC) && (_last_pop_sequence == (_first_buf_sequence - 2))))
+    {
+        if ((front.payload_type == RTP_PAYLOAD_DYNAMIC) && (_last_pop_sequence == (_first_buf_sequence - 2))) {
+            // "special" case where we hang onto the front packet in the buffer
+            //  but mark it becasue we expect to be able to reuse it.
+            packet = _buffer.front();
+            packet->use_redundant_payload = true;
+        } else {
+            // "normal" case where we can remove the front packet
+            packet = std::move(_buffer.front());
+            packet->use_redundant_payload = false;
+            _buffer.pop_front();
+            _depth_ms -= packet->payload_ms;
+            _account(packet, -1);
+
+            if (_track_residence && (packet->enqueued != timepoint::min())) {
+                int64 us = clocks::duration_cast<clocks::microseconds>(now - packet->enqueued).count();
+                _residence.load(std::memory_order_relaxed)->record((us > 0) ? (uint64)us : 0);
+            }
+        }
+
+        RTPHeader *p = reinterpret_cast<PRTPHeader>(packet->pData);
+        _last_pop_sequence = ntohs(p->sequence);
+        _played = true;
+        _played_sequence = _last_pop_sequence;
+
+        // did we just empty the buffer?  If so, reset the sequence counters
+        if (_buffer.empty()) {
+            _first_buf_sequence = _last_pop_sequence;
+        } else {
+            // now peek at the next packet to get it's sequence #
+            p = reinterpret_cast<PRTPHeader>(_buffer.front()->pData);
+            _first_buf_sequence = ntohs(p->sequence);
+        }
+        return SUCCESS;
+
+    } else {
+        ++_last_pop_sequence;
+        _played = true;
+        _played_sequence = _last_pop_sequence;
+        ++_stats.dropped_count;
+        _observer.on_dropped(_last_pop_sequence);
+        return DROPPED_PACKET;
+    }
+}
+
+
+
+/******************************************************************************
+*   Empties the current buffer and reinitializes.  May block while waiting for
+*   any other thread accessing the buffer.
+*
+*   Returns rtp jitter result code
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+RTPJitterBase::RESULT RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::reset()
+{
+    guard lock(_lock(), std::adopt_lock);
+    _clean_buffer();
+    _retire_stats();
+    _init(_nominal_depth_ms, _payload_sample_rate);
+
+    return SUCCESS;
+}
+
+
+
+/******************************************************************************
+*   Carries the counts _init() is about to clear over into _retired, so the
+*   lifetime counts in snapshot() never go backwards.  Caller holds the lock.
+*
+*   Returns none
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_retire_stats()
+{
+    _retired.overflow_count += _stats.overflow_count;
+    _retired.ooo_count      += _stats.ooo_count;
+    _retired.empty_count    += _stats.empty_count;
+    _retired.dropped_count  += _stats.dropped_count;
+    _retired.bad_count      += _stats.bad_count;
+}
+
+
+
+/******************************************************************************
+*   Sets the nominal and maximum depths, in milliseconds, of the buffer.  If
+*   max_depth is not given, or less than ms_depth, it will be calculated to
+*   2 times ms_depth.
+*
+*   Returns nothing
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::set_depth(const unsigned ms_depth, const unsigned max_depth /* = 0 */)
+{
+    guard lock(_lock(), std::adopt_lock);
+
+    _set_depth(ms_depth, max_depth);
+    _publish();
+}
+
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_set_depth(const unsigned ms_depth, const unsigned max_depth)
+{
+    _nominal_depth_ms = ms_depth;
+    if (max_depth >= ms_depth) {
+        _max_buffer_depth = max_depth;
+    } else {
+        _max_buffer_depth = (_nominal_depth_ms * 2);
+    }
+}
+
+
+
+/******************************************************************************
+*   Rertieves the current number of packets in the buffer.
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+int RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::get_depth()
+{
+    return (int)_published.depth.load(std::memory_order_relaxed);
+}
+
+
+
+/******************************************************************************
+*   Retrieves the current 'depth' of the buffer in miliseconds.
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+int RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::get_depth_ms()
+{
+    return (int)_published.depth_ms.load(std::memory_order_relaxed);
+}
+
+
+
+/******************************************************************************
+*   Retrieves the current "requested/nominal" depth of the buffer in miliseconds.
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+int RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::get_nominal_depth()
+{
+    return (int)_published.nominal_depth_ms.load(std::memory_order_relaxed);
+}
+
+
+
+/******************************************************************************
+*   When pop() will next come out of the buffering state, given what is in the
+*   buffer now: the buffering timer's expiry, or when it started if the
+*   buffer already holds the nominal depth.  Lets a timer be set instead of
+*   polling pop().
+*
+*   Returns timepoint::min() if the buffer is playing now, timepoint::max()
+*   if it is buffering with nothing to start the timer yet
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+timepoint RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::playable_at()
+{
+    guard lock(_lock(), std::adopt_lock);
+
+    if (!_buffering) {
+        return timepoint::min();
+    }
+    if (_buffer.empty() || (_buffering_timestamp == timepoint::min())) {
+        return timepoint::max();
+    }
+    if (_depth_ms >= _nominal_depth_ms) {
+        return _buffering_timestamp;
+    }
+    return _buffering_timestamp + clocks::milliseconds(_nominal_depth_ms);
+}
+
+
+
+/******************************************************************************
+*   Copies the statistics published by the most recent push/pop/reset without
+*   taking the lock, so a monitoring thread can poll any number of buffers
+*   without stalling the media threads.  Retries if a writer was publishing
+*   at the same time, so all of the values come from the same instant.
+*
+*   Returns the statistics
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+RTPJitterBase::statistics RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::snapshot() const
+{
+    statistics  s;
+    uint32      before, after;
+
+    do {
+        before = _published.sequence.load(std::memory_order_acquire);
+        s.overflow_count   = _published.overflow_count.load(std::memory_order_relaxed);
+        s.ooo_count        = _published.ooo_count.load(std::memory_order_relaxed);
+        s.empty_count      = _published.empty_count.load(std::memory_order_relaxed);
+        s.dropped_count    = _published.dropped_count.load(std::memory_order_relaxed);
+        s.bad_count        = _published.bad_count.load(std::memory_order_relaxed);
+        s.jitter           = _published.jitter.load(std::memory_order_relaxed);
+        s.max_jitter       = _published.max_jitter.load(std::memory_order_relaxed);
+        s.depth            = _published.depth.load(std::memory_order_relaxed);
+        s.depth_ms         = _published.depth_ms.load(std::memory_order_relaxed);
+        s.nominal_depth_ms = _published.nominal_depth_ms.load(std::memory_order_relaxed);
+        s.max_depth_ms     = _published.max_depth_ms.load(std::memory_order_relaxed);
+        s.sample_rate      = _published.sample_rate.load(std::memory_order_relaxed);
+        s.buffering        = _published.buffering.load(std::memory_order_relaxed);
+        s.memory_bytes     = _published.memory_bytes.load(std::memory_order_relaxed);
+        s.memory_high_water = _published.memory_high_water.load(std::memory_order_relaxed);
+        s.lifetime_overflow_count = _published.retired_overflow_count.load(std::memory_order_relaxed) + s.overflow_count;
+        s.lifetime_ooo_count      = _published.retired_ooo_count.load(std::memory_order_relaxed) + s.ooo_count;
+        s.lifetime_empty_count    = _published.retired_empty_count.load(std::memory_order_relaxed) + s.empty_count;
+        s.lifetime_dropped_count  = _published.retired_dropped_count.load(std::memory_order_relaxed) + s.dropped_count;
+        s.lifetime_bad_count      = _published.retired_bad_count.load(std::memory_order_relaxed) + s.bad_count;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = _published.sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || (before != after));
+
+    // the histogram is not part of the seqlock; its counts are each atomic
+    //  and a pop landing mid-read only shifts a percentile by one sample.
+    const RTPLatencyHistogram *h = _residence.load(std::memory_order_acquire);
+    if (h != nullptr) {
+        s.residence_count  = h->count();
+        s.residence_p50_us = (uint32)h->percentile(0.50);
+        s.residence_p99_us = (uint32)h->percentile(0.99);
+        s.residence_max_us = (uint32)h->max();
+    } else {
+        s.residence_count  = 0;
+        s.residence_p50_us = s.residence_p99_us = s.residence_max_us = 0;
+    }
+    return s;
+}
+
+
+
+/******************************************************************************
+*   Turns residence time tracking on or off.  The histogram is created the
+*   first time tracking is turned on and kept (with its counts) from then on,
+*   so readers never see it disappear.  Like the lifetime counts it survives
+*   reset(), so exporters can treat its buckets as counters.
+*
+*   Returns nothing
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::track_residence(const bool enable)
+{
+    guard lock(_lock(), std::adopt_lock);
+
+    if (enable && (_residence.load(std::memory_order_relaxed) == nullptr)) {
+        _residence.store(new RTPLatencyHistogram(), std::memory_order_release);
+        _memory_bytes += sizeof(RTPLatencyHistogram);
+        RTPMemory::add(RTPMemory::JITTER_BUFFERS, sizeof(RTPLatencyHistogram));
+    }
+    _track_residence = enable;
+}
+
+
+
+/******************************************************************************
+*   Caps the bytes of packets this buffer may hold; push() drops the oldest
+*   packets, as overflows, to stay under it while the buffer is deeper than
+*   its nominal depth.  The object, its queue storage and its histogram are
+*   not counted: dropping packets cannot free them.  0 removes the cap.
+*
+*   Returns nothing
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::set_memory_budget(const uint64 bytes)
+{
+    guard lock(_lock(), std::adopt_lock);
+
+    _memory_budget = bytes;
+}
+
+
+
+/******************************************************************************
+*   Residence time, in microseconds, at quantile 'q' (0.0 - 1.0) of the
+*   packets popped so far.  Lock-free, like snapshot().
+*
+*   Returns the residence time, 0 if tracking has never been turned on
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+uint64 RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::residence_percentile_us(const double q) const
+{
+    const RTPLatencyHistogram *h = _residence.load(std::memory_order_acquire);
+    return (h != nullptr) ? h->percentile(q) : 0;
+}
+
+
+
+/******************************************************************************
+*   Some external agent is saying an end of transmission has been detected and
+*   we might want to reset our sequence numbers since there's no guarantee
+*   future numbers won't overlap current ones in an odd way.  Just sayin'
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::eot_detected()
+{
+    _first_buf_sequence = 0;
+    _last_buf_sequence = 0;
+    _last_pop_sequence = 0;
+    _played = false;
+}
+
+
+
+/******************************************************************************
+*   Calculates/updates jitter stats based on the given packet.  We adhere to
+*   the formula estimating interarrival jitter as proscribed in RFC3550 section
+*   6.4.1 and on the sample code in appendix A.8.
+*
+*   Arrival times are converted to timestamp units relative to the first
+*   packet since the stats were reset; only differences matter, so the choice
+*   of origin is arbitrary as long as it is consistent.
+*
+*   Returns none -- there's no return value, but internal stats are updated.
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_calc_jitter(const uint32 rtp_timestamp, const timepoint arrival)
+{
+    if (_stats.prev_rx_timestamp == timepoint::min()) {
+        // first packet -- nothing to compare against yet
+        _stats.first_rx_timestamp = arrival;
+        _stats.prev_rx_timestamp = arrival;
+        _stats.prev_transit = 0u - rtp_timestamp;
+        return;
+    }
+
+    // get the 'arrival time' of this packet as measured in 'timestamp units'
+    int64   elapsed_us = clocks::duration_cast<clocks::microseconds>(arrival - _stats.first_rx_timestamp).count();
+    uint32  arrival_units = (uint32)((elapsed_us * _stats.conversion_factor_timestamp_units) / 1000);
+
+    uint32  transit = arrival_units - rtp_timestamp;
+    int32   d = (int32)(transit - _stats.prev_transit);
+    _stats.prev_transit = transit;
+    if (d < 0) d = -d;
+
+    _stats.jitter += (1.0/16.0) * ((double)d - _stats.jitter);
+
+    _stats.prev_rx_timestamp = arrival;
+    // is this a new high water mark for jitter?
+    if (_stats.max_jitter < _stats.jitter) _stats.max_jitter = _stats.jitter;
+}
+
+
+
+/******************************************************************************
+*   Fills in payload_bytes and payload_ms where the caller left them 0.  The
+*   size comes from the packet's headers; the duration from the payload type
+*   (rtp_codec.h) when its frames are a fixed size, otherwise from the
+*   timestamp step since the previous packet, otherwise as the last packet
+*   or the codec's default packet time.  Without a duration the buffer's
+*   depth would never grow and only the buffering timer would release it.
+*
+*   Returns none
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_set_duration(RTPPacket& packet, const uint8 payload_type, const uint32 timestamp, const uint16 sequence)
+{
+    const RTPCodec  codec = rtp_codec(payload_type);
+    uint32          clock = codec.clock_rate ? codec.clock_rate : _payload_sample_rate;
+
+    if (packet.payload_bytes == 0) {
+        packet.payload_bytes = (uint16)rtp_payload_length(packet.pData, packet.nLen);
+    }
+    if (packet.payload_ms == 0) {
+        unsigned ms = rtp_payload_ms(codec, packet.payload_bytes);
+
+        if ((ms == 0) && _timing.valid && (sequence == (uint16)(_timing.sequence + 1)) && (clock != 0)) {
+            uint32 step = timestamp - _timing.timestamp;
+            if (step < clock) {
+                ms = (unsigned)(((uint64)step * 1000) / clock);
+            }
+        }
+        if (ms == 0) {
+            ms = _timing.ms ? _timing.ms : codec.ptime_ms;
+        }
+        packet.payload_ms = (uint16)ms;
+        _timing.ms = (uint16)ms;
+    }
+    _timing.valid = true;
+    _timing.sequence = sequence;
+    _timing.timestamp = timestamp;
+}
+
+
+
+/******************************************************************************
+*   Publishes the current state for snapshot() and the getters.  Only one
+*   thread may publish at a time, so the caller must hold the lock (or be the
+*   constructor).
+*
+*   Returns none
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_publish()
+{
+    uint32 sequence = _published.sequence.load(std::memory_order_relaxed);
+
+    _published.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    _published.overflow_count.store(_stats.overflow_count, std::memory_order_relaxed);
+    _published.ooo_count.store(_stats.ooo_count, std::memory_order_relaxed);
+    _published.empty_count.store(_stats.empty_count, std::memory_order_relaxed);
+    _published.dropped_count.store(_stats.dropped_count, std::memory_order_relaxed);
+    _published.bad_count.store(_stats.bad_count, std::memory_order_relaxed);
+    _published.jitter.store((uint32)_stats.jitter, std::memory_order_relaxed);
+    _published.max_jitter.store((uint32)_stats.max_jitter, std::memory_order_relaxed);
+    _published.depth.store((uint32)_buffer.size(), std::memory_order_relaxed);
+    _published.depth_ms.store(_depth_ms, std::memory_order_relaxed);
+    _published.nominal_depth_ms.store(_nominal_depth_ms, std::memory_order_relaxed);
+    _published.max_depth_ms.store((uint32)_max_buffer_depth, std::memory_order_relaxed);
+    _published.sample_rate.store(_payload_sample_rate, std::memory_order_relaxed);
+    _published.buffering.store(_buffering, std::memory_order_relaxed);
+    if ((uint64)_memory_bytes > _memory_high_water) {
+        _memory_high_water = (uint64)_memory_bytes;
+    }
+    _published.memory_bytes.store((uint64)_memory_bytes, std::memory_order_relaxed);
+    _published.memory_high_water.store(_memory_high_water, std::memory_order_relaxed);
+    _published.retired_overflow_count.store(_retired.overflow_count, std::memory_order_relaxed);
+    _published.retired_ooo_count.store(_retired.ooo_count, std::memory_order_relaxed);
+    _published.retired_empty_count.store(_retired.empty_count, std::memory_order_relaxed);
+    _published.retired_dropped_count.store(_retired.dropped_count, std::memory_order_relaxed);
+    _published.retired_bad_count.store(_retired.bad_count, std::memory_order_relaxed);
+
+    _published.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+
+
+/******************************************************************************
+*   Tracks the extended highest sequence number and the received count the
+*   way RFC 3550 appendix A.1 does, so that loss can be reported in RTCP.
+*   A jump of more than MAX_DROPOUT is only believed when the packet after it
+*   confirms it (the source restarted); until then it is not counted.  There
+*   is no probation period: the buffer already knows the stream is wanted.
+*
+*   Returns none
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_update_source(const uint32 ssrc, const uint16 sequence)
+{
+    static const uint32 RTP_SEQ_MOD  = (1 << 16);
+
+    _source.ssrc = ssrc;
+
+    if (!_source.started) {
+        _source.started = true;
+        _source.max_seq = sequence;
+        _source.base_seq = sequence;
+        _source.bad_seq = RTP_SEQ_MOD + 1;
+        _source.cycles = 0;
+        _source.received = 1;
+        _source.expected_prior = 0;
+        _source.received_prior = 0;
+        return;
+    }
+
+    uint16 udelta = sequence - _source.max_seq;
+
+    if (udelta < MAX_DROPOUT) {
+        // in order, with permissible gap
+        if (sequence < _source.max_seq) {
+            _source.cycles += RTP_SEQ_MOD;
+        }
+        _source.max_seq = sequence;
+    } else if (udelta <= RTP_SEQ_MOD - MAX_MISORDER) {
+        // the sequence number made a very large jump
+        if (sequence == _source.bad_seq) {
+            // two sequential packets -- assume the other side restarted
+            //  without telling us, so just re-sync
+            _source.max_seq = sequence;
+            _source.base_seq = sequence;
+            _source.bad_seq = RTP_SEQ_MOD + 1;
+            _source.cycles = 0;
+            _source.received = 0;
+            _source.expected_prior = 0;
+            _source.received_prior = 0;
+        } else {
+            _source.bad_seq = (sequence + 1) & (RTP_SEQ_MOD - 1);
+            return;
+        }
+    } else {
+        // duplicate or reordered packet
+    }
+    ++_source.received;
+}
+
+
+
+/******************************************************************************
+*   Fills an RTCP report block for this buffer's source as of 'now', per RFC
+*   3550 section 6.4.1 and appendix A.3.  LSR/DLSR come from 'sender' if
+*   given, otherwise they are zero.
+*
+*   Returns true, or false if no packet has been received since init/reset
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+bool RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::report(RTCPReportBlock& block, const timepoint now, const RTCPSenderTracker *sender /* = nullptr */)
+{
+    guard lock(_lock(), std::adopt_lock);
+
+    if (!_source.started) {
+        return false;
+    }
+
+    uint32 extended_max = _source.cycles + _source.max_seq;
+    uint32 expected = extended_max - _source.base_seq + 1;
+    int64  lost = (int64)expected - (int64)_source.received;
+
+    // cumulative lost is a 24 bit signed value; clamp rather than wrap
+    if (lost > 0x7fffff) {
+        lost = 0x7fffff;
+    } else if (lost < -0x800000) {
+        lost = -0x800000;
+    }
+
+    uint32 expected_interval = expected - _source.expected_prior;
+    uint32 received_interval = _source.received - _source.received_prior;
+    int64  lost_interval = (int64)expected_interval - (int64)received_interval;
+    uint32 fraction = 0;
+
+    _source.expected_prior = expected;
+    _source.received_prior = _source.received;
+    if ((expected_interval != 0) && (lost_interval > 0)) {
+        fraction = (uint32)((lost_interval << 8) / expected_interval);
+    }
+
+    block.ssrc = htonl(_source.ssrc);
+    block.lost = htonl((fraction << 24) | ((uint32)lost & 0xffffff));
+    block.highest_sequence = htonl(extended_max);
+    block.jitter = htonl((uint32)_stats.jitter);
+    block.lsr = htonl((sender != nullptr) ? sender->lsr() : 0);
+    block.dlsr = htonl((sender != nullptr) ? sender->dlsr(now) : 0);
+    return true;
+}
+
+
+
+/******************************************************************************
+*   Fills report blocks for 'count' buffers into 'out', back to back, so one
+*   reporting pass can cover thousands of streams in a single array that is
+*   then cut into RR packets (see RTCPReceiverReport::build()).  Buffers that
+*   have not received anything are skipped, so 'out' may end up shorter than
+*   'count'.
+*
+*   Returns number of blocks written
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+unsigned RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::fill_reports(RTPJitterT *const *buffers, const RTCPSenderTracker *const *senders,
+                                 const unsigned count, const timepoint now, RTCPReportBlock *out)
+{
+    unsigned written = 0;
+
+    for (unsigned i = 0; i < count; ++i) {
+        const RTCPSenderTracker *sender = (senders != nullptr) ? senders[i] : nullptr;
+        if ((buffers[i] != nullptr) && buffers[i]->report(out[written], now, sender)) {
+            ++written;
+        }
+    }
+    return written;
+}
+
+
+
+/******************************************************************************
+*   Clean items out of our buffer and delete/release memory resources.
+*
+*   Returns none
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_clean_buffer()
+{
+    for (const rawrtp_ptr& p : _buffer) {
+        _account(p, -1);
+    }
+    _buffer.clear();
+    _depth_ms = 0;
+}
+
+
+
+/******************************************************************************
+*   Counts a packet entering (sign 1) or leaving (sign -1) the buffer against
+*   this buffer and the process.  A view into a shared block costs its
+*   RTPPacket and its backing_share of the block, so a block pinned by the
+*   views in a buffer is charged to that buffer.
+*
+*   Returns none
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_account(const rawrtp_ptr& p, const int sign)
+{
+    int64 cost = sign * (int64)_cost(*p);
+
+    _memory_bytes += cost;
+    _packet_bytes += cost;
+    RTPMemory::add(RTPMemory::JITTER_BUFFERS, cost);
+}
+
+
+
+/******************************************************************************
+*   Drops the front packet to make room, as an overflow.  The caller counts
+*   the overflow.
+*
+*   Returns none
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_drop_front()
+{
+    rawrtp_ptr old_packet = std::move(_buffer.front());
+
+    _buffer.pop_front();
+    _depth_ms -= old_packet->payload_ms;
+    _account(old_packet, -1);
+    _observer.on_overflow(*old_packet);
+}
+
+
+
+/******************************************************************************
+*   Finds the index of the start of payload data in the given RTP packet by
+*   accounting for the standard header and any possible extensions, etc.
+*
+*   Returns pointer to first byte of payload data, nullptr on error
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+uint8 *RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_get_payload(RTPHeader *packet)
+{
+    uint8  *payload = (uint8 *)packet;
+
+    if (payload != nullptr) {
+
+        payload += sizeof(RTPHeader);
+
+        // TODO: account for CSRC identifiers
+
+        // if the extension header bit is set, skip the dynamically
+        //  sized header extension.
+        uint16 flags = ntohs(packet->flags);
+        if (flags & RTP_FLAGS_EXTENSION) {
+            RTPHeaderExt *ext = (RTPHeaderExt *)payload;
+            payload += sizeof(ext->profile_specific)
+                    +  sizeof(ext->ext_length)
+                    + (sizeof(ext->ext_data[0]) * ntohs(ext->ext_length));
+        }
+
+        // special handling for the Dynamic payload type
+        if (_get_payload_type(packet) == RTP_PAYLOAD_DYNAMIC) {
+            // skip over the redundant payload, etc.
+            payload += 3;   // skip to the redundant block length
+            payload += *payload + 1;    // should skip over the redundant size and the redundant payload
+            payload += 1;   // ... and finally, skip over the primary Payload Type (which SHOULD be 18 G.729)
+        }
+    }
+    return payload;
+}
+
+
+
+/******************************************************************************
+*   Utility/convenience function to extract Payload Type from an RTP Header.
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+uint8 RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_get_payload_type(RTPHeader *packet)
+{
+    uint8 payload_type;
+
+    uint16 flags = ntohs(packet->flags);
+    payload_type = flags & RTP_FLAGS_PAYLOAD_TYPE;
+
+    return payload_type;
+}
+
+
+
+/******************************************************************************
+*   Sends given string to stdout.
+*
+*   Returns none
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_log(std::string s)
+{
+   // cout << s << endl;
+}
+
+
+
+/******************************************************************************
+*   Just like the name says ... resets the jitter buffer statistics
+*
+*   Returns none
+******************************************************************************/
+template<class Observer, class LockPolicy, class ClockPolicy, class StoragePolicy>
+void RTPJitterT<Observer, LockPolicy, ClockPolicy, StoragePolicy>::_reset_buffer_stats(uint32 sample_rate)
+{
+    _stats.ooo_count = 0;
+    _stats.empty_count = 0;
+    _stats.overflow_count = 0;
+    _stats.dropped_count = 0;
+    _stats.bad_count = 0;
+    _stats.jitter = 0.0;
+    _stats.max_jitter = 0.0;
+    _stats.prev_transit = 0;
+    _stats.first_rx_timestamp = timepoint::min();
+    _stats.prev_rx_timestamp = timepoint::min();
+    _stats.conversion_factor_timestamp_units = sample_rate / 1000;
+
+    memset(&_source, 0, sizeof(_source));
+}
+
+
+
+#endif  // RTP_JITTER_IMPL_H_2b6e9f13_7d4a_4c58_a0e1_93f5c8d2b760
@@ -0,0 +1,151 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_JITTER_POLICY_H_4e71b0c9_a2d6_4f38_8c15_d9e63f0a7b24
+#define RTP_JITTER_POLICY_H_4e71b0c9_a2d6_4f38_8c15_d9e63f0a7b24
+
+#include <atomic>
+#include <ctime>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <sched.h>
+#include "stdinc.h"
+#include "rtp.h"
+
+// policies for RTPJitterT, see rtp_jitter.h.
+//
+//  LockPolicy      anything with lock(), unlock() and try_lock().  The
+//                  buffer takes it once per call and never re-enters it, so
+//                  std::mutex works as well as the default
+//                  std::recursive_mutex.
+//  ClockPolicy     a static now() returning a timepoint, read by the
+//                  push() and pop() overloads that aren't given a time.
+//  StoragePolicy   a member template 'queue<Alloc>' naming a sequence of
+//                  rawrtp_ptr with push_front/back, pop_front, insert and
+//                  bidirectional iterators, built from an Alloc; and
+//                  CAPACITY, the most packets it may hold (0 for no limit).
+//                  See rtp_fixed.h for a bounded one.
+
+
+
+/******************************************************************************
+*   No synchronization at all, for a buffer that only ever sees one thread.
+******************************************************************************/
+struct RTPNoLock
+{
+    void    lock()          {}
+    void    unlock()        {}
+    bool    try_lock()      { return true; }
+};
+
+
+
+/******************************************************************************
+*   Test-and-test-and-set spin lock, for buffers whose critical sections are
+*   always short and whose threads are pinned, where a futex sleep costs more
+*   than the wait.  Yields after a while so a preempted holder can run.
+*   Not recursive.
+******************************************************************************/
+class RTPSpinLock
+{
+public:
+    RTPSpinLock() : _locked(false) {}
+
+    void lock()
+    {
+        unsigned spins = 0;
+
+        while (_locked.exchange(true, std::memory_order_acquire)) {
+            while (_locked.load(std::memory_order_relaxed)) {
+                if (++spins < 1024) {
+#if defined(__x86_64__) || defined(__i386__)
+                    __builtin_ia32_pause();
+#endif
+                } else {
+                    sched_yield();
+                }
+            }
+        }
+    }
+
+    bool try_lock()
+    {
+        return !_locked.load(std::memory_order_relaxed)
+            && !_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock()   { _locked.store(false, std::memory_order_release); }
+
+private:
+    std::atomic<bool>   _locked;
+};
+
+
+
+/******************************************************************************
+*   Clocks.  RTPSteadyClock is stdclock; RTPCoarseClock reads the same clock
+*   (CLOCK_MONOTONIC) at tick resolution, typically 1-4ms, for a fraction
+*   of the cost -- plenty for buffering decisions made in 20ms packets.
+******************************************************************************/
+struct RTPSteadyClock
+{
+    static timepoint now()  { return stdclock::now(); }
+};
+
+struct RTPCoarseClock
+{
+    static timepoint now()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return timepoint(clocks::duration_cast<stdclock::duration>(
+                   clocks::seconds(ts.tv_sec) + clocks::nanoseconds(ts.tv_nsec)));
+    }
+};
+
+
+
+/******************************************************************************
+*   Storage.  A deque is the default (see note 1 in the README); a list
+*   trades cache locality for constant time insertion of late packets
+*   anywhere in a deep buffer.
+******************************************************************************/
+struct RTPDequeStorage
+{
+    static const size_t CAPACITY = 0;
+
+    template<class Alloc>
+    using queue = std::deque<rawrtp_ptr, Alloc>;
+};
+
+struct RTPListStorage
+{
+    static const size_t CAPACITY = 0;
+
+    template<class Alloc>
+    using queue = std::list<rawrtp_ptr, Alloc>;
+};
+
+#endif  // RTP_JITTER_POLICY_H_4e71b0c9_a2d6_4f38_8c15_d9e63f0a7b24
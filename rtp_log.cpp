@@ -0,0 +1,357 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   asynchronous binary event log.
+*
+******************************************************************************/
+
+#include "rtp_log.h"
+#include <condition_variable>
+#include <memory>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+
+namespace {
+
+// one line of text per event, each given all MAX_ARGS arguments as long long
+const char *const FORMATS[RTPLog::EVENTS] = {
+    "RTPJitter::push(): buffer overflow: buffer depth: %lld  packet #%lld",
+    "jitter.push(): ooo packet #%lld",
+    "RTPForwarder::_send(): sendmmsg failed: %lld",
+};
+
+struct entry
+{
+    uint64  stamp;
+    uint32  event;
+    uint32  reserved;
+    int64   args[RTPLog::MAX_ARGS];
+};
+
+// head and tail live on separate cache lines so the producer and the writer
+//  thread don't bounce one line between them on every record.
+struct ring
+{
+    std::atomic<uint64> head;           // next slot to fill; owning thread only
+    uint64              cached_tail;    // owning thread's last look at 'tail'
+    std::atomic<uint64> lost;           // owning thread only
+    uint8               pad0[40];
+    std::atomic<uint64> tail;           // next slot to write out; writer only
+    std::atomic<bool>   orphaned;       // owning thread has exited
+    uint64              reported_lost;  // writer only
+    unsigned            thread_index;
+    uint8               pad1[36];
+    entry               entries[RTPLog::RING_RECORDS];
+};
+
+struct logger
+{
+    std::mutex                      mutex;      // guards everything but the rings' contents
+    std::condition_variable         wake;
+    std::vector<std::shared_ptr<ring>> rings;
+    std::thread                     writer;
+    bool                            running;
+    FILE                           *out;
+    unsigned                        flush_ms;
+    unsigned                        next_thread;
+    uint64                          retired_lost;   // from rings already removed
+    uint64                          origin_stamp;
+    timepoint                       origin;
+
+    logger();
+    ~logger();
+};
+
+// the calling thread's ring; marked orphaned when the thread exits so the
+//  writer can drain it and let it go.
+struct ring_owner
+{
+    std::shared_ptr<ring>   r;
+
+    ~ring_owner() { if (r) r->orphaned.store(true, memory_order_release); }
+};
+
+thread_local ring_owner owner;
+
+
+inline uint64 stamp_now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64)clocks::duration_cast<clocks::nanoseconds>(stdclock::now().time_since_epoch()).count();
+#endif
+}
+
+logger& the_logger()
+{
+    static logger l;
+    return l;
+}
+
+logger::logger()
+    : running(false), out(stdout), flush_ms(10), next_thread(0), retired_lost(0)
+{
+    origin_stamp = stamp_now();
+    origin = stdclock::now();
+}
+
+logger::~logger()
+{
+    RTPLog::stop();
+}
+
+ring *attach()
+{
+    logger& l = the_logger();
+
+    owner.r = make_shared<ring>();
+    owner.r->head.store(0, memory_order_relaxed);
+    owner.r->cached_tail = 0;
+    owner.r->lost.store(0, memory_order_relaxed);
+    owner.r->tail.store(0, memory_order_relaxed);
+    owner.r->orphaned.store(false, memory_order_relaxed);
+    owner.r->reported_lost = 0;
+
+    unique_lock<mutex> lock(l.mutex);
+    owner.r->thread_index = l.next_thread++;
+    l.rings.push_back(owner.r);
+    return owner.r.get();
+}
+
+// seconds since the logger was created, for a raw stamp.  The stamp rate is
+//  measured over the whole life of the logger, so it only gets better.
+double stamp_seconds(const logger& l, const uint64 stamp, const double ns_per_tick)
+{
+    return ((int64)(stamp - l.origin_stamp) * ns_per_tick) / 1e9;
+}
+
+// writes out whatever the rings hold.  Writer thread (or stop()) only.
+void drain(logger& l)
+{
+    vector<shared_ptr<ring>> rings;
+    {
+        unique_lock<mutex> lock(l.mutex);
+        rings = l.rings;
+    }
+
+    double ns_per_tick = 1.0;
+#if defined(__x86_64__) || defined(__i386__)
+    uint64 ticks = stamp_now() - l.origin_stamp;
+    int64  ns = clocks::duration_cast<clocks::nanoseconds>(stdclock::now() - l.origin).count();
+    if (ticks > 0) {
+        ns_per_tick = (double)ns / (double)ticks;
+    }
+#endif
+
+    char    line[256];
+    bool    wrote = false;
+
+    for (shared_ptr<ring>& r : rings) {
+        // check 'orphaned' first: once it is set, no more records can arrive
+        bool    orphaned = r->orphaned.load(memory_order_acquire);
+        uint64  tail = r->tail.load(memory_order_relaxed);
+        uint64  head = r->head.load(memory_order_acquire);
+
+        for (; tail != head; ++tail) {
+            const entry& e = r->entries[tail & (RTPLog::RING_RECORDS - 1)];
+            double  t = stamp_seconds(l, e.stamp, ns_per_tick);
+            int     n = snprintf(line, sizeof(line), "[%.6f] ", t);
+
+            if (e.event < RTPLog::EVENTS) {
+                n += snprintf(line + n, sizeof(line) - n, FORMATS[e.event],
+                              (long long)e.args[0], (long long)e.args[1],
+                              (long long)e.args[2], (long long)e.args[3]);
+            } else {
+                n += snprintf(line + n, sizeof(line) - n, "unknown event %u", e.event);
+            }
+            if (n > (int)sizeof(line) - 2) {
+                n = sizeof(line) - 2;
+            }
+            line[n++] = '\n';
+            fwrite(line, 1, n, l.out);
+            wrote = true;
+        }
+        r->tail.store(tail, memory_order_release);
+
+        uint64 lost = r->lost.load(memory_order_relaxed);
+        if (lost != r->reported_lost) {
+            fprintf(l.out, "RTPLog: %llu records lost on thread %u\n",
+                    (unsigned long long)(lost - r->reported_lost), r->thread_index);
+            r->reported_lost = lost;
+            wrote = true;
+        }
+
+        if (orphaned) {
+            unique_lock<mutex> lock(l.mutex);
+            for (size_t i = 0; i < l.rings.size(); ++i) {
+                if (l.rings[i] == r) {
+                    l.retired_lost += lost;
+                    l.rings.erase(l.rings.begin() + i);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (wrote) {
+        fflush(l.out);
+    }
+}
+
+void write_loop(logger *l)
+{
+    unique_lock<mutex> lock(l->mutex);
+    while (l->running) {
+        l->wake.wait_for(lock, clocks::milliseconds(l->flush_ms));
+        lock.unlock();
+        drain(*l);
+        lock.lock();
+    }
+}
+
+}   // namespace
+
+
+
+/******************************************************************************
+*   Records one event in the calling thread's ring.  The first call on a
+*   thread allocates and registers its ring unless attach_thread() already
+*   has; after that this is a handful of stores and a timestamp read.
+*
+*   Returns none
+******************************************************************************/
+void RTPLog::record(const event e, const int64 a0 /* = 0 */, const int64 a1 /* = 0 */,
+                    const int64 a2 /* = 0 */, const int64 a3 /* = 0 */)
+{
+    ring *r = owner.r.get();
+    if (r == nullptr) {
+        r = attach();
+    }
+
+    uint64 head = r->head.load(memory_order_relaxed);
+    if ((head - r->cached_tail) >= RING_RECORDS) {
+        r->cached_tail = r->tail.load(memory_order_acquire);
+        if ((head - r->cached_tail) >= RING_RECORDS) {
+            r->lost.store(r->lost.load(memory_order_relaxed) + 1, memory_order_relaxed);
+            return;
+        }
+    }
+
+    entry& slot = r->entries[head & (RING_RECORDS - 1)];
+    slot.stamp = stamp_now();
+    slot.event = e;
+    slot.args[0] = a0;
+    slot.args[1] = a1;
+    slot.args[2] = a2;
+    slot.args[3] = a3;
+    r->head.store(head + 1, memory_order_release);
+}
+
+
+
+/******************************************************************************
+*   Allocates and registers the calling thread's ring if it has none yet, so
+*   the thread's first record() does not do it -- typically with a jitter
+*   buffer's lock held.  Call it at the top of media threads; calling it
+*   again is harmless.
+*
+*   Returns none
+******************************************************************************/
+void RTPLog::attach_thread()
+{
+    if (owner.r == nullptr) {
+        attach();
+    }
+}
+
+
+
+/******************************************************************************
+*   Starts the writer thread, which wakes every 'flush_ms' to write out the
+*   rings to 'out'.
+*
+*   Returns true if the writer is running
+******************************************************************************/
+bool RTPLog::start(FILE *out /* = stdout */, const unsigned flush_ms /* = 10 */)
+{
+    logger& l = the_logger();
+    unique_lock<mutex> lock(l.mutex);
+
+    if (l.running) {
+        return true;
+    }
+    l.out = (out != nullptr) ? out : stdout;
+    l.flush_ms = flush_ms ? flush_ms : 1;
+    l.running = true;
+    l.writer = thread(write_loop, &l);
+    return true;
+}
+
+
+
+/******************************************************************************
+*   Stops the writer thread after a final pass over the rings.
+*
+*   Returns nothing
+******************************************************************************/
+void RTPLog::stop()
+{
+    logger& l = the_logger();
+    {
+        unique_lock<mutex> lock(l.mutex);
+        if (!l.running) {
+            return;
+        }
+        l.running = false;
+        l.wake.notify_all();
+    }
+    l.writer.join();
+    drain(l);
+}
+
+
+
+/******************************************************************************
+*   Total records dropped because a ring was full.
+*
+*   Returns count of lost records
+******************************************************************************/
+uint64 RTPLog::lost()
+{
+    logger& l = the_logger();
+    unique_lock<mutex> lock(l.mutex);
+
+    uint64 total = l.retired_lost;
+    for (const shared_ptr<ring>& r : l.rings) {
+        total += r->lost.load(memory_order_relaxed);
+    }
+    return total;
+}
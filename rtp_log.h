@@ -0,0 +1,80 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_LOG_H_71c2e9a4_0b3d_4f65_9a87_e5d1c6b04f2a
+#define RTP_LOG_H_71c2e9a4_0b3d_4f65_9a87_e5d1c6b04f2a
+
+#include <atomic>
+#include <cstdio>
+#include "stdinc.h"
+
+
+
+/******************************************************************************
+*   Asynchronous binary event log for the media path.  record() copies an
+*   event id, up to MAX_ARGS integer arguments and a raw timestamp into a
+*   ring owned by the calling thread -- no lock, no formatting, no system
+*   call -- and a background thread started with start() turns the records
+*   into text and writes them out.
+*
+*   Each thread's ring is single-producer/single-consumer.  When a ring is
+*   full the record is dropped and counted; the writer thread reports the
+*   number lost, and lost() returns the running total.  Records made before
+*   start() wait in the rings (up to their capacity) and are written once the
+*   writer is running.
+*
+*   A thread's ring (RING_RECORDS records) is allocated and registered by
+*   its first record(), which usually happens under a jitter buffer's lock.
+*   Media threads should call attach_thread() once when they start so that
+*   cost is paid up front.
+*
+*   To add an event, add it to 'event' and give it a format in rtp_log.cpp;
+*   arguments are int64 and are formatted with %lld.
+******************************************************************************/
+class RTPLog
+{
+public:
+    enum event
+    {
+        JITTER_OVERFLOW = 0,        // depth_ms, sequence
+        JITTER_OUT_OF_ORDER,        // sequence
+        FORWARD_SEND_FAILED,        // errno
+        EVENTS
+    };
+
+    static const unsigned MAX_ARGS     = 4;
+    static const unsigned RING_RECORDS = 1024;      // per thread, power of 2
+
+    static void     record(const event e, const int64 a0 = 0, const int64 a1 = 0,
+                           const int64 a2 = 0, const int64 a3 = 0);
+    static void     attach_thread();        // sets up the calling thread's ring now
+
+    static bool     start(FILE *out = stdout, const unsigned flush_ms = 10);
+    static void     stop();                 // writes out everything recorded so far
+    static uint64   lost();
+};
+
+#define RTPLOG(e, ...)  RTPLog::record(RTPLog::e, ##__VA_ARGS__)
+
+#endif  // RTP_LOG_H_71c2e9a4_0b3d_4f65_9a87_e5d1c6b04f2a
@@ -0,0 +1,153 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   process-wide memory accounting.
+*
+******************************************************************************/
+
+#include "rtp_memory.h"
+
+using namespace std;
+
+
+RTPMemory::slot         RTPMemory::_slots[RTPMemory::SLOTS];
+atomic<int64>           RTPMemory::_budget(0);
+atomic<bool>            RTPMemory::_over_budget(false);
+atomic<int64>           RTPMemory::_high_water(0);
+
+namespace {
+
+atomic<unsigned>        next_slot(0);
+
+struct thread_slot
+{
+    unsigned    index;
+    unsigned    calls;
+
+    thread_slot() : index(next_slot.fetch_add(1) % RTPMemory::SLOTS), calls(0) {}
+};
+
+thread_local thread_slot current;
+
+}   // namespace
+
+
+
+/******************************************************************************
+*   Counts 'bytes' (negative when freeing) against category 'c' in the calling
+*   thread's slot.  Every REFRESH_EVERY calls it also refreshes the budget
+*   flag and the high water mark.
+*
+*   Returns nothing
+******************************************************************************/
+void RTPMemory::add(const category c, const int64 bytes)
+{
+    _slots[current.index].bytes[c].fetch_add(bytes, memory_order_relaxed);
+
+    if ((++current.calls % REFRESH_EVERY) == 0) {
+        _refresh();
+    }
+}
+
+
+
+/******************************************************************************
+*   Bytes currently accounted for, across all categories.
+*
+*   Returns byte count
+******************************************************************************/
+int64 RTPMemory::total()
+{
+    int64 sum = 0;
+
+    for (unsigned c = 0; c < CATEGORIES; ++c) {
+        sum += total((category)c);
+    }
+    return sum;
+}
+
+
+
+/******************************************************************************
+*   Bytes currently accounted for in one category.
+*
+*   Returns byte count
+******************************************************************************/
+int64 RTPMemory::total(const category c)
+{
+    int64 sum = 0;
+
+    for (unsigned i = 0; i < SLOTS; ++i) {
+        sum += _slots[i].bytes[c].load(memory_order_relaxed);
+    }
+    return sum;
+}
+
+
+
+/******************************************************************************
+*   The highest total seen so far.  Totals are sampled every REFRESH_EVERY
+*   allocations per thread, so a short peak between samples may be missed.
+*
+*   Returns byte count
+******************************************************************************/
+int64 RTPMemory::high_water()
+{
+    _refresh();
+    return _high_water.load(memory_order_relaxed);
+}
+
+
+
+/******************************************************************************
+*   Sets the process-wide budget; 0 removes it.
+*
+*   Returns nothing
+******************************************************************************/
+void RTPMemory::set_budget(const int64 bytes)
+{
+    _budget.store((bytes > 0) ? bytes : 0, memory_order_relaxed);
+    _refresh();
+}
+
+
+
+/******************************************************************************
+*   Re-adds the slots to update the budget flag and the high water mark.
+*   The budget leaves RESERVED out; the high water mark counts everything.
+*
+*   Returns nothing
+******************************************************************************/
+void RTPMemory::_refresh()
+{
+    int64 reserved = total(RESERVED);
+    int64 sum = total();
+    int64 limit = _budget.load(memory_order_relaxed);
+
+    _over_budget.store((limit > 0) && (sum - reserved > limit), memory_order_relaxed);
+
+    int64 high = _high_water.load(memory_order_relaxed);
+    while ((sum > high) && !_high_water.compare_exchange_weak(high, sum, memory_order_relaxed)) {
+    }
+}
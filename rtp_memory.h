@@ -0,0 +1,130 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_MEMORY_H_d84a1c37_60e2_4b9f_95c3_7e2f0a6b1d58
+#define RTP_MEMORY_H_d84a1c37_60e2_4b9f_95c3_7e2f0a6b1d58
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include "stdinc.h"
+
+
+
+/******************************************************************************
+*   Process-wide memory accounting for jitter buffers and buffer pools.
+*
+*   Every RTPJitter and RTPBufferPool reports the bytes it allocates and
+*   frees through add().  The counts are spread over cache-line sized slots,
+*   one per thread (modulo SLOTS), so media threads on different cores don't
+*   fight over one counter; total() adds the slots up.
+*
+*   With a budget set, over_budget() tells the buffers to shed packets
+*   through their overflow policy rather than grow.  Only memory that
+*   shedding can give back is held against the budget: RESERVED (idle pool
+*   blocks, fixed arenas) is reported but not counted, or a warm pool could
+*   keep the process over budget with every buffer empty.  It is refreshed every
+*   REFRESH_EVERY calls to add() on each thread, so it may lag the true total
+*   by a few packets per thread.
+******************************************************************************/
+class RTPMemory
+{
+public:
+    enum category
+    {
+        JITTER_BUFFERS = 0,         // RTPJitter objects, their queues and packets
+        BUFFER_POOLS,               // RTPBufferPool blocks in use
+        RESERVED,                   // idle pool blocks and fixed pool arenas
+        CATEGORIES
+    };
+
+    static const unsigned SLOTS = 64;
+    static const unsigned REFRESH_EVERY = 64;
+
+    static void     add(const category c, const int64 bytes);   // negative to release
+    static int64    total();
+    static int64    total(const category c);
+    static int64    high_water();   // highest total() seen by a refresh
+
+    static void     set_budget(const int64 bytes);               // 0 for none
+    static int64    budget()        { return _budget.load(std::memory_order_relaxed); }
+    static bool     over_budget()   { return _over_budget.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) slot {
+        std::atomic<int64>  bytes[CATEGORIES];
+    };
+
+    static slot                 _slots[SLOTS];
+    static std::atomic<int64>   _budget;
+    static std::atomic<bool>    _over_budget;
+    static std::atomic<int64>   _high_water;
+
+    static void     _refresh();
+};
+
+
+
+/******************************************************************************
+*   Allocator that counts what a container allocates, both into a per-owner
+*   counter and into RTPMemory.  The owner's counter is a plain integer, so
+*   the container must only be changed under the owner's lock.
+******************************************************************************/
+template<class T>
+struct RTPCountingAllocator
+{
+    typedef T value_type;
+
+    int64  *bytes;
+
+    RTPCountingAllocator(int64 *counter) : bytes(counter) {}
+
+    template<class U>
+    RTPCountingAllocator(const RTPCountingAllocator<U>& other) : bytes(other.bytes) {}
+
+    T *allocate(const size_t n)
+    {
+        size_t size = n * sizeof(T);
+        T *p = static_cast<T *>(::operator new(size));
+        *bytes += size;
+        RTPMemory::add(RTPMemory::JITTER_BUFFERS, size);
+        return p;
+    }
+
+    void deallocate(T *p, const size_t n)
+    {
+        size_t size = n * sizeof(T);
+        ::operator delete(p);
+        *bytes -= size;
+        RTPMemory::add(RTPMemory::JITTER_BUFFERS, -(int64)size);
+    }
+};
+
+template<class T, class U>
+bool operator==(const RTPCountingAllocator<T>& a, const RTPCountingAllocator<U>& b) { return a.bytes == b.bytes; }
+
+template<class T, class U>
+bool operator!=(const RTPCountingAllocator<T>& a, const RTPCountingAllocator<U>& b) { return a.bytes != b.bytes; }
+
+#endif  // RTP_MEMORY_H_d84a1c37_60e2_4b9f_95c3_7e2f0a6b1d58
@@ -0,0 +1,543 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   OpenMetrics exporter for RTPJitter statistics.
+*
+******************************************************************************/
+
+#include "rtp_metrics.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+const double RTPMetricsExporter::DEPTH_LE[DEPTH_BUCKETS] =
+    { 0.02, 0.04, 0.06, 0.08, 0.1, 0.12, 0.16, 0.2, 0.3, 0.5 };
+const double RTPMetricsExporter::JITTER_LE[JITTER_BUCKETS] =
+    { 0.001, 0.002, 0.005, 0.01, 0.02, 0.03, 0.05, 0.1, 0.2 };
+const double RTPMetricsExporter::RESIDENCE_LE[RESIDENCE_BUCKETS] =
+    { 0.01, 0.02, 0.04, 0.06, 0.08, 0.1, 0.12, 0.16, 0.2, 0.3, 0.5, 1.0 };
+
+
+
+/******************************************************************************
+*   Sets up 'shards' empty registries.  Nothing is served until start().
+*
+*   Returns n/a
+******************************************************************************/
+RTPMetricsExporter::RTPMetricsExporter(const unsigned shards, const uint16 port /* = DEFAULT_PORT */,
+                                       const string& address /* = "127.0.0.1" */)
+    : _address(address), _port(port), _socket(-1), _running(false)
+{
+    for (unsigned i = 0; i < shards; ++i) {
+        _shards.push_back(unique_ptr<shard>(new shard()));
+        memset(&_shards.back()->retired, 0, sizeof(totals));
+        _shards.back()->readers = 0;
+    }
+}
+
+
+
+/******************************************************************************
+*   Stops serving.
+*
+*   Returns n/a
+******************************************************************************/
+RTPMetricsExporter::~RTPMetricsExporter()
+{
+    stop();
+}
+
+
+
+/******************************************************************************
+*   Registers a buffer with a shard.  Typically called from RTPIngest's flow
+*   callback.
+*
+*   Returns true, or false if 'shard' is out of range
+******************************************************************************/
+bool RTPMetricsExporter::add(const unsigned shard, const RTPJitter *jitter)
+{
+    if ((shard >= _shards.size()) || (jitter == nullptr)) {
+        return false;
+    }
+
+    scoped_lock lock(_shards[shard]->mutex);
+    _shards[shard]->buffers.insert(jitter);
+    return true;
+}
+
+
+
+/******************************************************************************
+*   Unregisters a buffer that is about to go away, keeping its counters in
+*   the shard's totals.  Once this returns the exporter will not touch the
+*   buffer again: if a scrape is reading the shard, this waits for it.
+*
+*   Returns nothing
+******************************************************************************/
+void RTPMetricsExporter::remove(const unsigned shard, const RTPJitter *jitter)
+{
+    if (shard >= _shards.size()) {
+        return;
+    }
+
+    auto& sh = *_shards[shard];
+    unique_lock<mutex> lock(sh.mutex);
+    if (sh.buffers.erase(jitter) > 0) {
+        _accumulate(sh.retired, *jitter, jitter->snapshot());
+        sh.idle.wait(lock, [&sh] { return sh.readers == 0; });
+    }
+}
+
+
+
+/******************************************************************************
+*   Binds the listening socket and starts the server thread.
+*
+*   Returns true on success, false if the socket could not be opened/bound
+******************************************************************************/
+bool RTPMetricsExporter::start()
+{
+    if (_running.load()) {
+        return true;
+    }
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(_port);
+    if (inet_pton(AF_INET, _address.c_str(), &local.sin_addr) != 1) {
+        LOGD("RTPMetricsExporter::start(): bad address: %s\n", _address.c_str());
+        return false;
+    }
+
+    _socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (_socket < 0) {
+        LOGD("RTPMetricsExporter::start(): socket() failed: %d\n", errno);
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    socklen_t len = sizeof(local);
+    if ((bind(_socket, (sockaddr *)&local, sizeof(local)) < 0)
+     || (listen(_socket, 16) < 0)
+     || (getsockname(_socket, (sockaddr *)&local, &len) < 0))
+    {
+        LOGD("RTPMetricsExporter::start(): bind/listen on port %u failed: %d\n", _port, errno);
+        close(_socket);
+        _socket = -1;
+        return false;
+    }
+    _port = ntohs(local.sin_port);
+
+    _running = true;
+    _thread = thread(&RTPMetricsExporter::_serve, this);
+    return true;
+}
+
+
+
+/******************************************************************************
+*   Stops the server thread and closes the listening socket.  The server
+*   notices within one poll interval.
+*
+*   Returns nothing
+******************************************************************************/
+void RTPMetricsExporter::stop()
+{
+    _running = false;
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_socket >= 0) {
+        close(_socket);
+        _socket = -1;
+    }
+}
+
+
+
+/******************************************************************************
+*   Builds the exposition.  Each shard's registry is locked only long enough
+*   to copy its buffer list; the buffers are read after it is released, so
+*   add() never waits for a scrape (remove() does, for the buffer's sake).
+*   The text itself is written afterwards, one metric family at a time as
+*   OpenMetrics requires.
+*
+*   Returns OpenMetrics text, terminated by "# EOF"
+******************************************************************************/
+string RTPMetricsExporter::render()
+{
+    struct view {
+        uint64                      streams;
+        uint64                      buffering;
+        double                      max_jitter;
+        uint64                      memory_bytes;
+        totals                      counters;
+        histogram<DEPTH_BUCKETS>    depth;
+        histogram<DEPTH_BUCKETS>    nominal_depth;
+        histogram<JITTER_BUCKETS>   jitter;
+    };
+
+    vector<view>                views(_shards.size());
+    vector<const RTPJitter *>   buffers;
+
+    for (unsigned n = 0; n < _shards.size(); ++n) {
+        view&   v = views[n];
+        shard&  sh = *_shards[n];
+
+        memset(&v, 0, sizeof(v));
+        {
+            scoped_lock lock(sh.mutex);
+            v.counters = sh.retired;
+            buffers.assign(sh.buffers.begin(), sh.buffers.end());
+            ++sh.readers;
+        }
+
+        for (const RTPJitter *jitter : buffers) {
+            RTPJitter::statistics s = jitter->snapshot();
+            double rate = s.sample_rate ? (double)s.sample_rate : 8000.0;
+            double current = s.jitter / rate;
+            double highest = s.max_jitter / rate;
+
+            ++v.streams;
+            v.memory_bytes += s.memory_bytes;
+            if (s.buffering) {
+                ++v.buffering;
+            }
+            if (highest > v.max_jitter) {
+                v.max_jitter = highest;
+            }
+            _accumulate(v.counters, *jitter, s);
+            _observe(v.depth, DEPTH_LE, s.depth_ms / 1000.0);
+            _observe(v.nominal_depth, DEPTH_LE, s.nominal_depth_ms / 1000.0);
+            _observe(v.jitter, JITTER_LE, current);
+        }
+
+        scoped_lock lock(sh.mutex);
+        if (--sh.readers == 0) {
+            sh.idle.notify_all();
+        }
+    }
+
+    string  out;
+    char    line[256];
+
+    out.reserve(4096 * (_shards.size() + 1));
+
+    // simple per-shard values: gauges and counters
+    struct family {
+        const char *name;
+        const char *type;
+        const char *help;
+        double    (*value)(const view& v);
+    };
+    const family families[] = {
+        { "rtp_jitter_streams", "gauge", "Jitter buffers registered",
+          [](const view& v) { return (double)v.streams; } },
+        { "rtp_jitter_buffering_streams", "gauge", "Jitter buffers currently buffering",
+          [](const view& v) { return (double)v.buffering; } },
+        { "rtp_jitter_max_jitter_seconds", "gauge", "Highest lifetime interarrival jitter of any registered stream",
+          [](const view& v) { return v.max_jitter; } },
+        { "rtp_jitter_memory_bytes", "gauge", "Bytes held by registered jitter buffers, including queued packets",
+          [](const view& v) { return (double)v.memory_bytes; } },
+        { "rtp_jitter_overflows", "counter", "Packets discarded from the front of a full buffer",
+          [](const view& v) { return (double)v.counters.overflows; } },
+        { "rtp_jitter_out_of_order", "counter", "Packets that arrived out of order",
+          [](const view& v) { return (double)v.counters.out_of_order; } },
+        { "rtp_jitter_empty", "counter", "Pops that found the buffer empty",
+          [](const view& v) { return (double)v.counters.empty; } },
+        { "rtp_jitter_dropped", "counter", "Pops that found the next packet missing",
+          [](const view& v) { return (double)v.counters.dropped; } },
+        { "rtp_jitter_bad_packets", "counter", "Packets rejected by push",
+          [](const view& v) { return (double)v.counters.bad_packets; } },
+    };
+
+    for (const family& f : families) {
+        bool counter = (strcmp(f.type, "counter") == 0);
+        bool seconds = (strstr(f.name, "_seconds") != nullptr);
+
+        snprintf(line, sizeof(line), "# TYPE %s %s\n# HELP %s %s.\n", f.name, f.type, f.name, f.help);
+        out += line;
+        if (seconds) {
+            snprintf(line, sizeof(line), "# UNIT %s seconds\n", f.name);
+            out += line;
+        }
+        for (unsigned n = 0; n < views.size(); ++n) {
+            snprintf(line, sizeof(line), "%s%s{shard=\"%u\"} %.17g\n",
+                     f.name, counter ? "_total" : "", n, f.value(views[n]));
+            out += line;
+        }
+    }
+
+    // process-wide, every buffer and pool whether registered or not
+    out += "# TYPE rtp_memory_bytes gauge\n"
+           "# UNIT rtp_memory_bytes bytes\n"
+           "# HELP rtp_memory_bytes Bytes held by all jitter buffers and buffer pools in the process.\n";
+    snprintf(line, sizeof(line), "rtp_memory_bytes{kind=\"jitter_buffers\"} %lld\n"
+                                 "rtp_memory_bytes{kind=\"buffer_pools\"} %lld\n"
+                                 "rtp_memory_bytes{kind=\"reserved\"} %lld\n",
+             (long long)RTPMemory::total(RTPMemory::JITTER_BUFFERS),
+             (long long)RTPMemory::total(RTPMemory::BUFFER_POOLS),
+             (long long)RTPMemory::total(RTPMemory::RESERVED));
+    out += line;
+
+    // distributions across streams
+    out += "# TYPE rtp_jitter_depth_seconds histogram\n"
+           "# UNIT rtp_jitter_depth_seconds seconds\n"
+           "# HELP rtp_jitter_depth_seconds Current buffer depth of each stream.\n";
+    for (unsigned n = 0; n < views.size(); ++n) {
+        const histogram<DEPTH_BUCKETS>& h = views[n].depth;
+        _write_histogram(out, "rtp_jitter_depth_seconds", n, DEPTH_LE, h.buckets, h.count, h.sum);
+    }
+    out += "# TYPE rtp_jitter_nominal_depth_seconds histogram\n"
+           "# UNIT rtp_jitter_nominal_depth_seconds seconds\n"
+           "# HELP rtp_jitter_nominal_depth_seconds Requested buffer depth of each stream.\n";
+    for (unsigned n = 0; n < views.size(); ++n) {
+        const histogram<DEPTH_BUCKETS>& h = views[n].nominal_depth;
+        _write_histogram(out, "rtp_jitter_nominal_depth_seconds", n, DEPTH_LE, h.buckets, h.count, h.sum);
+    }
+    out += "# TYPE rtp_jitter_interarrival_jitter_seconds histogram\n"
+           "# UNIT rtp_jitter_interarrival_jitter_seconds seconds\n"
+           "# HELP rtp_jitter_interarrival_jitter_seconds Current RFC 3550 interarrival jitter of each stream.\n";
+    for (unsigned n = 0; n < views.size(); ++n) {
+        const histogram<JITTER_BUCKETS>& h = views[n].jitter;
+        _write_histogram(out, "rtp_jitter_interarrival_jitter_seconds", n, JITTER_LE, h.buckets, h.count, h.sum);
+    }
+
+    // per-packet, from the buffers that track residence time
+    out += "# TYPE rtp_jitter_residence_seconds histogram\n"
+           "# UNIT rtp_jitter_residence_seconds seconds\n"
+           "# HELP rtp_jitter_residence_seconds Time packets spent in the buffer between push and pop.\n";
+    for (unsigned n = 0; n < views.size(); ++n) {
+        const totals& t = views[n].counters;
+        _write_histogram(out, "rtp_jitter_residence_seconds", n, RESIDENCE_LE,
+                         t.residence, t.residence_count, t.residence_sum);
+    }
+
+    out += "# EOF\n";
+    return out;
+}
+
+
+
+/******************************************************************************
+*   Adds one buffer's counters, and its residence histogram if it has one,
+*   to 't'.  A residence bucket is counted under the first boundary that its
+*   whole range fits below, so a count may show up one boundary late but
+*   never early.
+*
+*   Returns none
+******************************************************************************/
+void RTPMetricsExporter::_accumulate(totals& t, const RTPJitter& jitter, const RTPJitter::statistics& s)
+{
+    t.overflows    += s.lifetime_overflow_count;
+    t.out_of_order += s.lifetime_ooo_count;
+    t.empty        += s.lifetime_empty_count;
+    t.dropped      += s.lifetime_dropped_count;
+    t.bad_packets  += s.lifetime_bad_count;
+
+    const RTPLatencyHistogram *h = jitter.residence();
+    if (h == nullptr) {
+        return;
+    }
+
+    // which of our buckets each of the histogram's buckets falls in
+    static const vector<uint8> boundary = [] {
+        vector<uint8> b(RTPLatencyHistogram::BUCKETS);
+        for (unsigned i = 0; i < RTPLatencyHistogram::BUCKETS; ++i) {
+            double high = RTPLatencyHistogram::bucket_high(i) / 1000000.0;
+            unsigned k = 0;
+            while ((k < RESIDENCE_BUCKETS) && (high > RESIDENCE_LE[k])) {
+                ++k;
+            }
+            b[i] = (uint8)k;
+        }
+        return b;
+    }();
+
+    uint64 count = 0;
+    for (unsigned i = 0; i < RTPLatencyHistogram::BUCKETS; ++i) {
+        uint64 c = h->bucket_count(i);
+        if (c) {
+            t.residence[boundary[i]] += c;
+            count += c;
+        }
+    }
+    t.residence_count += count;
+    t.residence_sum += h->sum() / 1000000.0;
+}
+
+
+
+/******************************************************************************
+*   Counts 'value' in the first bucket whose boundary is at least 'value'.
+*   Buckets are stored non-cumulatively and summed when written.
+*
+*   Returns none
+******************************************************************************/
+template<unsigned N>
+void RTPMetricsExporter::_observe(histogram<N>& h, const double (&le)[N], const double value)
+{
+    unsigned k = 0;
+    while ((k < N) && (value > le[k])) {
+        ++k;
+    }
+    ++h.buckets[k];
+    ++h.count;
+    h.sum += value;
+}
+
+
+
+/******************************************************************************
+*   Writes the _bucket (cumulative), _count and _sum samples of one shard's
+*   histogram.  'buckets' holds N + 1 non-cumulative counts.
+*
+*   Returns none
+******************************************************************************/
+template<unsigned N>
+void RTPMetricsExporter::_write_histogram(string& out, const char *name, const unsigned shard,
+                                          const double (&le)[N], const uint64 *buckets,
+                                          const uint64 count, const double sum)
+{
+    char    line[256];
+    uint64  cumulative = 0;
+
+    for (unsigned k = 0; k < N; ++k) {
+        cumulative += buckets[k];
+        snprintf(line, sizeof(line), "%s_bucket{shard=\"%u\",le=\"%g\"} %llu\n",
+                 name, shard, le[k], (unsigned long long)cumulative);
+        out += line;
+    }
+    snprintf(line, sizeof(line), "%s_bucket{shard=\"%u\",le=\"+Inf\"} %llu\n"
+                                 "%s_count{shard=\"%u\"} %llu\n"
+                                 "%s_sum{shard=\"%u\"} %.17g\n",
+             name, shard, (unsigned long long)count,
+             name, shard, (unsigned long long)count,
+             name, shard, sum);
+    out += line;
+}
+
+
+
+/******************************************************************************
+*   Server thread: accepts one connection at a time and answers it.  Scrapes
+*   are infrequent and the response is built in memory, so there is no need
+*   for anything cleverer.
+*
+*   Returns none
+******************************************************************************/
+void RTPMetricsExporter::_serve()
+{
+    pollfd  pfd;
+
+    pfd.fd = _socket;
+    pfd.events = POLLIN;
+
+    while (_running.load()) {
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+
+        int client = accept4(_socket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            continue;
+        }
+
+        // don't let a stalled client hold up the next scrape forever
+        timeval timeout = { 2, 0 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        _respond(client);
+        close(client);
+    }
+}
+
+
+
+/******************************************************************************
+*   Reads an HTTP/1.x request and answers GET /metrics; anything else gets a
+*   404.  The connection is closed after the response.
+*
+*   Returns none
+******************************************************************************/
+void RTPMetricsExporter::_respond(const int client)
+{
+    char    request[2048];
+    size_t  received = 0;
+
+    // we only need the request line, but read up to the end of the headers
+    //  so the client doesn't see a reset
+    while (received < sizeof(request) - 1) {
+        ssize_t n = recv(client, request + received, sizeof(request) - 1 - received, 0);
+        if (n <= 0) {
+            break;
+        }
+        received += n;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n") != nullptr) {
+            break;
+        }
+    }
+    request[received] = '\0';
+
+    string  body;
+    string  head;
+    bool    found = (strncmp(request, "GET /metrics", 12) == 0)
+                 && ((request[12] == ' ') || (request[12] == '?'));
+
+    if (found) {
+        body = render();
+        head = "HTTP/1.1 200 OK\r\n"
+               "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n";
+    } else {
+        body = "not found\n";
+        head = "HTTP/1.1 404 Not Found\r\n"
+               "Content-Type: text/plain\r\n";
+    }
+    head += "Content-Length: " + to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+
+    string response = head + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            break;
+        }
+        sent += n;
+    }
+}
@@ -0,0 +1,134 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_METRICS_H_9e14b6d2_5a07_4c83_b2f9_0d6e3a8c71f5
+#define RTP_METRICS_H_9e14b6d2_5a07_4c83_b2f9_0d6e3a8c71f5
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "stdinc.h"
+#include "rtp_jitter.h"
+
+
+
+/******************************************************************************
+*   Publishes the statistics of a fleet of RTPJitter buffers in OpenMetrics
+*   (Prometheus) text format from a small HTTP endpoint, by default on
+*   127.0.0.1:9464/metrics.
+*
+*   Buffers are registered per shard with add() and must be removed with
+*   remove() before they are destroyed.  Everything is aggregated per shard:
+*   counters are summed, and depth, jitter and residence time are reported as
+*   histograms across the shard's streams.  The counters of removed buffers
+*   are folded into the shard's totals so they never go backwards.
+*
+*   A scrape reads each buffer with RTPJitter::snapshot(), which takes no
+*   lock, on the exporter's own thread -- the media threads do no work for
+*   it.  The only contact is the per-shard registry mutex, which add() and
+*   remove() take when a flow comes or goes and a scrape holds only while it
+*   copies the shard's buffer list.  Counters use the buffers' lifetime
+*   counts, so RTPJitter::reset() does not send them backwards either.
+******************************************************************************/
+class RTPMetricsExporter
+{
+public:
+    static const uint16 DEFAULT_PORT = 9464;
+
+    RTPMetricsExporter(const unsigned shards, const uint16 port = DEFAULT_PORT,
+                       const std::string& address = "127.0.0.1");
+    ~RTPMetricsExporter();
+
+    bool    add(const unsigned shard, const RTPJitter *jitter);
+    void    remove(const unsigned shard, const RTPJitter *jitter);
+
+    bool    start();
+    void    stop();
+    bool    running() const             { return _running.load(); }
+    uint16  port() const                { return _port; }   // as bound, if 0 was asked for
+
+    // the current exposition, as served on /metrics
+    std::string render();
+
+private:
+    static const unsigned DEPTH_BUCKETS     = 10;
+    static const unsigned JITTER_BUCKETS    = 9;
+    static const unsigned RESIDENCE_BUCKETS = 12;
+
+    // per-stream distributions of a gauge, rebuilt every scrape
+    template<unsigned N>
+    struct histogram {
+        uint64  buckets[N + 1];         // last one is +Inf
+        uint64  count;
+        double  sum;
+    };
+
+    // monotonic values; for removed buffers these carry on in 'retired'
+    struct totals {
+        uint64  overflows;
+        uint64  out_of_order;
+        uint64  empty;
+        uint64  dropped;
+        uint64  bad_packets;
+        uint64  residence[RESIDENCE_BUCKETS + 1];
+        uint64  residence_count;
+        double  residence_sum;          // seconds
+    };
+
+    struct shard {
+        std::mutex                          mutex;
+        std::unordered_set<const RTPJitter *> buffers;
+        totals                              retired;
+        unsigned                            readers;    // scrapes reading the buffers
+        std::condition_variable             idle;       // readers went to 0
+    };
+
+    std::vector<std::unique_ptr<shard>> _shards;
+    std::string                         _address;
+    uint16                              _port;
+    int                                 _socket;
+    std::thread                         _thread;
+    std::atomic<bool>                   _running;
+
+    static const double DEPTH_LE[DEPTH_BUCKETS];
+    static const double JITTER_LE[JITTER_BUCKETS];
+    static const double RESIDENCE_LE[RESIDENCE_BUCKETS];
+
+    static void _accumulate(totals& t, const RTPJitter& jitter, const RTPJitter::statistics& s);
+    template<unsigned N>
+    static void _observe(histogram<N>& h, const double (&le)[N], const double value);
+    template<unsigned N>
+    static void _write_histogram(std::string& out, const char *name, const unsigned shard,
+                                 const double (&le)[N], const uint64 *buckets,
+                                 const uint64 count, const double sum);
+    void        _serve();
+    void        _respond(const int client);
+};
+
+#endif  // RTP_METRICS_H_9e14b6d2_5a07_4c83_b2f9_0d6e3a8c71f5
@@ -0,0 +1,407 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   N-minus-own conference mixing over RTPJitter buffers.
+*
+******************************************************************************/
+
+#include <algorithm>
+#include "rtp_mixer.h"
+#include "rtp_codec.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RTP_MIXER_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+namespace {
+
+// - each kernel does as many samples as it has whole vectors for and
+//  returns how many; the scalar loops below finish the frame
+#ifdef RTP_MIXER_X86
+
+__attribute__((target("sse4.1")))
+unsigned accumulate_sse41(const int16 *in, int32 *sum, const unsigned n)
+{
+    unsigned i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i lo = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(sum + i)), _mm_cvtepi16_epi32(x));
+        __m128i hi = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(sum + i + 4)),
+                                   _mm_cvtepi16_epi32(_mm_srli_si128(x, 8)));
+        _mm_storeu_si128((__m128i *)(sum + i), lo);
+        _mm_storeu_si128((__m128i *)(sum + i + 4), hi);
+    }
+    return i;
+}
+
+// out = saturate(sum - own), or saturate(sum) without 'own'
+__attribute__((target("sse4.1")))
+unsigned subtract_sse41(const int32 *sum, const int16 *own, int16 *out, const unsigned n)
+{
+    unsigned i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(sum + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(sum + i + 4));
+        if (own) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(own + i));
+            lo = _mm_sub_epi32(lo, _mm_cvtepi16_epi32(x));
+            hi = _mm_sub_epi32(hi, _mm_cvtepi16_epi32(_mm_srli_si128(x, 8)));
+        }
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(lo, hi));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+unsigned accumulate_avx2(const int16 *in, int32 *sum, const unsigned n)
+{
+    unsigned i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i lo = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(sum + i)),
+                                      _mm256_cvtepi16_epi32(_mm256_castsi256_si128(x)));
+        __m256i hi = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(sum + i + 8)),
+                                      _mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1)));
+        _mm256_storeu_si256((__m256i *)(sum + i), lo);
+        _mm256_storeu_si256((__m256i *)(sum + i + 8), hi);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+unsigned subtract_avx2(const int32 *sum, const int16 *own, int16 *out, const unsigned n)
+{
+    unsigned i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(sum + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(sum + i + 8));
+        if (own) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(own + i));
+            lo = _mm256_sub_epi32(lo, _mm256_cvtepi16_epi32(_mm256_castsi256_si128(x)));
+            hi = _mm256_sub_epi32(hi, _mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1)));
+        }
+        // packs works within 128 bit lanes; put the quarters back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+        _mm256_storeu_si256((__m256i *)(out + i), packed);
+    }
+    return i;
+}
+
+#endif  // RTP_MIXER_X86
+
+
+inline int16 saturate(const int32 x)
+{
+    return (int16)((x > INT16_MAX) ? INT16_MAX : ((x < INT16_MIN) ? INT16_MIN : x));
+}
+
+void accumulate(const int16 *in, int32 *sum, const unsigned n, const RTPMixer::kernel k)
+{
+    unsigned i = 0;
+
+    switch (k) {
+#ifdef RTP_MIXER_X86
+    case RTPMixer::KERNEL_AVX2:     i = accumulate_avx2(in, sum, n);     break;
+    case RTPMixer::KERNEL_SSE41:    i = accumulate_sse41(in, sum, n);    break;
+#endif
+    default:                        break;
+    }
+    for (; i < n; ++i) {
+        sum[i] += in[i];
+    }
+}
+
+void subtract(const int32 *sum, const int16 *own, int16 *out, const unsigned n, const RTPMixer::kernel k)
+{
+    unsigned i = 0;
+
+    switch (k) {
+#ifdef RTP_MIXER_X86
+    case RTPMixer::KERNEL_AVX2:     i = subtract_avx2(sum, own, out, n);    break;
+    case RTPMixer::KERNEL_SSE41:    i = subtract_sse41(sum, own, out, n);   break;
+#endif
+    default:                        break;
+    }
+    for (; i < n; ++i) {
+        out[i] = saturate(own ? (sum[i] - own[i]) : sum[i]);
+    }
+}
+
+}   // namespace
+
+
+
+RTPMixer::RTPMixer(const unsigned frame_samples /* = 160 */, const kernel k /* = KERNEL_AUTO */)
+    : _frame(frame_samples ? frame_samples : 1),
+      _kernel((k == KERNEL_AUTO) ? best() : k),
+      _next_id(1),
+      _sum(_frame, 0),
+      _everyone(_frame, 0)
+{
+}
+
+
+
+/******************************************************************************
+*   Adds a participant; their buffer must outlive their membership.
+*
+*   Returns the participant's id
+******************************************************************************/
+RTPMixer::participant_id RTPMixer::add(RTPJitter *jitter)
+{
+    participant p;
+
+    p.id = _next_id++;
+    p.jitter = jitter;
+    p.result = RTPJitter::BUFFERING;
+    p.losses = MAX_CONCEAL;
+
+    _index[p.id] = (unsigned)_participants.size();
+    _participants.push_back(p);
+    _pcm.resize(_participants.size() * _frame, 0);
+    _out.resize(_participants.size() * _frame, 0);
+    _talking.push_back(0);
+    return p.id;
+}
+
+
+
+/******************************************************************************
+*   Removes a participant, moving the last one into their place.
+*
+*   Returns none
+******************************************************************************/
+void RTPMixer::remove(const participant_id id)
+{
+    auto it = _index.find(id);
+    if (it == _index.end()) {
+        return;
+    }
+
+    unsigned i = it->second;
+    unsigned last = (unsigned)_participants.size() - 1;
+    _index.erase(it);
+
+    if (i != last) {
+        _participants[i] = move(_participants[last]);
+        _talking[i] = _talking[last];
+        copy_n(_pcm.begin() + last * _frame, _frame, _pcm.begin() + i * _frame);
+        copy_n(_out.begin() + last * _frame, _frame, _out.begin() + i * _frame);
+        _index[_participants[i].id] = i;
+    }
+    _participants.pop_back();
+    _talking.pop_back();
+    _pcm.resize(last * _frame);
+    _out.resize(last * _frame);
+}
+
+
+
+/******************************************************************************
+*   Pops one frame from every participant and mixes.
+*
+*   Returns the number of participants that contributed audio
+******************************************************************************/
+unsigned RTPMixer::mix()
+{
+    return mix(stdclock::now());
+}
+
+unsigned RTPMixer::mix(const timepoint now)
+{
+    unsigned talkers = 0;
+
+    for (unsigned i = 0; i < _participants.size(); ++i) {
+        _talking[i] = _fill(_participants[i], &_pcm[i * _frame], now) ? 1 : 0;
+        talkers += _talking[i];
+    }
+
+    mix_minus(_pcm.data(), _talking.data(), (unsigned)_participants.size(), _frame,
+              _sum.data(), _out.data(), _everyone.data(), _kernel);
+    return talkers;
+}
+
+
+
+/******************************************************************************
+*   Puts a participant's frame for this mix() in 'pcm': whatever was left
+*   over from the last one, then as many packets as it takes to make up
+*   _frame samples.  The rest of the last packet waits for the next mix().
+*
+*   Returns true if they have anything to be heard
+******************************************************************************/
+bool RTPMixer::_fill(participant& p, int16 *pcm, const timepoint now)
+{
+    while (p.pending.size() < _frame) {
+        rawrtp_ptr packet;
+
+        p.result = p.jitter->pop(packet, now);
+        if (!_decode(p, p.result, packet)) {
+            break;
+        }
+    }
+    if (p.pending.empty()) {
+        return false;
+    }
+
+    unsigned n = (unsigned)min<size_t>(_frame, p.pending.size());
+    copy_n(p.pending.begin(), n, pcm);
+    fill(pcm + n, pcm + _frame, (int16)0);
+    p.pending.erase(p.pending.begin(), p.pending.begin() + n);
+    return true;
+}
+
+
+
+/******************************************************************************
+*   Adds what one pop gave a participant to their pending samples: the
+*   decoded packet, or their last one at half the level for a loss.
+*
+*   Returns true if anything was added
+******************************************************************************/
+bool RTPMixer::_decode(participant& p, const RTPJitter::RESULT rc, const rawrtp_ptr& packet)
+{
+    switch (rc) {
+    case RTPJitter::SUCCESS:
+        {
+            unsigned n = 0;
+            if (packet) {
+                // G.711 is a byte a sample
+                p.last.resize(rtp_payload_length(packet->pData, packet->nLen));
+                n = RTPG711::decode(*packet, p.last.data(), (unsigned)p.last.size());
+            }
+            if (n == 0) {
+                p.losses = MAX_CONCEAL;         // nothing to conceal with
+                return false;
+            }
+            p.last.resize(n);
+            p.losses = 0;
+            break;
+        }
+
+    case RTPJitter::DROPPED_PACKET:
+        if (p.losses >= MAX_CONCEAL) {
+            return false;
+        }
+        ++p.losses;
+        for (int16& sample : p.last) {
+            sample = (int16)(sample >> 1);
+        }
+        break;
+
+    default:
+        p.losses = MAX_CONCEAL;
+        return false;
+    }
+
+    p.pending.insert(p.pending.end(), p.last.begin(), p.last.end());
+    return true;
+}
+
+
+
+/******************************************************************************
+*   Returns the frame 'id' hears as of the last mix(), nullptr if there is no
+*   such participant
+******************************************************************************/
+const int16 *RTPMixer::output(const participant_id id) const
+{
+    auto it = _index.find(id);
+    if (it == _index.end()) {
+        return nullptr;
+    }
+    return _talking[it->second] ? &_out[it->second * _frame] : _everyone.data();
+}
+
+RTPJitter::RESULT RTPMixer::result(const participant_id id) const
+{
+    auto it = _index.find(id);
+    return (it == _index.end()) ? RTPJitter::BUFFER_EMPTY : _participants[it->second].result;
+}
+
+
+
+/******************************************************************************
+*   Sums the talkers' frames in 32 bits, then writes each talker's sum less
+*   their own frame, and the whole sum, saturated to 16 bits.
+*
+*   Returns none
+******************************************************************************/
+void RTPMixer::mix_minus(const int16 *in, const uint8 *talking, const unsigned count, const unsigned frame,
+                         int32 *sum, int16 *out, int16 *everyone, const kernel k /* = KERNEL_AUTO */)
+{
+    kernel use = (k == KERNEL_AUTO) ? best() : k;
+
+    fill(sum, sum + frame, 0);
+    for (unsigned i = 0; i < count; ++i) {
+        if (talking[i]) {
+            accumulate(in + i * frame, sum, frame, use);
+        }
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        if (talking[i]) {
+            subtract(sum, in + i * frame, out + i * frame, frame, use);
+        }
+    }
+    subtract(sum, nullptr, everyone, frame, use);
+}
+
+
+
+/******************************************************************************
+*   The fastest kernel this CPU supports, checked once.
+*
+*   Returns kernel
+******************************************************************************/
+RTPMixer::kernel RTPMixer::best()
+{
+#ifdef RTP_MIXER_X86
+    __builtin_cpu_init();
+    static const kernel chosen = __builtin_cpu_supports("avx2")   ? KERNEL_AVX2
+                               : __builtin_cpu_supports("sse4.1") ? KERNEL_SSE41
+                               : KERNEL_SCALAR;
+    return chosen;
+#else
+    return KERNEL_SCALAR;
+#endif
+}
+
+const char *RTPMixer::name(const kernel k)
+{
+    switch (k) {
+    case KERNEL_SCALAR: return "scalar";
+    case KERNEL_SSE41:  return "sse4.1";
+    case KERNEL_AVX2:   return "avx2";
+    default:            return name(best());
+    }
+}
@@ -0,0 +1,129 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_MIXER_H_6c2e91d4_3b7a_4f85_a0d6_9e1b54c7f283
+#define RTP_MIXER_H_6c2e91d4_3b7a_4f85_a0d6_9e1b54c7f283
+
+#include <unordered_map>
+#include <vector>
+#include "stdinc.h"
+#include "rtp_jitter.h"
+#include "rtp_g711.h"
+
+
+
+/******************************************************************************
+*   Conference mixer over a set of RTPJitter buffers.  Each mix() takes one
+*   frame of frame_samples from every participant and gives each of them the
+*   sum of everyone else (an N-minus-own mix), saturated to 16 bits.  Packets
+*   are popped and decoded to 16 bit PCM as the frame needs them, and what is
+*   left of the last one is kept for the next mix(), so a participant's ptime
+*   need not match the frame: 30 ms packets feed a 20 ms mix one and a half
+*   at a time.
+*
+*   The sum is taken once, in 32 bits, over the participants that actually
+*   produced audio; each talker's mix is then that sum less their own frame.
+*   Participants with nothing to say all hear the same mix, so the work per
+*   frame grows with the number of talkers, not the size of the conference.
+*
+*   A DROPPED_PACKET replays the participant's last packet at half the level
+*   for each loss in a row, up to MAX_CONCEAL packets, then goes silent.
+*   BUFFERING participants, and payloads that are not G.711, are silence; a
+*   frame they cut short is padded with it.
+*
+*   Like the shards of RTPIngest, a mixer belongs to one thread: add(),
+*   remove(), mix() and output() must not be called concurrently.
+******************************************************************************/
+class RTPMixer
+{
+public:
+    typedef uint64  participant_id;
+
+    enum kernel
+    {
+        KERNEL_AUTO = 0,            // the best this CPU runs
+        KERNEL_SCALAR,
+        KERNEL_SSE41,
+        KERNEL_AVX2
+    };
+
+    static const unsigned MAX_CONCEAL = 3;
+
+    RTPMixer(const unsigned frame_samples = 160, const kernel k = KERNEL_AUTO);
+
+    participant_id  add(RTPJitter *jitter);
+    void            remove(const participant_id id);
+    unsigned        participants() const            { return (unsigned)_participants.size(); }
+    unsigned        frame_samples() const           { return _frame; }
+
+    // - pops and mixes one frame for everybody; returns the number of
+    //  participants that contributed audio
+    unsigned        mix();
+    unsigned        mix(const timepoint now);
+
+    // - what 'id' hears, and what their buffer said to the last pop, as of
+    //  the last mix(); the frame stays valid until the next mix(), add() or
+    //  remove()
+    const int16    *output(const participant_id id) const;
+    RTPJitter::RESULT   result(const participant_id id) const;
+
+    // the mixing kernel on its own: 'count' frames of 'frame' samples at
+    //  'in', of which those flagged in 'talking' are summed into 'sum'.
+    //  Each talker's N-minus-own frame goes to the same slot of 'out';
+    //  'everyone' gets the whole sum, for the rest.
+    static void mix_minus(const int16 *in, const uint8 *talking, const unsigned count, const unsigned frame,
+                          int32 *sum, int16 *out, int16 *everyone, const kernel k = KERNEL_AUTO);
+
+    static kernel       best();
+    static const char  *name(const kernel k);
+
+private:
+    struct participant
+    {
+        participant_id      id;
+        RTPJitter          *jitter;
+        RTPJitter::RESULT   result;
+        unsigned            losses;         // DROPPED_PACKETs in a row
+        std::vector<int16>  last;           // the last packet decoded, for concealment
+        std::vector<int16>  pending;        // decoded samples not mixed yet
+    };
+
+    unsigned                    _frame;
+    kernel                      _kernel;
+    participant_id              _next_id;
+    std::vector<participant>    _participants;
+    std::unordered_map<participant_id, unsigned> _index;
+
+    // - one frame per participant, in the order of _participants
+    std::vector<int16>          _pcm;
+    std::vector<int16>          _out;
+    std::vector<uint8>          _talking;
+    std::vector<int32>          _sum;
+    std::vector<int16>          _everyone;
+
+    bool    _fill(participant& p, int16 *pcm, const timepoint now);
+    bool    _decode(participant& p, const RTPJitter::RESULT rc, const rawrtp_ptr& packet);
+};
+
+#endif  // RTP_MIXER_H_6c2e91d4_3b7a_4f85_a0d6_9e1b54c7f283
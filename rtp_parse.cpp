@@ -0,0 +1,305 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   batch parsing of RTP fixed headers.
+*
+******************************************************************************/
+
+#include "rtp_parse.h"
+#include <cstring>
+#include <arpa/inet.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RTP_PARSE_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+namespace {
+
+// stands in for packets too short to hold a fixed header, so the kernels
+//  can always read 12 bytes; version 0 makes it invalid
+const uint8 NO_HEADER[RTP_HEADER_LENGTH] = { 0 };
+
+inline const uint8 *header_at(const uint8 *const *data, const uint32 *lengths, const unsigned i)
+{
+    return ((data[i] != nullptr) && (lengths[i] >= RTP_HEADER_LENGTH)) ? data[i] : NO_HEADER;
+}
+
+
+/******************************************************************************
+*   One header at a time, for CPUs without the vector kernels and for the
+*   packets left over after them.
+*
+*   Returns none
+******************************************************************************/
+void parse_scalar(RTPHeaderBatch& out, const uint8 *const *data, const uint32 *lengths,
+                  const unsigned first, const unsigned count)
+{
+    for (unsigned i = first; i < count; ++i) {
+        const uint8 *h = header_at(data, lengths, i);
+        uint32      timestamp, ssrc;
+        uint16      sequence;
+
+        memcpy(&sequence, h + 2, sizeof(sequence));
+        memcpy(&timestamp, h + 4, sizeof(timestamp));
+        memcpy(&ssrc, h + 8, sizeof(ssrc));
+
+        uint8 csrcs = h[0] & 0x0f;
+
+        out.sequence[i] = ntohs(sequence);
+        out.timestamp[i] = ntohl(timestamp);
+        out.ssrc[i] = ntohl(ssrc);
+        out.csrc_count[i] = csrcs;
+        out.payload_type[i] = h[1] & 0x7f;
+        out.marker[i] = h[1] >> 7;
+        out.valid[i] = ((h[0] >> 6) == RTP_VERSION)
+                    && (lengths[i] >= (uint32)(RTP_HEADER_LENGTH + 4 * csrcs));
+    }
+}
+
+
+#ifdef RTP_PARSE_X86
+
+// per header: the timestamp and SSRC byte swapped into dwords 0 and 1, the
+//  sequence number swapped into the low half of dword 2 with the first two
+//  header bytes (V/P/X/CC, M/PT) above it, and zeros in dword 3
+#define HEADER_SHUFFLE      7, 6, 5, 4,  11, 10, 9, 8,  3, 2, 0, 1,  -1, -1, -1, -1
+
+__attribute__((target("sse4.1")))
+inline __m128i load_header(const uint8 *h)
+{
+    int32 high;
+
+    memcpy(&high, h + 8, sizeof(high));
+    return _mm_insert_epi32(_mm_loadl_epi64((const __m128i *)h), high, 2);
+}
+
+
+/******************************************************************************
+*   Four headers per step: shuffle each into place, transpose so that each
+*   register holds one field of all four, then split out the bit fields.
+*
+*   Returns the number of headers done (a multiple of 4)
+******************************************************************************/
+__attribute__((target("sse4.1")))
+unsigned parse_sse41(RTPHeaderBatch& out, const uint8 *const *data, const uint32 *lengths, const unsigned count)
+{
+    const __m128i shuffle = _mm_setr_epi8(HEADER_SHUFFLE);
+    const __m128i low16 = _mm_set1_epi32(0xffff);
+    const __m128i version = _mm_set1_epi32(RTP_VERSION);
+    const __m128i minimum = _mm_set1_epi32(RTP_HEADER_LENGTH);
+    const __m128i one = _mm_set1_epi32(1);
+    unsigned i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i r0 = _mm_shuffle_epi8(load_header(header_at(data, lengths, i + 0)), shuffle);
+        __m128i r1 = _mm_shuffle_epi8(load_header(header_at(data, lengths, i + 1)), shuffle);
+        __m128i r2 = _mm_shuffle_epi8(load_header(header_at(data, lengths, i + 2)), shuffle);
+        __m128i r3 = _mm_shuffle_epi8(load_header(header_at(data, lengths, i + 3)), shuffle);
+
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);        // ts0 ts1 ssrc0 ssrc1
+        __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+        __m128i t2 = _mm_unpackhi_epi32(r0, r1);        // x0 x1 0 0
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+        _mm_storeu_si128((__m128i *)&out.timestamp[i], _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *)&out.ssrc[i], _mm_unpackhi_epi64(t0, t1));
+
+        __m128i x = _mm_unpacklo_epi64(t2, t3);
+        __m128i seq = _mm_and_si128(x, low16);
+        _mm_storel_epi64((__m128i *)&out.sequence[i], _mm_packus_epi32(seq, seq));
+
+        __m128i f = _mm_srli_epi32(x, 16);              // byte 0 | byte 1 << 8
+        __m128i cc = _mm_and_si128(f, _mm_set1_epi32(0x0f));
+        __m128i pt = _mm_and_si128(_mm_srli_epi32(f, 8), _mm_set1_epi32(0x7f));
+        __m128i m = _mm_and_si128(_mm_srli_epi32(f, 15), one);
+        __m128i v = _mm_and_si128(_mm_srli_epi32(f, 6), _mm_set1_epi32(3));
+
+        __m128i len = _mm_loadu_si128((const __m128i *)&lengths[i]);
+        __m128i need = _mm_add_epi32(minimum, _mm_slli_epi32(cc, 2));
+        // lengths are far below 2^31, so the signed compare is safe
+        __m128i ok = _mm_andnot_si128(_mm_cmpgt_epi32(need, len), _mm_cmpeq_epi32(v, version));
+        ok = _mm_and_si128(ok, one);
+
+        __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(cc, pt), _mm_packus_epi32(m, ok));
+        int32 word;
+        word = _mm_extract_epi32(bytes, 0);  memcpy(&out.csrc_count[i], &word, 4);
+        word = _mm_extract_epi32(bytes, 1);  memcpy(&out.payload_type[i], &word, 4);
+        word = _mm_extract_epi32(bytes, 2);  memcpy(&out.marker[i], &word, 4);
+        word = _mm_extract_epi32(bytes, 3);  memcpy(&out.valid[i], &word, 4);
+    }
+    return i;
+}
+
+
+/******************************************************************************
+*   Eight headers per step, as parse_sse41() with headers i..i+3 in the low
+*   lane and i+4..i+7 in the high lane.  The in-lane transpose then leaves
+*   each 32 bit field in order across the register.
+*
+*   Returns the number of headers done (a multiple of 8)
+******************************************************************************/
+__attribute__((target("avx2")))
+unsigned parse_avx2(RTPHeaderBatch& out, const uint8 *const *data, const uint32 *lengths, const unsigned count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(HEADER_SHUFFLE, HEADER_SHUFFLE);
+    const __m256i low16 = _mm256_set1_epi32(0xffff);
+    const __m256i version = _mm256_set1_epi32(RTP_VERSION);
+    const __m256i minimum = _mm256_set1_epi32(RTP_HEADER_LENGTH);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i interleave = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    unsigned i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i r[4];
+        for (unsigned k = 0; k < 4; ++k) {
+            __m256i pair = _mm256_inserti128_si256(
+                               _mm256_castsi128_si256(load_header(header_at(data, lengths, i + k))),
+                               load_header(header_at(data, lengths, i + 4 + k)), 1);
+            r[k] = _mm256_shuffle_epi8(pair, shuffle);
+        }
+
+        __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+        __m256i t1 = _mm256_unpacklo_epi32(r[2], r[3]);
+        __m256i t2 = _mm256_unpackhi_epi32(r[0], r[1]);
+        __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+
+        _mm256_storeu_si256((__m256i *)&out.timestamp[i], _mm256_unpacklo_epi64(t0, t1));
+        _mm256_storeu_si256((__m256i *)&out.ssrc[i], _mm256_unpackhi_epi64(t0, t1));
+
+        __m256i x = _mm256_unpacklo_epi64(t2, t3);
+        __m256i seq = _mm256_packus_epi32(_mm256_and_si256(x, low16), _mm256_setzero_si256());
+        seq = _mm256_permute4x64_epi64(seq, 0x08);      // qwords 0 and 2 to the bottom
+        _mm_storeu_si128((__m128i *)&out.sequence[i], _mm256_castsi256_si128(seq));
+
+        __m256i f = _mm256_srli_epi32(x, 16);
+        __m256i cc = _mm256_and_si256(f, _mm256_set1_epi32(0x0f));
+        __m256i pt = _mm256_and_si256(_mm256_srli_epi32(f, 8), _mm256_set1_epi32(0x7f));
+        __m256i m = _mm256_and_si256(_mm256_srli_epi32(f, 15), one);
+        __m256i v = _mm256_and_si256(_mm256_srli_epi32(f, 6), _mm256_set1_epi32(3));
+
+        __m256i len = _mm256_loadu_si256((const __m256i *)&lengths[i]);
+        __m256i need = _mm256_add_epi32(minimum, _mm256_slli_epi32(cc, 2));
+        __m256i ok = _mm256_andnot_si256(_mm256_cmpgt_epi32(need, len), _mm256_cmpeq_epi32(v, version));
+        ok = _mm256_and_si256(ok, one);
+
+        // per lane: cc x4, pt x4, m x4, ok x4; interleave the lanes' dwords
+        //  so each field's 8 bytes are together
+        __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(cc, pt), _mm256_packus_epi32(m, ok));
+        bytes = _mm256_permutevar8x32_epi32(bytes, interleave);
+
+        int64 quad;
+        quad = _mm256_extract_epi64(bytes, 0);  memcpy(&out.csrc_count[i], &quad, 8);
+        quad = _mm256_extract_epi64(bytes, 1);  memcpy(&out.payload_type[i], &quad, 8);
+        quad = _mm256_extract_epi64(bytes, 2);  memcpy(&out.marker[i], &quad, 8);
+        quad = _mm256_extract_epi64(bytes, 3);  memcpy(&out.valid[i], &quad, 8);
+    }
+    return i;
+}
+
+#endif  // RTP_PARSE_X86
+
+}   // namespace
+
+
+
+/******************************************************************************
+*   Parses the headers of up to MAX packets with the given kernel.
+*
+*   Returns the number of packets parsed
+******************************************************************************/
+unsigned RTPHeaderBatch::parse(const uint8 *const *data, const uint32 *lengths, const unsigned n, const kernel k /* = KERNEL_AUTO */)
+{
+    unsigned done = 0;
+
+    count = (n < MAX) ? n : MAX;
+    switch ((k == KERNEL_AUTO) ? best() : k) {
+#ifdef RTP_PARSE_X86
+    case KERNEL_AVX2:
+        done = parse_avx2(*this, data, lengths, count);
+        break;
+    case KERNEL_SSE41:
+        done = parse_sse41(*this, data, lengths, count);
+        break;
+#endif
+    default:
+        break;
+    }
+    parse_scalar(*this, data, lengths, done, count);
+    return count;
+}
+
+
+
+/******************************************************************************
+*   As above, for packets.
+*
+*   Returns the number of packets parsed
+******************************************************************************/
+unsigned RTPHeaderBatch::parse(const rawrtp_ptr *packets, const unsigned n, const kernel k /* = KERNEL_AUTO */)
+{
+    const uint8    *data[MAX];
+    uint32          lengths[MAX];
+    unsigned        m = (n < MAX) ? n : MAX;
+
+    for (unsigned i = 0; i < m; ++i) {
+        const RTPPacket *p = packets[i].get();
+        data[i] = (p != nullptr) ? p->pData : nullptr;
+        lengths[i] = (p != nullptr) ? p->nLen : 0;
+    }
+    return parse(data, lengths, m, k);
+}
+
+
+
+/******************************************************************************
+*   The fastest kernel this CPU supports, checked once.
+*
+*   Returns kernel
+******************************************************************************/
+RTPHeaderBatch::kernel RTPHeaderBatch::best()
+{
+#ifdef RTP_PARSE_X86
+    __builtin_cpu_init();
+    static const kernel chosen = __builtin_cpu_supports("avx2")   ? KERNEL_AVX2
+                               : __builtin_cpu_supports("sse4.1") ? KERNEL_SSE41
+                               : KERNEL_SCALAR;
+    return chosen;
+#else
+    return KERNEL_SCALAR;
+#endif
+}
+
+const char *RTPHeaderBatch::name(const kernel k)
+{
+    switch (k) {
+    case KERNEL_SCALAR: return "scalar";
+    case KERNEL_SSE41:  return "sse4.1";
+    case KERNEL_AVX2:   return "avx2";
+    default:            return name(best());
+    }
+}
@@ -0,0 +1,75 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_PARSE_H_93d0c4f1_5a2e_47b8_bc63_28e1f7a04d96
+#define RTP_PARSE_H_93d0c4f1_5a2e_47b8_bc63_28e1f7a04d96
+
+#include "stdinc.h"
+#include "rtp.h"
+
+
+
+/******************************************************************************
+*   The fixed headers of up to MAX packets, parsed and validated together and
+*   laid out field by field (structure of arrays) in host byte order.  A
+*   header is valid if it says version 2 and the packet is long enough to
+*   hold it and its CSRC list; the other fields of an invalid entry are
+*   unspecified.
+*
+*   The work is done by one of several kernels, picked by the CPU at first
+*   use: AVX2 does 8 headers per step and SSE4.1 does 4, both byte swapping
+*   and extracting with shuffles; anything else, and the tail of each batch,
+*   goes through the scalar loop.  They all give the same answers.
+******************************************************************************/
+struct RTPHeaderBatch
+{
+    enum kernel
+    {
+        KERNEL_AUTO = 0,            // the best this CPU runs
+        KERNEL_SCALAR,
+        KERNEL_SSE41,
+        KERNEL_AVX2
+    };
+
+    static const unsigned MAX = 64;
+
+    unsigned    count;
+    uint32      timestamp[MAX];
+    uint32      ssrc[MAX];
+    uint16      sequence[MAX];
+    uint8       payload_type[MAX];
+    uint8       marker[MAX];
+    uint8       csrc_count[MAX];
+    uint8       valid[MAX];
+
+    // parses the first min(count, MAX) packets; null packets are invalid.
+    //  Returns the number parsed.
+    unsigned    parse(const rawrtp_ptr *packets, const unsigned count, const kernel k = KERNEL_AUTO);
+    unsigned    parse(const uint8 *const *data, const uint32 *lengths, const unsigned count, const kernel k = KERNEL_AUTO);
+
+    static kernel       best();
+    static const char  *name(const kernel k);
+};
+
+#endif  // RTP_PARSE_H_93d0c4f1_5a2e_47b8_bc63_28e1f7a04d96
@@ -0,0 +1,677 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   timer-driven playout scheduler for RTPJitter instances.
+*
+*   See rtp_playout.h for the scheduling model.
+*
+******************************************************************************/
+
+#include "rtp_playout.h"
+#include "rtp_log.h"
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+/******************************************************************************
+*   Upper bound of the bucket holding the p'th percentile (0.0 - 1.0).
+*
+*   Returns lateness in nanoseconds, 0 if nothing was recorded
+******************************************************************************/
+uint64 RTPPlayoutScheduler::lateness::percentile_ns(const double p) const
+{
+    uint64 target = (uint64)(p * ticks);
+    uint64 seen = 0;
+
+    for (unsigned i = 0; i < BUCKETS; ++i) {
+        seen += buckets[i];
+        if ((seen > target) || ((seen == ticks) && (seen > 0))) {
+            return (i == 0) ? 0 : (1ULL << i);
+        }
+    }
+    return max_ns;
+}
+
+
+
+RTPPlayoutScheduler::worker::worker()
+    : index(0), cpu(-1), timer_fd(-1), wake_fd(-1), removes_queued(0), removes_applied(0),
+      ticks(0), total_ns(0), max_ns(0)
+{
+    for (unsigned i = 0; i < lateness::BUCKETS; ++i) {
+        buckets[i] = 0;
+    }
+}
+
+
+
+/******************************************************************************
+*   Creates the workers and their timer/wake descriptors; threads are not
+*   started until start().  Worker n is pinned to first_cpu + n unless
+*   first_cpu is negative.
+*
+*   Returns n/a
+******************************************************************************/
+RTPPlayoutScheduler::RTPPlayoutScheduler(const unsigned workers /* = 1 */, const int first_cpu /* = -1 */)
+    : _running(false), _next_id(1)
+{
+    unsigned cpus = thread::hardware_concurrency();
+
+    for (unsigned i = 0; i < (workers ? workers : 1); ++i) {
+        unique_ptr<worker> w(new worker());
+        w->index = i;
+        w->cpu = (first_cpu >= 0) ? (int)((first_cpu + i) % (cpus ? cpus : 1)) : -1;
+        w->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        w->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if ((w->timer_fd < 0) || (w->wake_fd < 0)) {
+            LOGD("RTPPlayoutScheduler(): timerfd/eventfd failed: %d\n", errno);
+        }
+        _workers.push_back(move(w));
+    }
+}
+
+
+
+/******************************************************************************
+*   Stops the workers and releases their descriptors.
+*
+*   Returns n/a
+******************************************************************************/
+RTPPlayoutScheduler::~RTPPlayoutScheduler()
+{
+    stop();
+    for (auto& w : _workers) {
+        if (w->timer_fd >= 0) close(w->timer_fd);
+        if (w->wake_fd >= 0) close(w->wake_fd);
+        for (stream *s : w->pending_add) {
+            delete s;
+        }
+    }
+}
+
+
+
+/******************************************************************************
+*   Starts one thread per worker.
+*
+*   Returns true on success, false if the timer descriptors are unusable
+******************************************************************************/
+bool RTPPlayoutScheduler::start()
+{
+    if (_running.load()) {
+        return true;
+    }
+    for (auto& w : _workers) {
+        if ((w->timer_fd < 0) || (w->wake_fd < 0)) {
+            return false;
+        }
+    }
+
+    _running = true;
+    for (auto& w : _workers) {
+        scoped_lock lock(w->mutex);
+        w->thread = thread(&RTPPlayoutScheduler::_run, this, w.get());
+        w->thread_id = w->thread.get_id();
+    }
+    return true;
+}
+
+
+
+/******************************************************************************
+*   Wakes every worker, tells it to exit, and waits for it.
+*
+*   Returns none
+******************************************************************************/
+void RTPPlayoutScheduler::stop()
+{
+    if (!_running.exchange(false)) {
+        return;
+    }
+    for (auto& w : _workers) {
+        _wake(w.get());
+    }
+    for (auto& w : _workers) {
+        if (w->thread.joinable()) {
+            w->thread.join();
+        }
+        // a remove() may be waiting for a worker that has now gone
+        {
+            scoped_lock lock(w->mutex);
+            w->thread_id = thread::id();
+        }
+        w->changed.notify_all();
+    }
+}
+
+
+
+/******************************************************************************
+*   Schedules pop() on the given buffer every ptime_ms, starting one ptime
+*   after the owning worker picks the stream up.  The buffer must outlive
+*   the stream, i.e. remove() it before destroying the buffer.
+*
+*   Returns id for use with remove()
+******************************************************************************/
+RTPPlayoutScheduler::stream_id RTPPlayoutScheduler::add(RTPJitter *jitter, const unsigned ptime_ms, pop_callback cb)
+{
+    stream *s = new stream();
+    s->id = _next_id.fetch_add(1);
+    s->jitter = jitter;
+    s->callback = cb;
+    s->period_ns = (int64)(ptime_ms ? ptime_ms : 20) * 1000000LL;
+    s->origin_ns = 0;
+    s->tick = 0;
+    s->removed = false;
+
+    worker *w = _workers[s->id % _workers.size()].get();
+    {
+        scoped_lock lock(w->mutex);
+        w->pending_add.push_back(s);
+    }
+    _wake(w);
+
+    return s->id;
+}
+
+
+
+/******************************************************************************
+*   Stops servicing the given stream.  From any thread other than the owning
+*   worker this blocks until the worker has let go of the stream, so the
+*   buffer may be destroyed as soon as it returns.  From inside a callback on
+*   the owning worker it takes effect before the next tick.
+*
+*   Returns none
+******************************************************************************/
+void RTPPlayoutScheduler::remove(const stream_id id)
+{
+    worker *w = _workers[id % _workers.size()].get();
+
+    unique_lock<mutex> lock(w->mutex);
+    w->pending_remove.push_back(id);
+    uint64 ticket = ++w->removes_queued;
+
+    if (!_running.load() || (this_thread::get_id() == w->thread_id)) {
+        // the worker thread isn't running, or it is us -- either way the
+        //  removal is applied before the stream is touched again.
+        if (this_thread::get_id() == w->thread_id) {
+            auto i = w->streams.find(id);
+            if (i != w->streams.end()) {
+                i->second->removed = true;
+            }
+        }
+        return;
+    }
+
+    // wait for the pass that takes our id off the list, not just any pass:
+    //  one that took the lists before we queued it may still finish after.
+    lock.unlock();
+    _wake(w);
+    lock.lock();
+    w->changed.wait(lock, [&]() { return (w->removes_applied >= ticket) || !_running.load(); });
+}
+
+
+
+/******************************************************************************
+*   Lateness of the given worker, or aggregated over all workers.
+******************************************************************************/
+RTPPlayoutScheduler::lateness RTPPlayoutScheduler::get_lateness(const unsigned n)
+{
+    lateness    l;
+    worker     *w = _workers[n].get();
+
+    l.ticks = w->ticks.load(memory_order_relaxed);
+    l.total_ns = w->total_ns.load(memory_order_relaxed);
+    l.max_ns = w->max_ns.load(memory_order_relaxed);
+    for (unsigned i = 0; i < lateness::BUCKETS; ++i) {
+        l.buckets[i] = w->buckets[i].load(memory_order_relaxed);
+    }
+    return l;
+}
+
+RTPPlayoutScheduler::lateness RTPPlayoutScheduler::get_lateness()
+{
+    lateness total;
+    memset(&total, 0, sizeof(total));
+
+    for (unsigned n = 0; n < _workers.size(); ++n) {
+        lateness l = get_lateness(n);
+        total.ticks += l.ticks;
+        total.total_ns += l.total_ns;
+        total.max_ns = max(total.max_ns, l.max_ns);
+        for (unsigned i = 0; i < lateness::BUCKETS; ++i) {
+            total.buckets[i] += l.buckets[i];
+        }
+    }
+    return total;
+}
+
+
+
+/******************************************************************************
+*   Worker loop: sleep until the earliest deadline (or a wake-up), service
+*   every stream that is due, re-arm.
+*
+*   Returns none
+******************************************************************************/
+void RTPPlayoutScheduler::_run(worker *w)
+{
+    RTPLog::attach_thread();
+
+    if (w->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    pollfd  fds[2];
+    fds[0].fd = w->timer_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = w->wake_fd;
+    fds[1].events = POLLIN;
+
+    _apply_pending(w);
+    _arm(w);
+
+    while (_running.load(memory_order_relaxed)) {
+        if (poll(fds, 2, -1) < 0) {
+            continue;
+        }
+
+        uint64 drain;
+        if (fds[0].revents & POLLIN) {
+            if (read(w->timer_fd, &drain, sizeof(drain)) < 0) {
+                // spurious -- the deadline check below sorts it out
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            if (read(w->wake_fd, &drain, sizeof(drain)) < 0) {
+                // already drained
+            }
+            _apply_pending(w);
+        }
+
+        int64   now = _now_ns();
+        bool    serviced = false;
+
+        while (!w->heap.empty() && (w->heap.front().deadline <= now)) {
+            pop_heap(w->heap.begin(), w->heap.end());
+            heap_entry due = w->heap.back();
+            w->heap.pop_back();
+
+            stream *s = due.s;
+            if (s->removed) {
+                continue;
+            }
+
+            _record_lateness(w, now - due.deadline);
+
+            rawrtp_ptr          packet;
+            RTPJitter::RESULT   rc = s->jitter->pop(packet);
+            s->callback(s->id, *s->jitter, rc, packet);
+            serviced = true;
+
+            s->tick++;
+            if (!s->removed) {
+                w->heap.push_back({ s->deadline(), s });
+                push_heap(w->heap.begin(), w->heap.end());
+            }
+        }
+
+        if (serviced && _on_tick) {
+            _on_tick(w->index);
+        }
+
+        // pick up removals made from inside the callbacks
+        _apply_pending(w);
+        _arm(w);
+    }
+}
+
+
+
+/******************************************************************************
+*   Moves streams handed over by add()/remove() into (or out of) the worker's
+*   schedule, and releases those waiting in remove() whose ids it took.  New streams get their
+*   first deadline one ptime from now.
+*
+*   Returns none
+******************************************************************************/
+void RTPPlayoutScheduler::_apply_pending(worker *w)
+{
+    vector<stream *>    added;
+    vector<stream_id>   removed;
+    uint64              ticket;
+
+    {
+        scoped_lock lock(w->mutex);
+        if (w->pending_add.empty() && w->pending_remove.empty()) {
+            return;
+        }
+        added.swap(w->pending_add);
+        removed.swap(w->pending_remove);
+        ticket = w->removes_queued;         // covers exactly what we just took
+    }
+
+    int64 now = _now_ns();
+    for (stream *s : added) {
+        s->origin_ns = now + s->period_ns;
+        w->streams[s->id].reset(s);
+        w->heap.push_back({ s->deadline(), s });
+        push_heap(w->heap.begin(), w->heap.end());
+    }
+
+    if (!removed.empty()) {
+        for (stream_id id : removed) {
+            auto i = w->streams.find(id);
+            if (i != w->streams.end()) {
+                i->second->removed = true;
+            }
+        }
+        // rebuild without the removed streams, then let them go
+        w->heap.erase(remove_if(w->heap.begin(), w->heap.end(),
+                                [](const heap_entry& e) { return e.s->removed; }),
+                      w->heap.end());
+        make_heap(w->heap.begin(), w->heap.end());
+        for (stream_id id : removed) {
+            w->streams.erase(id);
+        }
+    }
+
+    {
+        scoped_lock lock(w->mutex);
+        w->removes_applied = ticket;
+    }
+    w->changed.notify_all();
+}
+
+
+
+/******************************************************************************
+*   Arms the worker's timerfd for the earliest deadline (absolute), or
+*   disarms it when there is nothing scheduled.
+*
+*   Returns none
+******************************************************************************/
+void RTPPlayoutScheduler::_arm(worker *w)
+{
+    itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+
+    if (!w->heap.empty()) {
+        int64 deadline = w->heap.front().deadline;
+        spec.it_value.tv_sec = deadline / 1000000000LL;
+        spec.it_value.tv_nsec = deadline % 1000000000LL;
+        if ((spec.it_value.tv_sec == 0) && (spec.it_value.tv_nsec == 0)) {
+            spec.it_value.tv_nsec = 1;      // zero would disarm
+        }
+    }
+    timerfd_settime(w->timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+
+
+/******************************************************************************
+*   Adds one tick's lateness to the worker's statistics.  Only the worker
+*   writes these, so plain relaxed load/store is enough.
+*
+*   Returns none
+******************************************************************************/
+void RTPPlayoutScheduler::_record_lateness(worker *w, const int64 late_ns)
+{
+    uint64      late = (late_ns > 0) ? (uint64)late_ns : 0;
+    unsigned    bucket = late ? (64 - __builtin_clzll(late)) : 0;
+
+    if (bucket >= lateness::BUCKETS) {
+        bucket = lateness::BUCKETS - 1;
+    }
+
+    w->ticks.store(w->ticks.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    w->total_ns.store(w->total_ns.load(memory_order_relaxed) + late, memory_order_relaxed);
+    if (late > w->max_ns.load(memory_order_relaxed)) {
+        w->max_ns.store(late, memory_order_relaxed);
+    }
+    w->buckets[bucket].store(w->buckets[bucket].load(memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+
+
+/******************************************************************************
+*   Pokes a worker out of poll().
+*
+*   Returns none
+******************************************************************************/
+void RTPPlayoutScheduler::_wake(worker *w)
+{
+    uint64 one = 1;
+    if (write(w->wake_fd, &one, sizeof(one)) < 0) {
+        // counter saturated -- the worker is already due to wake
+    }
+}
+
+
+
+/******************************************************************************
+*   CLOCK_MONOTONIC in nanoseconds; the same clock stdclock runs on.
+******************************************************************************/
+int64 RTPPlayoutScheduler::_now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64)ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+
+
+RTPPlayoutWheel::RTPPlayoutWheel(const timepoint start /* = stdclock::now() */)
+    : _wheel(start),
+      _next_id(1),
+      _firing(nullptr),
+      _playing(0),
+      _pops(0)
+{
+}
+
+
+
+/******************************************************************************
+*   Adds a stream.  It starts idle, or waiting if its buffer already has
+*   packets.
+*
+*   Returns the stream's id
+******************************************************************************/
+RTPPlayoutWheel::stream_id RTPPlayoutWheel::add(RTPJitter *jitter, const unsigned ptime_ms, pop_callback cb)
+{
+    unique_ptr<stream> s(new stream());
+    stream *p = s.get();
+
+    s->id = _next_id++;
+    s->jitter = jitter;
+    s->callback = cb;
+    s->period = clocks::milliseconds(ptime_ms ? ptime_ms : 20);
+    s->st = IDLE;
+    s->removed = false;
+    s->timer.on_expiry = [this, p](RTPTimerWheel::timer&, const timepoint now) {
+        _expired(*p, now);
+    };
+
+    _streams[s->id] = move(s);
+    _arm(*p);
+    return p->id;
+}
+
+
+
+/******************************************************************************
+*   Stops playing the stream.  From its own callback this takes effect as the
+*   callback returns.
+*
+*   Returns none
+******************************************************************************/
+void RTPPlayoutWheel::remove(const stream_id id)
+{
+    auto i = _streams.find(id);
+    if (i == _streams.end()) {
+        return;
+    }
+
+    stream& s = *i->second;
+    if (&s == _firing) {
+        s.removed = true;
+        return;
+    }
+    if (s.st == PLAYING) {
+        --_playing;
+    }
+    _wheel.cancel(s.timer);
+    _streams.erase(i);
+}
+
+
+
+/******************************************************************************
+*   Tells the wheel a packet was pushed into the stream's buffer; O(1), and
+*   free while the stream is playing.  A burst can take a waiting stream to
+*   its nominal depth before its timer goes off, so that timer is brought
+*   forward when the buffer becomes playable sooner.
+*
+*   Returns none
+******************************************************************************/
+void RTPPlayoutWheel::pushed(const stream_id id)
+{
+    auto i = _streams.find(id);
+    if ((i != _streams.end()) && (i->second->st != PLAYING)) {
+        _arm(*i->second);
+    }
+}
+
+
+
+/******************************************************************************
+*   Runs every timer due by 'now'.
+*
+*   Returns number of pops made
+******************************************************************************/
+unsigned RTPPlayoutWheel::advance(const timepoint now)
+{
+    _pops = 0;
+    _wheel.advance(now);
+    _removed.clear();
+    return _pops;
+}
+
+
+
+/******************************************************************************
+*   Sets an idle stream's timer for when its buffer will stop buffering, if
+*   it holds anything that starts the buffering clock.  A waiting stream's
+*   timer is only ever moved earlier.
+*
+*   Returns none
+******************************************************************************/
+void RTPPlayoutWheel::_arm(stream& s)
+{
+    timepoint at = s.jitter->playable_at();
+    if (at == timepoint::max()) {
+        return;
+    }
+
+    at = max(at, _wheel.now());
+    if ((s.st == WAITING) && (at >= s.deadline)) {
+        return;
+    }
+
+    s.st = WAITING;
+    s.deadline = at;
+    _wheel.schedule(s.timer, at);
+}
+
+
+
+/******************************************************************************
+*   A stream's timer fired: either the buffering delay is over, or a ptime
+*   deadline has come.
+*
+*   Returns none
+******************************************************************************/
+void RTPPlayoutWheel::_expired(stream& s, const timepoint now)
+{
+    if (s.st == WAITING) {
+        // the buffer may have been reset, or played by someone else, since
+        timepoint at = s.jitter->playable_at();
+        if (at == timepoint::max()) {
+            s.st = IDLE;
+            return;
+        }
+        if (at > now) {
+            s.deadline = at;
+            _wheel.schedule(s.timer, at);
+            return;
+        }
+        s.st = PLAYING;
+        s.deadline = now;
+        ++_playing;
+    }
+
+    rawrtp_ptr packet;
+    RTPJitter::RESULT rc = s.jitter->pop(packet, now);
+    ++_pops;
+
+    _firing = &s;
+    s.callback(s.id, *s.jitter, rc, packet);
+    _firing = nullptr;
+
+    if (s.removed) {
+        // we are still inside the stream's own timer callback; let
+        //  advance() free it once the wheel is done with it
+        auto i = _streams.find(s.id);
+        if (s.st == PLAYING) {
+            --_playing;
+        }
+        _removed.push_back(move(i->second));
+        _streams.erase(i);
+        return;
+    }
+
+    if (rc == RTPJitter::BUFFERING) {
+        s.st = IDLE;
+        --_playing;
+        _arm(s);                        // packets may be waiting already
+    } else {
+        s.deadline += s.period;
+        _wheel.schedule(s.timer, s.deadline);
+    }
+}
@@ -0,0 +1,237 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_PLAYOUT_H_e2a7c4b9_1f58_4d36_8b0e_6a93d5c1f742
+#define RTP_PLAYOUT_H_e2a7c4b9_1f58_4d36_8b0e_6a93d5c1f742
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "stdinc.h"
+#include "rtp_jitter.h"
+#include "rtp_timer.h"
+
+
+
+/******************************************************************************
+*   Services many RTPJitter instances from a small pool of threads, calling
+*   pop() for each stream once per packet interval (ptime) and handing the
+*   result to a callback.
+*
+*   Deadlines are absolute: tick n of a stream is due at start + n * ptime,
+*   so a late wake-up never pushes later ticks back and there is no drift.
+*   Each worker sleeps on a timerfd armed with TFD_TIMER_ABSTIME for the
+*   earliest deadline among its streams.  If a worker falls more than one
+*   ptime behind, the missed ticks are run back to back to catch up.
+*
+*   Callbacks run on the worker thread that owns the stream and must not
+*   block.  The tick callback runs once per worker wake-up, after every due
+*   stream has been serviced -- a natural place to flush batched output.
+******************************************************************************/
+class RTPPlayoutScheduler
+{
+public:
+    typedef uint64  stream_id;
+
+    typedef std::function<void(stream_id id, RTPJitter& jitter, RTPJitter::RESULT rc, rawrtp_ptr& packet)> pop_callback;
+    typedef std::function<void(unsigned worker)> tick_callback;
+
+    // how late the workers woke up relative to their deadlines
+    struct lateness
+    {
+        static const unsigned BUCKETS = 32;     // bucket n counts lateness < 2^n ns
+
+        uint64  ticks;
+        uint64  total_ns;
+        uint64  max_ns;
+        uint64  buckets[BUCKETS];
+
+        uint64  mean_ns() const         { return ticks ? (total_ns / ticks) : 0; }
+        uint64  percentile_ns(const double p) const;
+    };
+
+    RTPPlayoutScheduler(const unsigned workers = 1, const int first_cpu = -1);
+    ~RTPPlayoutScheduler();
+
+    void        set_tick_callback(tick_callback cb)     { _on_tick = cb; }
+
+    bool        start();
+    void        stop();
+
+    stream_id   add(RTPJitter *jitter, const unsigned ptime_ms, pop_callback cb);
+    void        remove(const stream_id id);
+
+    unsigned    worker_count() const                    { return (unsigned)_workers.size(); }
+    lateness    get_lateness(const unsigned worker);
+    lateness    get_lateness();
+
+private:
+    struct stream
+    {
+        stream_id       id;
+        RTPJitter      *jitter;
+        pop_callback    callback;
+        int64           period_ns;
+        int64           origin_ns;          // deadline of tick 0
+        uint64          tick;               // next tick number
+        bool            removed;
+
+        int64 deadline() const          { return origin_ns + (int64)tick * period_ns; }
+    };
+
+    struct heap_entry
+    {
+        int64   deadline;
+        stream *s;
+
+        bool operator<(const heap_entry& other) const { return deadline > other.deadline; }
+    };
+
+    struct worker
+    {
+        unsigned                    index;
+        int                         cpu;
+        int                         timer_fd;
+        int                         wake_fd;
+        std::thread                 thread;
+        std::thread::id             thread_id;          // guarded by mutex
+
+        // - owned by the worker thread
+        std::vector<heap_entry>     heap;
+        std::unordered_map<stream_id, std::unique_ptr<stream>> streams;
+
+        // - handed over from other threads
+        std::mutex                  mutex;
+        std::condition_variable     changed;
+        std::vector<stream *>       pending_add;
+        std::vector<stream_id>      pending_remove;
+        uint64                      removes_queued;     // tickets handed out with pending_remove
+        uint64                      removes_applied;    // highest ticket the worker has let go of
+
+        // - lateness, written by the worker, read by anyone
+        std::atomic<uint64>         ticks;
+        std::atomic<uint64>         total_ns;
+        std::atomic<uint64>         max_ns;
+        std::atomic<uint64>         buckets[lateness::BUCKETS];
+
+        worker();
+    };
+
+    std::vector<std::unique_ptr<worker>>    _workers;
+    std::atomic<bool>                       _running;
+    std::atomic<stream_id>                  _next_id;
+    tick_callback                           _on_tick;
+
+    void        _run(worker *w);
+    void        _apply_pending(worker *w);
+    void        _arm(worker *w);
+    void        _record_lateness(worker *w, const int64 late_ns);
+    static void _wake(worker *w);
+    static int64 _now_ns();
+};
+
+
+
+
+/******************************************************************************
+*   Playout for very many streams on one thread, driven by an RTPTimerWheel
+*   instead of a tick for every stream.
+*
+*   A stream costs nothing while its buffer is buffering.  push() into the
+*   buffer and then call pushed(): if the stream was idle, that sets one
+*   timer for when the buffer's playable_at() says the buffering delay will
+*   be over.  When it fires the stream starts playing, and from then on a
+*   timer per ptime (absolute deadlines, as with RTPPlayoutScheduler) pops
+*   the buffer and hands the result to the callback.  The pop that finds the
+*   buffer buffering again is handed over too, and the stream goes idle
+*   until the next pushed().  So only buffers that have something to play
+*   are ever looked at.
+*
+*   Everything -- add(), remove(), pushed(), advance() and the callbacks --
+*   happens on the one thread that owns the wheel, e.g. an RTPIngest shard
+*   that pushes its flows and calls advance() from its shard callback.
+******************************************************************************/
+class RTPPlayoutWheel
+{
+public:
+    typedef uint64  stream_id;
+
+    typedef std::function<void(stream_id id, RTPJitter& jitter, RTPJitter::RESULT rc, rawrtp_ptr& packet)> pop_callback;
+
+    RTPPlayoutWheel(const timepoint start = stdclock::now());
+
+    stream_id   add(RTPJitter *jitter, const unsigned ptime_ms, pop_callback cb);
+    void        remove(const stream_id id);
+    void        pushed(const stream_id id);
+
+    // - fires whatever is due by 'now'; returns the number of pops made
+    unsigned    advance(const timepoint now);
+
+    size_t      streams() const                 { return _streams.size(); }
+    size_t      playing() const                 { return _playing; }
+    size_t      timers() const                  { return _wheel.pending(); }
+
+private:
+    enum state
+    {
+        IDLE = 0,                   // buffering; waits for pushed()
+        WAITING,                    // timer set for the end of the buffering delay
+        PLAYING                     // timer set for the next ptime deadline
+    };
+
+    struct stream
+    {
+        stream_id               id;
+        RTPJitter              *jitter;
+        pop_callback            callback;
+        clocks::nanoseconds     period;
+        timepoint               deadline;       // next pop, or end of the buffering delay
+        state                   st;
+        bool                    removed;
+        RTPTimerWheel::timer    timer;
+    };
+
+    RTPTimerWheel                                       _wheel;
+    std::unordered_map<stream_id, std::unique_ptr<stream>> _streams;
+    stream_id                                           _next_id;
+    stream                                             *_firing;        // whose callback is running
+    std::vector<std::unique_ptr<stream>>                _removed;       // from their own callbacks
+    size_t                                              _playing;
+    unsigned                                            _pops;
+
+    // - the stream timers' callbacks capture 'this'
+    RTPPlayoutWheel(const RTPPlayoutWheel&) = delete;
+    RTPPlayoutWheel(RTPPlayoutWheel&&) = delete;
+    RTPPlayoutWheel& operator=(const RTPPlayoutWheel&) = delete;
+    RTPPlayoutWheel& operator=(RTPPlayoutWheel&&) = delete;
+
+    void        _arm(stream& s);
+    void        _expired(stream& s, const timepoint now);
+};
+
+#endif  // RTP_PLAYOUT_H_e2a7c4b9_1f58_4d36_8b0e_6a93d5c1f742
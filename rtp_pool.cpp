@@ -0,0 +1,145 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   recycling pool of fixed size blocks for receive buffers.
+*
+******************************************************************************/
+
+#include "rtp_pool.h"
+#include "rtp_memory.h"
+
+using namespace std;
+
+
+/******************************************************************************
+*   Optionally pre-allocates 'prealloc' blocks so the first bursts of traffic
+*   don't hit the heap.  At most 'max_free' idle blocks are retained.
+*
+*   Returns n/a
+******************************************************************************/
+RTPBufferPool::RTPBufferPool(const size_t block_size, const size_t prealloc /* = 0 */, const size_t max_free /* = 1024 */)
+    : _state(make_shared<state>())
+{
+    _state->block_size = block_size;
+    _state->max_free = (max_free > prealloc) ? max_free : prealloc;
+    _state->outstanding = 0;
+    _state->free.reserve(_state->max_free);
+    for (size_t i = 0; i < prealloc; ++i) {
+        _state->free.push_back(new uint8[block_size]);
+    }
+    RTPMemory::add(RTPMemory::RESERVED, (int64)(prealloc * block_size));
+}
+
+
+
+/******************************************************************************
+*   Frees the idle blocks.  Outstanding blocks keep the shared state alive and
+*   are freed (rather than recycled) as they come home.
+*
+*   Returns n/a
+******************************************************************************/
+RTPBufferPool::~RTPBufferPool()
+{
+    scoped_lock lock(_state->mutex);
+
+    for (uint8 *block : _state->free) {
+        delete[] block;
+    }
+    RTPMemory::add(RTPMemory::RESERVED, -(int64)(_state->free.size() * _state->block_size));
+    _state->free.clear();
+    _state->max_free = 0;
+}
+
+
+
+/******************************************************************************
+*   Takes a block off the free list, or allocates a new one if the list is
+*   empty.
+*
+*   Returns shared pointer to a block of block_size() bytes
+******************************************************************************/
+shared_ptr<uint8> RTPBufferPool::acquire()
+{
+    uint8  *block = nullptr;
+
+    {
+        scoped_lock lock(_state->mutex);
+        if (!_state->free.empty()) {
+            block = _state->free.back();
+            _state->free.pop_back();
+        }
+        _state->outstanding++;
+    }
+    if (block == nullptr) {
+        block = new uint8[_state->block_size];
+    } else {
+        RTPMemory::add(RTPMemory::RESERVED, -(int64)_state->block_size);
+    }
+    RTPMemory::add(RTPMemory::BUFFER_POOLS, (int64)_state->block_size);
+
+    shared_ptr<state> s = _state;
+    return shared_ptr<uint8>(block, [s](uint8 *b) { RTPBufferPool::_release(s, b); });
+}
+
+
+
+/******************************************************************************
+*   Current pool occupancy, for diagnostics.
+******************************************************************************/
+size_t RTPBufferPool::free_blocks()
+{
+    scoped_lock lock(_state->mutex);
+    return _state->free.size();
+}
+
+size_t RTPBufferPool::outstanding_blocks()
+{
+    scoped_lock lock(_state->mutex);
+    return _state->outstanding;
+}
+
+
+
+/******************************************************************************
+*   Deleter for blocks handed out by acquire().  Puts the block back on the
+*   free list unless the list is full (or the pool has been destroyed).
+*
+*   Returns none
+******************************************************************************/
+void RTPBufferPool::_release(shared_ptr<state> s, uint8 *block)
+{
+    {
+        scoped_lock lock(s->mutex);
+        s->outstanding--;
+        if (s->free.size() < s->max_free) {
+            s->free.push_back(block);
+            block = nullptr;
+        }
+    }
+    RTPMemory::add(RTPMemory::BUFFER_POOLS, -(int64)s->block_size);
+    if (block == nullptr) {
+        RTPMemory::add(RTPMemory::RESERVED, (int64)s->block_size);
+    }
+    SAFE_DELETE_ARRAY(block);
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_POOL_H_8d3e6a14_27c9_4f0b_9a51_c4e07b2d6f38
+#define RTP_POOL_H_8d3e6a14_27c9_4f0b_9a51_c4e07b2d6f38
+
+#include <memory>
+#include <vector>
+#include "stdinc.h"
+
+
+
+/******************************************************************************
+*   Recycling pool of fixed size byte blocks.  Blocks are handed out as
+*   shared_ptrs whose deleter puts them back on the free list, so a block
+*   returns to the pool when the last RTPPacket viewing it is released --
+*   from whatever thread that happens on.
+*
+*   The pool's state is itself reference counted by every outstanding block,
+*   so blocks may safely outlive the RTPBufferPool object.
+*
+*   Blocks in use are counted in RTPMemory::BUFFER_POOLS, and those on the
+*   free list in RTPMemory::RESERVED.
+******************************************************************************/
+class RTPBufferPool
+{
+public:
+    RTPBufferPool(const size_t block_size, const size_t prealloc = 0, const size_t max_free = 1024);
+    ~RTPBufferPool();
+
+    std::shared_ptr<uint8>  acquire();
+
+    size_t  block_size() const          { return _state->block_size; }
+    size_t  free_blocks();
+    size_t  outstanding_blocks();
+
+private:
+    struct state {
+        std::mutex          mutex;
+        std::vector<uint8 *> free;
+        size_t              block_size;
+        size_t              max_free;
+        size_t              outstanding;
+    };
+    std::shared_ptr<state>  _state;
+
+    static void _release(std::shared_ptr<state> s, uint8 *block);
+};
+
+#endif  // RTP_POOL_H_8d3e6a14_27c9_4f0b_9a51_c4e07b2d6f38
@@ -0,0 +1,323 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   polyphase sample rate conversion.
+*
+******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "rtp_resample.h"
+#include "rtp_g711.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RTP_RESAMPLE_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+uint32 gcd(uint32 a, uint32 b)
+{
+    while (b) {
+        uint32 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+inline int16 round_q15(const int32 acc)
+{
+    int32 y = (acc + (1 << 14)) >> 15;
+    return (int16)((y > INT16_MAX) ? INT16_MAX : ((y < INT16_MIN) ? INT16_MIN : y));
+}
+
+// - one output sample: 'taps' (a multiple of 16) Q15 coefficients against
+//  as many input samples
+int32 dot_scalar(const int16 *x, const int16 *h, const unsigned taps)
+{
+    int32 acc = 0;
+
+    for (unsigned i = 0; i < taps; ++i) {
+        acc += (int32)x[i] * h[i];
+    }
+    return acc;
+}
+
+#ifdef RTP_RESAMPLE_X86
+
+__attribute__((target("sse4.1")))
+int32 dot_sse41(const int16 *x, const int16 *h, const unsigned taps)
+{
+    __m128i acc = _mm_setzero_si128();
+
+    for (unsigned i = 0; i < taps; i += 8) {
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(x + i)),
+                                                _mm_loadu_si128((const __m128i *)(h + i))));
+    }
+    acc = _mm_hadd_epi32(acc, acc);
+    acc = _mm_hadd_epi32(acc, acc);
+    return _mm_cvtsi128_si32(acc);
+}
+
+__attribute__((target("avx2")))
+int32 dot_avx2(const int16 *x, const int16 *h, const unsigned taps)
+{
+    __m256i acc = _mm256_setzero_si256();
+
+    for (unsigned i = 0; i < taps; i += 16) {
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)(x + i)),
+                                                      _mm256_loadu_si256((const __m256i *)(h + i))));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_hadd_epi32(sum, sum);
+    sum = _mm_hadd_epi32(sum, sum);
+    return _mm_cvtsi128_si32(sum);
+}
+
+#endif  // RTP_RESAMPLE_X86
+
+
+typedef int32 (*dot_product)(const int16 *, const int16 *, const unsigned);
+
+dot_product dot_for(const RTPResampler::kernel k)
+{
+    switch (k) {
+#ifdef RTP_RESAMPLE_X86
+    case RTPResampler::KERNEL_AVX2:     return dot_avx2;
+    case RTPResampler::KERNEL_SSE41:    return dot_sse41;
+#endif
+    default:                            return dot_scalar;
+    }
+}
+
+}   // namespace
+
+
+
+RTPResampler::RTPResampler(const uint32 in_rate, const uint32 out_rate, const unsigned taps /* = 16 */,
+                           const kernel k /* = KERNEL_AUTO */)
+    : _in_rate(in_rate ? in_rate : 1),
+      _out_rate(out_rate ? out_rate : 1),
+      _kernel((k == KERNEL_AUTO) ? best() : k),
+      _time(0),
+      _last_frame(0)
+{
+    uint32 g = gcd(_in_rate, _out_rate);
+    _up = _out_rate / g;
+    _down = _in_rate / g;
+    _design(taps ? taps : 1);
+    reset();
+}
+
+
+
+/******************************************************************************
+*   Forgets the stream's history, as at a new talk spurt from a new source.
+*
+*   Returns none
+******************************************************************************/
+void RTPResampler::reset()
+{
+    _buffer.assign(_taps - 1, 0);
+    _time = 0;
+    _last_frame = 0;
+}
+
+
+
+/******************************************************************************
+*   Builds the Blackman-windowed sinc prototype, cut off just below the lower
+*   of the two Nyquist rates, and splits it into _up phases.  Each phase is
+*   normalized to unity gain at DC and stored reversed, so output sample n
+*   is the dot product of its phase with the _taps input samples ending at
+*   the newest one it depends on.
+*
+*   Returns none
+******************************************************************************/
+void RTPResampler::_design(const unsigned taps)
+{
+    unsigned widest = max(_up, _down);
+
+    _taps = (taps * widest + _up - 1) / _up;
+    _taps = ((_taps + TAP_MULTIPLE - 1) / TAP_MULTIPLE) * TAP_MULTIPLE;
+    _coefs.assign(_up * _taps, 0);
+
+    if (_up == _down) {
+        return;                             // process() just copies
+    }
+
+    unsigned        length = _up * _taps;
+    double          cutoff = 0.45 / widest;             // cycles per upsampled sample
+    double          centre = (length - 1) / 2.0;
+    vector<double>  h(length);
+
+    for (unsigned n = 0; n < length; ++n) {
+        double t = n - centre;
+        double sinc = (t == 0) ? 2 * cutoff : sin(2 * PI * cutoff * t) / (PI * t);
+        double window = 0.42 - 0.5 * cos(2 * PI * n / (length - 1)) + 0.08 * cos(4 * PI * n / (length - 1));
+        h[n] = sinc * window;
+    }
+
+    for (unsigned phase = 0; phase < _up; ++phase) {
+        double sum = 0;
+        for (unsigned k = 0; k < _taps; ++k) {
+            sum += h[phase + k * _up];
+        }
+        for (unsigned k = 0; k < _taps; ++k) {
+            double q = round(h[phase + k * _up] / sum * 32768.0);
+            _coefs[phase * _taps + (_taps - 1 - k)] = (int16)max(-32768.0, min(32767.0, q));
+        }
+    }
+}
+
+
+
+/******************************************************************************
+*   Returns the most samples process() can write for 'count' input samples
+******************************************************************************/
+unsigned RTPResampler::max_output(const unsigned count) const
+{
+    return (unsigned)(((uint64)count * _up + _down - 1) / _down) + 1;
+}
+
+
+
+/******************************************************************************
+*   Runs 'count' input samples through the filter.
+*
+*   Returns number of samples written to 'out'
+******************************************************************************/
+unsigned RTPResampler::process(const int16 *in, const unsigned count, int16 *out, const unsigned capacity)
+{
+    if (_up == _down) {
+        unsigned n = min(count, capacity);
+        memcpy(out, in, n * sizeof(int16));
+        return n;
+    }
+
+    unsigned    history = _taps - 1;
+    unsigned    written = 0;
+    dot_product dot = dot_for(_kernel);
+    uint64      end = (uint64)count * _up;
+
+    _buffer.resize(history + count);
+    memcpy(&_buffer[history], in, count * sizeof(int16));
+
+    // output n needs input samples up to _time / _up, i.e. _buffer from
+    //  that index for _taps samples
+    for (; _time < end; _time += _down) {
+        unsigned        i = (unsigned)(_time / _up);
+        const int16    *h = &_coefs[(unsigned)(_time % _up) * _taps];
+        if (written < capacity) {
+            out[written++] = round_q15(dot(&_buffer[i], h, _taps));
+        }
+    }
+    _time -= end;
+
+    memmove(&_buffer[0], &_buffer[count], history * sizeof(int16));
+    _buffer.resize(history);
+    return written;
+}
+
+
+
+/******************************************************************************
+*   Runs 'count' samples of silence through the filter, for a concealed frame;
+*   the output decays from the last real audio instead of stopping dead.
+*
+*   Returns number of samples written to 'out'
+******************************************************************************/
+unsigned RTPResampler::gap(const unsigned count, int16 *out, const unsigned capacity)
+{
+    _pcm.assign(count, 0);
+    return process(_pcm.data(), count, out, capacity);
+}
+
+
+
+/******************************************************************************
+*   Converts what RTPJitter::pop() returned.
+*
+*   Returns number of samples written to 'out'
+******************************************************************************/
+unsigned RTPResampler::process(const RTPJitter::RESULT rc, const rawrtp_ptr& packet, int16 *out,
+                               const unsigned capacity)
+{
+    switch (rc) {
+    case RTPJitter::SUCCESS:
+        if (packet) {
+            _pcm.resize(packet->nLen);
+            unsigned n = RTPG711::decode(*packet, _pcm.data(), (unsigned)_pcm.size());
+            if (n) {
+                _last_frame = n;
+                return process(_pcm.data(), n, out, capacity);
+            }
+        }
+        return 0;
+
+    case RTPJitter::DROPPED_PACKET:
+        return gap(_last_frame, out, capacity);
+
+    default:
+        return 0;
+    }
+}
+
+
+
+/******************************************************************************
+*   The fastest kernel this CPU supports, checked once.
+*
+*   Returns kernel
+******************************************************************************/
+RTPResampler::kernel RTPResampler::best()
+{
+#ifdef RTP_RESAMPLE_X86
+    __builtin_cpu_init();
+    static const kernel chosen = __builtin_cpu_supports("avx2")   ? KERNEL_AVX2
+                               : __builtin_cpu_supports("sse4.1") ? KERNEL_SSE41
+                               : KERNEL_SCALAR;
+    return chosen;
+#else
+    return KERNEL_SCALAR;
+#endif
+}
+
+const char *RTPResampler::name(const kernel k)
+{
+    switch (k) {
+    case KERNEL_SCALAR: return "scalar";
+    case KERNEL_SSE41:  return "sse4.1";
+    case KERNEL_AVX2:   return "avx2";
+    default:            return name(best());
+    }
+}
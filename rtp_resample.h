@@ -0,0 +1,105 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_RESAMPLE_H_a41f7c0e_58d2_4b3e_9c16_2d7e8b05f9a3
+#define RTP_RESAMPLE_H_a41f7c0e_58d2_4b3e_9c16_2d7e8b05f9a3
+
+#include <vector>
+#include "stdinc.h"
+#include "rtp_jitter.h"
+
+
+
+/******************************************************************************
+*   Polyphase sample rate converter for one stream of 16 bit PCM, e.g. the
+*   8 kHz G.711 coming out of an RTPJitter to the 16 or 48 kHz a mixer
+*   wants.
+*
+*   The ratio is reduced to L/M; the windowed-sinc prototype is split into
+*   L phases of a multiple of 16 Q15 taps each, so that every output sample
+*   is one dot product of whole SSE4.1 or AVX2 vectors with the most recent
+*   input.  The input history and the filter phase carry over from one call
+*   to the next, so frames join up without a seam, and gap() runs the filter
+*   through a concealed frame rather than restarting it.
+*
+*   One instance per stream, used by one thread at a time.
+******************************************************************************/
+class RTPResampler
+{
+public:
+    enum kernel
+    {
+        KERNEL_AUTO = 0,            // the best this CPU runs
+        KERNEL_SCALAR,
+        KERNEL_SSE41,
+        KERNEL_AVX2
+    };
+
+    static const unsigned TAP_MULTIPLE = 16;
+
+    // 'taps' is the length of the prototype filter in input samples at the
+    //  lower of the two rates; more is sharper and slower
+    RTPResampler(const uint32 in_rate, const uint32 out_rate, const unsigned taps = 16, const kernel k = KERNEL_AUTO);
+
+    void        reset();
+
+    // - converts 'count' input samples, writing at most 'capacity' output
+    //  samples; anything beyond that is lost.  Returns samples written.
+    unsigned    process(const int16 *in, const unsigned count, int16 *out, const unsigned capacity);
+    unsigned    gap(const unsigned count, int16 *out, const unsigned capacity);
+
+    // - the pop() output of an RTPJitter: G.711 packets are decoded and
+    //  converted, a DROPPED_PACKET is a gap the length of the last frame,
+    //  and anything else produces nothing
+    unsigned    process(const RTPJitter::RESULT rc, const rawrtp_ptr& packet, int16 *out, const unsigned capacity);
+
+    // most output samples 'count' input samples can produce
+    unsigned    max_output(const unsigned count) const;
+
+    uint32      in_rate() const                 { return _in_rate; }
+    uint32      out_rate() const                { return _out_rate; }
+    unsigned    up() const                      { return _up; }
+    unsigned    down() const                    { return _down; }
+    unsigned    taps_per_phase() const          { return _taps; }
+
+    static kernel       best();
+    static const char  *name(const kernel k);
+
+private:
+    uint32              _in_rate;
+    uint32              _out_rate;
+    unsigned            _up;                // L
+    unsigned            _down;              // M
+    unsigned            _taps;              // per phase
+    kernel              _kernel;
+    std::vector<int16>  _coefs;             // _up phases of _taps, newest sample's tap last
+    std::vector<int16>  _buffer;            // _taps - 1 samples of history, then the input
+    std::vector<int16>  _pcm;               // decoded packet
+    uint64              _time;              // next output, in upsampled units from the first new sample
+    unsigned            _last_frame;        // input samples in the last packet
+
+    void        _design(const unsigned taps);
+};
+
+#endif  // RTP_RESAMPLE_H_a41f7c0e_58d2_4b3e_9c16_2d7e8b05f9a3
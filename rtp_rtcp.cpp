@@ -0,0 +1,166 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   RTCP sender report tracking and receiver report packets.
+*
+******************************************************************************/
+
+#include "rtp_rtcp.h"
+#include <cstring>
+#include <arpa/inet.h>
+
+using namespace std;
+
+
+/******************************************************************************
+*   Records an SR whose NTP timestamp was 'ntp_msw.ntp_lsw' and which arrived
+*   at 'arrival'.
+*
+*   Returns nothing
+******************************************************************************/
+void RTCPSenderTracker::on_sender_report(const uint32 ntp_msw, const uint32 ntp_lsw, const timepoint arrival)
+{
+    uint32 lsr = (ntp_msw << 16) | (ntp_lsw >> 16);
+
+    // keep 0 meaning "no SR yet"; an arrival of exactly 0 is off by 15us
+    uint32 when = compact_time(arrival);
+    if ((lsr == 0) && (when == 0)) {
+        when = 1;
+    }
+    _last.store(((uint64)lsr << 32) | when, memory_order_release);
+}
+
+
+
+/******************************************************************************
+*   Looks through a (possibly compound) RTCP packet for a sender report and
+*   records it.  If 'ssrc' is non-zero, only an SR from that source counts.
+*
+*   Returns true if an SR was recorded
+******************************************************************************/
+bool RTCPSenderTracker::on_rtcp(const uint8 *packet, const unsigned len, const timepoint arrival,
+                                const uint32 ssrc /* = 0 */)
+{
+    unsigned offset = 0;
+
+    while ((offset + RTCP_HEADER_LENGTH) <= len) {
+        const uint8 *p = packet + offset;
+        uint16 words;
+        memcpy(&words, p + 2, sizeof(words));
+        unsigned length = (ntohs(words) + 1) * 4;
+
+        if (((p[0] >> 6) != 2) || ((offset + length) > len)) {
+            return false;       // not RTCP, or truncated
+        }
+
+        if ((p[1] == RTCP_PT_SR) && (length >= 20)) {
+            uint32 sender, msw, lsw;
+            memcpy(&sender, p + 4, sizeof(sender));
+            memcpy(&msw, p + 8, sizeof(msw));
+            memcpy(&lsw, p + 12, sizeof(lsw));
+            if ((ssrc == 0) || (ntohl(sender) == ssrc)) {
+                on_sender_report(ntohl(msw), ntohl(lsw), arrival);
+                return true;
+            }
+        }
+        offset += length;
+    }
+    return false;
+}
+
+
+
+/******************************************************************************
+*   The LSR field: middle 32 bits of the last SR's NTP timestamp.
+*
+*   Returns LSR, 0 if no SR has been seen
+******************************************************************************/
+uint32 RTCPSenderTracker::lsr() const
+{
+    return (uint32)(_last.load(memory_order_acquire) >> 32);
+}
+
+
+
+/******************************************************************************
+*   The DLSR field: time since the last SR arrived, in 1/65536 seconds.
+*
+*   Returns DLSR, 0 if no SR has been seen
+******************************************************************************/
+uint32 RTCPSenderTracker::dlsr(const timepoint now) const
+{
+    uint64 last = _last.load(memory_order_acquire);
+
+    if (last == 0) {
+        return 0;
+    }
+    return compact_time(now) - (uint32)last;
+}
+
+
+
+/******************************************************************************
+*   Converts a steady clock time to 1/65536 second units.  Only differences
+*   mean anything, and they stay correct across the 2^32 wrap (18 hours).
+*
+*   Returns compact time
+******************************************************************************/
+uint32 RTCPSenderTracker::compact_time(const timepoint t)
+{
+    int64 ns = clocks::duration_cast<clocks::nanoseconds>(t.time_since_epoch()).count();
+
+    // split to keep ns * 65536 from overflowing
+    int64 seconds = ns / 1000000000;
+    int64 fraction = ns % 1000000000;
+    return (uint32)((seconds << 16) + ((fraction << 16) / 1000000000));
+}
+
+
+
+/******************************************************************************
+*   Writes an RR packet from 'reporter_ssrc' carrying up to 31 report blocks.
+*   Call repeatedly, advancing 'blocks', to report on more sources.
+*
+*   Returns bytes written, 0 if it does not fit in 'capacity'
+******************************************************************************/
+unsigned RTCPReceiverReport::build(uint8 *out, const unsigned capacity, const uint32 reporter_ssrc,
+                                   const RTCPReportBlock *blocks, const unsigned count)
+{
+    unsigned n = (count > RTCP_MAX_REPORT_BLOCKS) ? RTCP_MAX_REPORT_BLOCKS : count;
+    unsigned bytes = RTCP_HEADER_LENGTH + (n * sizeof(RTCPReportBlock));
+
+    if ((out == nullptr) || (bytes > capacity)) {
+        return 0;
+    }
+
+    uint16 length = htons((uint16)((bytes / 4) - 1));
+    uint32 ssrc = htonl(reporter_ssrc);
+
+    out[0] = (uint8)((2 << 6) | n);
+    out[1] = RTCP_PT_RR;
+    memcpy(out + 2, &length, sizeof(length));
+    memcpy(out + 4, &ssrc, sizeof(ssrc));
+    memcpy(out + RTCP_HEADER_LENGTH, blocks, n * sizeof(RTCPReportBlock));
+    return bytes;
+}
@@ -0,0 +1,128 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_RTCP_H_4f8b2d61_c9e3_47a5_8d10_b7e52a9f3c06
+#define RTP_RTCP_H_4f8b2d61_c9e3_47a5_8d10_b7e52a9f3c06
+
+#include <atomic>
+#include "stdinc.h"
+
+// from RFC 3550, the pieces of RTCP a receiver needs to report on the
+//  streams it is buffering.
+/*
+6.4.1 SR: Sender Report RTCP Packet
+
+        0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+header |V=2|P|    RC   |   PT=SR=200   |             length            |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |                         SSRC of sender                        |
+       +=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+sender |              NTP timestamp, most significant word             |
+info   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |             NTP timestamp, least significant word             |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |                         RTP timestamp                         |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |                     sender's packet count                     |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |                      sender's octet count                     |
+       +=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+report |                 SSRC_1 (SSRC of first source)                 |
+block  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  1    | fraction lost |       cumulative number of packets lost       |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |           extended highest sequence number received           |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |                      interarrival jitter                      |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |                         last SR (LSR)                         |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |                   delay since last SR (DLSR)                  |
+       +=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+
+   An RR (PT=201) is the same without the sender info.
+*/
+
+#define RTCP_PT_SR              200
+#define RTCP_PT_RR              201
+#define RTCP_HEADER_LENGTH      8           // including the reporter's SSRC
+#define RTCP_MAX_REPORT_BLOCKS  31          // RC is 5 bits
+
+
+#pragma pack(push, 1)
+typedef struct {
+    uint32          ssrc;               // source being reported on
+    uint32          lost;               // fraction lost (8 bits) | cumulative lost (24 bits)
+    uint32          highest_sequence;   // cycles << 16 | highest sequence
+    uint32          jitter;             // timestamp units
+    uint32          lsr;                // middle 32 bits of the last SR's NTP timestamp
+    uint32          dlsr;               // 1/65536 seconds since that SR arrived
+} RTCPReportBlock;                      // all fields in network byte order
+
+#pragma pack(pop)
+
+
+
+/******************************************************************************
+*   Remembers the last sender report (SR) seen from a source so receiver
+*   reports can carry LSR and DLSR.  Feed it SRs from the RTCP socket with
+*   on_rtcp() or on_sender_report(); read it from whichever thread builds
+*   the reports.  The state is a single 64-bit atomic, so the two sides
+*   never need a lock and never see half an update.
+******************************************************************************/
+class RTCPSenderTracker
+{
+public:
+    RTCPSenderTracker() : _last(0) {}
+
+    void    on_sender_report(const uint32 ntp_msw, const uint32 ntp_lsw, const timepoint arrival);
+    bool    on_rtcp(const uint8 *packet, const unsigned len, const timepoint arrival,
+                    const uint32 ssrc = 0);
+
+    uint32  lsr() const;
+    uint32  dlsr(const timepoint now) const;
+
+    // steady clock in the 1/65536 second units of DLSR, modulo 2^32
+    static uint32 compact_time(const timepoint t);
+
+private:
+    std::atomic<uint64>     _last;      // LSR << 32 | compact arrival time; 0 = none yet
+};
+
+
+
+/******************************************************************************
+*   Builds RTCP receiver report packets around report blocks, such as those
+*   filled by RTPJitter::fill_reports().
+******************************************************************************/
+class RTCPReceiverReport
+{
+public:
+    static unsigned build(uint8 *out, const unsigned capacity, const uint32 reporter_ssrc,
+                          const RTCPReportBlock *blocks, const unsigned count);
+};
+
+#endif  // RTP_RTCP_H_4f8b2d61_c9e3_47a5_8d10_b7e52a9f3c06
@@ -0,0 +1,236 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   hierarchical timer wheel.
+*
+******************************************************************************/
+
+#include <cstring>
+#include "rtp_timer.h"
+
+using namespace std;
+
+
+
+RTPTimerWheel::RTPTimerWheel(const timepoint start /* = stdclock::now() */,
+                             const clocks::nanoseconds resolution /* = clocks::milliseconds(1) */)
+    : _origin(start),
+      _resolution_ns((resolution.count() > 0) ? resolution.count() : 1),
+      _tick(0),
+      _count(0)
+{
+    memset(_slots, 0, sizeof(_slots));
+    memset(_occupied, 0, sizeof(_occupied));
+}
+
+
+
+/******************************************************************************
+*   Takes the timer out of whatever slot, or list being run, it is in.
+*
+*   Returns none
+******************************************************************************/
+void RTPTimerWheel::timer::_unlink()
+{
+    *_pprev = _next;
+    if (_next) {
+        _next->_pprev = _pprev;
+    }
+    if (_wheel->_slots[_level][_slot] == nullptr) {
+        _wheel->_occupied[_level] &= ~(1ULL << _slot);
+    }
+    --_wheel->_count;
+    _next = nullptr;
+    _pprev = nullptr;
+}
+
+
+
+/******************************************************************************
+*   Arms the timer, moving it if it was already pending.
+*
+*   Returns none
+******************************************************************************/
+void RTPTimerWheel::schedule(timer& t, const timepoint deadline)
+{
+    cancel(t);
+
+    int64 ns = clocks::duration_cast<clocks::nanoseconds>(deadline - _origin).count();
+    t._expires = (ns <= 0) ? 0 : (uint64)((ns + _resolution_ns - 1) / _resolution_ns);
+    t._wheel = this;
+    _insert(t);
+}
+
+
+
+/******************************************************************************
+*   Links the timer into the level whose span covers its distance from the
+*   current tick, in the slot its expiry falls in at that level.
+*
+*   Returns none
+******************************************************************************/
+void RTPTimerWheel::_insert(timer& t)
+{
+    const uint64 span = 1ULL << (SLOT_BITS * LEVELS);
+
+    uint64 expires = (t._expires < _tick) ? _tick : t._expires;
+    if (expires - _tick >= span) {
+        expires = _tick + span - 1;     // parked at the top; placed again when its slot turns
+    }
+
+    unsigned level = 0;
+    while ((level < LEVELS - 1) && ((expires - _tick) >> (SLOT_BITS * (level + 1)))) {
+        ++level;
+    }
+    unsigned slot = (unsigned)(expires >> (SLOT_BITS * level)) & (SLOTS - 1);
+
+    timer **head = &_slots[level][slot];
+    t._next = *head;
+    if (t._next) {
+        t._next->_pprev = &t._next;
+    }
+    t._pprev = head;
+    *head = &t;
+    t._level = (uint8)level;
+    t._slot = (uint8)slot;
+    _occupied[level] |= (1ULL << slot);
+    ++_count;
+}
+
+
+
+/******************************************************************************
+*   The current tick has reached the start of a slot at 'level': everything
+*   in it moves down to a finer level.
+*
+*   Returns none
+******************************************************************************/
+void RTPTimerWheel::_cascade(const unsigned level)
+{
+    unsigned    slot = (unsigned)(_tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+    timer      *list = _slots[level][slot];
+
+    if (list == nullptr) {
+        return;
+    }
+    _slots[level][slot] = nullptr;
+    _occupied[level] &= ~(1ULL << slot);
+    list->_pprev = &list;
+
+    while (list) {
+        timer& t = *list;
+        t._unlink();
+        _insert(t);
+    }
+}
+
+
+
+/******************************************************************************
+*   Runs every tick up to and including the one 'now' falls in.
+*
+*   Returns number of timers fired
+******************************************************************************/
+unsigned RTPTimerWheel::advance(const timepoint now)
+{
+    int64 ns = clocks::duration_cast<clocks::nanoseconds>(now - _origin).count();
+    if (ns < 0) {
+        return 0;
+    }
+
+    uint64      target = (uint64)ns / _resolution_ns;
+    unsigned    fired = 0;
+
+    while (_tick <= target) {
+        if (_count == 0) {
+            _tick = target + 1;         // nothing to cascade or fire on the way
+            break;
+        }
+
+        // with nothing at level 0, skip to where the next level turns
+        if ((_occupied[0] != 0) || ((_tick & (SLOTS - 1)) == 0)) {
+            fired += _run(now);
+        } else {
+            uint64 next = (_tick | (SLOTS - 1)) + 1;        // next level 0 wrap
+            if (next > target) {
+                _tick = target + 1;
+                break;
+            }
+            _tick = next;
+            fired += _run(now);
+        }
+    }
+    return fired;
+}
+
+
+
+/******************************************************************************
+*   Runs the current tick: cascades whatever levels turn over at it, then
+*   fires its level 0 slot.
+*
+*   Returns number of timers fired
+******************************************************************************/
+unsigned RTPTimerWheel::_run(const timepoint now)
+{
+    if ((_tick & (SLOTS - 1)) == 0) {
+        for (unsigned level = 1; level < LEVELS; ++level) {
+            _cascade(level);
+            if ((_tick >> (SLOT_BITS * level)) & (SLOTS - 1)) {
+                break;                  // the coarser levels only turn when this one wraps
+            }
+        }
+    }
+
+    unsigned    slot = (unsigned)_tick & (SLOTS - 1);
+    timer      *list = _slots[0][slot];
+    unsigned    fired = 0;
+
+    ++_tick;
+    if (list == nullptr) {
+        return 0;
+    }
+    _slots[0][slot] = nullptr;
+    _occupied[0] &= ~(1ULL << slot);
+    list->_pprev = &list;
+
+    // - a callback may cancel or re-arm any timer, those still on 'list'
+    //  included, so take them off one at a time
+    while (list) {
+        timer& t = *list;
+        t._unlink();
+        ++fired;
+        if (t.on_expiry) {
+            t.on_expiry(t, now);
+        }
+    }
+    return fired;
+}
+
+
+
+timepoint RTPTimerWheel::_time(const uint64 tick) const
+{
+    return _origin + clocks::nanoseconds((int64)tick * _resolution_ns);
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_TIMER_H_7e0c4a96_2b1d_4f63_8a57_d91c3e6b08f2
+#define RTP_TIMER_H_7e0c4a96_2b1d_4f63_8a57_d91c3e6b08f2
+
+#include <functional>
+#include "stdinc.h"
+
+
+
+/******************************************************************************
+*   Hierarchical timer wheel: LEVELS wheels of 64 slots each, the first one
+*   tick per slot and each one after 64 times coarser, so 4 levels of 1 ms
+*   ticks reach about 4.6 hours out (later timers wait at the top level and
+*   are placed again as it turns).  Timers are intrusive and doubly linked
+*   into their slot, so schedule() and cancel() are O(1) whatever the number
+*   of timers; a timer only moves down a level when its slot comes round.
+*
+*   Deadlines are rounded up to the next tick, so a timer never fires early
+*   but may be up to one tick late.  A wheel belongs to one thread, which
+*   calls advance() to run whatever has come due; callbacks may schedule or
+*   cancel any timer, including the one firing.
+******************************************************************************/
+class RTPTimerWheel
+{
+public:
+    static const unsigned LEVELS    = 4;
+    static const unsigned SLOT_BITS = 6;
+    static const unsigned SLOTS     = 1 << SLOT_BITS;
+
+    class timer
+    {
+    public:
+        typedef std::function<void(timer& t, const timepoint now)> callback;
+
+        timer() : _next(nullptr), _pprev(nullptr), _wheel(nullptr), _expires(0), _level(0), _slot(0) {}
+        explicit timer(callback cb) : timer() { on_expiry = std::move(cb); }
+        ~timer()                        { if (_pprev) _unlink(); }
+
+        bool        pending() const     { return _pprev != nullptr; }
+
+        callback    on_expiry;
+
+    private:
+        friend class RTPTimerWheel;
+
+        timer      *_next;
+        timer     **_pprev;             // the pointer that points at us, null when idle
+        RTPTimerWheel *_wheel;
+        uint64      _expires;           // tick
+        uint8       _level;
+        uint8       _slot;
+
+        timer(const timer&) = delete;
+        timer& operator=(const timer&) = delete;
+
+        void        _unlink();
+    };
+
+    RTPTimerWheel(const timepoint start = stdclock::now(),
+                  const clocks::nanoseconds resolution = clocks::milliseconds(1));
+
+    // - (re)arms 't' to fire at the first tick at or after 'deadline'; a
+    //  deadline already past fires on the next advance()
+    void        schedule(timer& t, const timepoint deadline);
+    void        cancel(timer& t)                { if (t.pending()) t._unlink(); }
+
+    // - runs every timer due by 'now'; returns how many fired
+    unsigned    advance(const timepoint now);
+
+    size_t      pending() const                 { return _count; }
+    timepoint   now() const                     { return _time(_tick); }
+
+private:
+    timepoint       _origin;
+    int64           _resolution_ns;
+    uint64          _tick;              // next tick to run
+    size_t          _count;
+    timer          *_slots[LEVELS][SLOTS];
+    uint64          _occupied[LEVELS];  // bit n set if _slots[level][n] is not empty
+
+    // - timers point back at their wheel
+    RTPTimerWheel(const RTPTimerWheel&) = delete;
+    RTPTimerWheel(RTPTimerWheel&&) = delete;
+    RTPTimerWheel& operator=(const RTPTimerWheel&) = delete;
+    RTPTimerWheel& operator=(RTPTimerWheel&&) = delete;
+
+    void        _insert(timer& t);
+    void        _cascade(const unsigned level);
+    unsigned    _run(const timepoint now);
+    timepoint   _time(const uint64 tick) const;
+};
+
+#endif  // RTP_TIMER_H_7e0c4a96_2b1d_4f63_8a57_d91c3e6b08f2
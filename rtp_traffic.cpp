@@ -0,0 +1,309 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   seeded RTP traffic generator with network impairments.
+*
+*   See rtp_traffic.h for the impairment models.
+*
+******************************************************************************/
+
+#include "rtp_traffic.h"
+#include <algorithm>
+#include <cmath>
+#include <arpa/inet.h>
+
+using namespace std;
+
+
+/******************************************************************************
+*   Seeds the generator.  The first packet is "sent" at 'start'.
+*
+*   Returns n/a
+******************************************************************************/
+RTPTrafficGenerator::RTPTrafficGenerator(const config& cfg, const timepoint start /* = timepoint() */)
+    : _config(cfg), _start(start), _now(start), _next_index(0),
+      _ge_bad(false), _spike_left_ms(0.0), _spike_step_ms(0.0)
+{
+    // splitmix64 the seed into the xorshift state so that nearby seeds
+    //  still give unrelated streams.
+    uint64 z = _config.seed;
+    for (int i = 0; i < 2; ++i) {
+        z += 0x9e3779b97f4a7c15ULL;
+        uint64 x = z;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        _rng[i] = x ^ (x >> 31);
+    }
+    if ((_rng[0] | _rng[1]) == 0) {
+        _rng[0] = 1;
+    }
+
+    if (_config.payload_ms == 0) {
+        _config.payload_ms = 20;
+    }
+    memset(&_counters, 0, sizeof(_counters));
+}
+
+
+
+/******************************************************************************
+*   Advances the virtual clock to 'until': sends every packet due by then and
+*   appends every packet that has arrived by then to 'out', in arrival order.
+*
+*   Returns number of packets appended
+******************************************************************************/
+unsigned RTPTrafficGenerator::generate(const timepoint until, vector<arrival>& out)
+{
+    const int64 until_ns = clocks::duration_cast<clocks::nanoseconds>(until - _start).count();
+    const int64 period_ns = (int64)_config.payload_ms * 1000000LL;
+    unsigned    count = 0;
+
+    while ((int64)_next_index * period_ns <= until_ns) {
+        _send(_next_index++);
+    }
+
+    while (!_in_flight.empty() && (_in_flight.front().arrival_ns <= until_ns)) {
+        pop_heap(_in_flight.begin(), _in_flight.end());
+        flight f = _in_flight.back();
+        _in_flight.pop_back();
+
+        arrival a;
+        a.time = _start + clocks::nanoseconds(f.arrival_ns);
+        a.packet = _build(f.index);
+        out.push_back(move(a));
+        ++count;
+    }
+    _counters.delivered += count;
+
+    if (until > _now) {
+        _now = until;
+    }
+    return count;
+}
+
+
+
+/******************************************************************************
+*   Plays the stream through the given buffer for duration_ms of virtual
+*   time: at every packet interval, push whatever has arrived (stamped with
+*   its arrival time) and pop() once, as a playout thread would.
+*
+*   Returns what happened to the packets
+******************************************************************************/
+RTPTrafficGenerator::playout RTPTrafficGenerator::simulate(RTPJitter& jitter, const unsigned duration_ms)
+{
+    playout         result;
+    vector<arrival> arrivals;
+    rawrtp_ptr      packet;
+    timepoint       end = _now + clocks::milliseconds(duration_ms);
+    timepoint       tick = _now;
+
+    memset(&result, 0, sizeof(result));
+
+    while (tick < end) {
+        tick += clocks::milliseconds(_config.payload_ms);
+
+        arrivals.clear();
+        generate(tick, arrivals);
+        for (arrival& a : arrivals) {
+            RTPJitter::RESULT rc = jitter.push(move(a.packet), a.time);
+            result.pushed++;
+            if (rc == RTPJitter::BAD_PACKET) {
+                result.rejected++;
+            } else if (rc == RTPJitter::BUFFER_OVERFLOW) {
+                result.overflows++;
+            }
+        }
+
+        switch (jitter.pop(packet, tick)) {
+        case RTPJitter::SUCCESS:
+            result.played++;
+            break;
+        case RTPJitter::DROPPED_PACKET:
+            result.concealed++;
+            break;
+        default:
+            result.starved++;
+            break;
+        }
+        packet.reset();
+    }
+    return result;
+}
+
+
+
+/******************************************************************************
+*   xorshift128+ -- fast, and identical everywhere for a given seed.
+******************************************************************************/
+uint64 RTPTrafficGenerator::_next_random()
+{
+    uint64 s1 = _rng[0];
+    const uint64 s0 = _rng[1];
+    _rng[0] = s0;
+    s1 ^= s1 << 23;
+    _rng[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+    return _rng[1] + s0;
+}
+
+double RTPTrafficGenerator::_uniform()
+{
+    // 53 random bits -> [0, 1)
+    return (_next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+
+/******************************************************************************
+*   Draws one packet's one-way delay from the configured model.
+*
+*   Returns delay in milliseconds
+******************************************************************************/
+double RTPTrafficGenerator::_delay_ms()
+{
+    double delay = _config.base_delay_ms;
+
+    if (_config.jitter_ms > 0.0) {
+        delay += _uniform() * _config.jitter_ms;
+    }
+
+    switch (_config.delay) {
+    case DELAY_PARETO:
+        if (_config.pareto_shape > 0.0) {
+            double u = 1.0 - _uniform();            // (0, 1]
+            delay += _config.pareto_scale_ms * (pow(u, -1.0 / _config.pareto_shape) - 1.0);
+        }
+        break;
+    case DELAY_BIMODAL:
+        if (_uniform() < _config.bimodal_prob) {
+            delay += _config.bimodal_ms;
+        }
+        break;
+    case DELAY_SPIKES:
+        if ((_spike_left_ms <= 0.0) && (_uniform() < _config.spike_prob)) {
+            _spike_left_ms = _config.spike_ms;
+            _spike_step_ms = _config.spike_ms / (_config.spike_packets ? _config.spike_packets : 1);
+        }
+        if (_spike_left_ms > 0.0) {
+            delay += _spike_left_ms;
+            _spike_left_ms -= _spike_step_ms;
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (delay < 0.0) delay = 0.0;
+    if (delay > _config.max_delay_ms) delay = _config.max_delay_ms;
+    return delay;
+}
+
+
+
+/******************************************************************************
+*   Steps the Gilbert-Elliott chain one packet and decides this packet's fate.
+*
+*   Returns true if the packet is lost
+******************************************************************************/
+bool RTPTrafficGenerator::_lost()
+{
+    if ((_config.ge_p <= 0.0) && !_ge_bad) {
+        return (_config.loss_good > 0.0) && (_uniform() < _config.loss_good);
+    }
+
+    if (_ge_bad) {
+        if (_uniform() < _config.ge_r) _ge_bad = false;
+    } else {
+        if (_uniform() < _config.ge_p) _ge_bad = true;
+    }
+
+    double loss = _ge_bad ? _config.loss_bad : _config.loss_good;
+    return (loss > 0.0) && (_uniform() < loss);
+}
+
+
+
+/******************************************************************************
+*   Puts packet 'index' on the wire: maybe loses it, otherwise schedules its
+*   arrival (and that of a duplicate, if any).
+*
+*   Returns none
+******************************************************************************/
+void RTPTrafficGenerator::_send(const uint64 index)
+{
+    _counters.sent++;
+    if (_lost()) {
+        _counters.lost++;
+        return;
+    }
+
+    double delay = _delay_ms();
+    if ((_config.reorder_prob > 0.0) && (_uniform() < _config.reorder_prob)) {
+        delay += _config.reorder_ms;
+        _counters.reordered++;
+    }
+
+    int64   sent_ns = (int64)index * _config.payload_ms * 1000000LL;
+    flight  f;
+    f.arrival_ns = sent_ns + (int64)(delay * 1e6);
+    f.index = index;
+    f.duplicate = false;
+    _in_flight.push_back(f);
+    push_heap(_in_flight.begin(), _in_flight.end());
+
+    if ((_config.dup_prob > 0.0) && (_uniform() < _config.dup_prob)) {
+        f.arrival_ns += (int64)(_config.dup_ms * 1e6);
+        f.duplicate = true;
+        _in_flight.push_back(f);
+        push_heap(_in_flight.begin(), _in_flight.end());
+        _counters.duplicated++;
+    }
+}
+
+
+
+/******************************************************************************
+*   Builds the RTP packet for send slot 'index'.
+*
+*   Returns the packet, with payload_ms/payload_bytes/payload_type filled in
+******************************************************************************/
+rawrtp_ptr RTPTrafficGenerator::_build(const uint64 index)
+{
+    uint8       data[RTP_HEADER_LENGTH + 1500];
+    unsigned    bytes = (_config.payload_bytes < 1500) ? _config.payload_bytes : 1500;
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(data);
+
+    rtp->flags = htons((RTP_VERSION << 14) | (_config.payload_type & RTP_FLAGS_PAYLOAD_TYPE));
+    rtp->sequence = htons((uint16)(_config.first_sequence + index));
+    rtp->timestamp = htonl((uint32)(_config.first_timestamp
+                                  + index * _config.payload_ms * (_config.sample_rate / 1000)));
+    rtp->ssrc = htonl(_config.ssrc);
+    memset(data + RTP_HEADER_LENGTH, 0xff, bytes);
+
+    rawrtp_ptr packet = make_shared<RTPPacket>(data, (short)(RTP_HEADER_LENGTH + bytes));
+    packet->payload_ms = _config.payload_ms;
+    packet->payload_type = _config.payload_type;
+    packet->payload_bytes = bytes;
+    return packet;
+}
@@ -0,0 +1,183 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+******************************************************************************/
+
+#ifndef RTP_TRAFFIC_H_93f0c6d2_5a1e_4b87_8c24_d7e1a04b69f3
+#define RTP_TRAFFIC_H_93f0c6d2_5a1e_4b87_8c24_d7e1a04b69f3
+
+#include <vector>
+#include "stdinc.h"
+#include "rtp.h"
+#include "rtp_jitter.h"
+
+
+
+/******************************************************************************
+*   Seeded synthetic RTP source and network impairment model, for tuning and
+*   stress testing RTPJitter against reproducible bad networks.
+*
+*   Packets are "sent" every payload_ms on a virtual clock and each one is
+*   given a one-way delay drawn from the configured distribution:
+*
+*       DELAY_CONSTANT  - base_delay_ms + uniform(0, jitter_ms)
+*       DELAY_PARETO    - plus a heavy tail: pareto_scale_ms * (U^(-1/shape) - 1)
+*       DELAY_BIMODAL   - plus bimodal_ms with probability bimodal_prob
+*       DELAY_SPIKES    - plus occasional spikes of spike_ms that drain away
+*                         linearly over spike_packets packets
+*
+*   On top of that: Gilbert-Elliott two-state burst loss, reordering (a packet
+*   is held back reorder_ms extra) and duplication (a copy arrives dup_ms
+*   after the original).  Delays are capped at max_delay_ms.
+*
+*   generate() returns packets in arrival order along with their arrival
+*   time, ready for RTPJitter::push(packet, arrival).  The random generator is
+*   our own xorshift so a seed gives the same stream on every platform.
+******************************************************************************/
+class RTPTrafficGenerator
+{
+public:
+    enum delay_model
+    {
+        DELAY_CONSTANT = 0,
+        DELAY_PARETO,
+        DELAY_BIMODAL,
+        DELAY_SPIKES
+    };
+
+    struct config
+    {
+        uint64      seed;
+
+        // - stream
+        uint8       payload_type;
+        unsigned    payload_ms;
+        unsigned    payload_bytes;
+        uint32      sample_rate;
+        uint32      ssrc;
+        uint16      first_sequence;
+        uint32      first_timestamp;
+
+        // - delay
+        delay_model delay;
+        double      base_delay_ms;
+        double      jitter_ms;
+        double      max_delay_ms;
+        double      pareto_scale_ms;
+        double      pareto_shape;
+        double      bimodal_ms;
+        double      bimodal_prob;
+        double      spike_ms;
+        double      spike_prob;
+        unsigned    spike_packets;
+
+        // - Gilbert-Elliott loss: p = P(good->bad), r = P(bad->good)
+        double      ge_p;
+        double      ge_r;
+        double      loss_good;
+        double      loss_bad;
+
+        // - reordering and duplication
+        double      reorder_prob;
+        double      reorder_ms;
+        double      dup_prob;
+        double      dup_ms;
+
+        config()
+            : seed(1), payload_type(RTP_PAYLOAD_G711U), payload_ms(20), payload_bytes(160),
+              sample_rate(8000), ssrc(0x5eed), first_sequence(0), first_timestamp(0),
+              delay(DELAY_CONSTANT), base_delay_ms(20.0), jitter_ms(0.0), max_delay_ms(2000.0),
+              pareto_scale_ms(2.0), pareto_shape(1.5), bimodal_ms(40.0), bimodal_prob(0.1),
+              spike_ms(200.0), spike_prob(0.001), spike_packets(10),
+              ge_p(0.0), ge_r(1.0), loss_good(0.0), loss_bad(1.0),
+              reorder_prob(0.0), reorder_ms(30.0), dup_prob(0.0), dup_ms(1.0) {}
+    };
+
+    struct arrival
+    {
+        timepoint   time;
+        rawrtp_ptr  packet;
+    };
+
+    struct counters
+    {
+        uint64      sent;
+        uint64      lost;
+        uint64      duplicated;
+        uint64      reordered;
+        uint64      delivered;
+    };
+
+    // outcome of simulate()
+    struct playout
+    {
+        uint64      pushed;
+        uint64      rejected;           // push() said BAD_PACKET (too late)
+        uint64      overflows;
+        uint64      played;             // pop() SUCCESS
+        uint64      concealed;          // pop() DROPPED_PACKET
+        uint64      starved;            // pop() BUFFERING/BUFFER_EMPTY
+    };
+
+    RTPTrafficGenerator(const config& cfg, const timepoint start = timepoint());
+
+    unsigned    generate(const timepoint until, std::vector<arrival>& out);
+    playout     simulate(RTPJitter& jitter, const unsigned duration_ms);
+
+    timepoint   now() const                 { return _now; }
+    const counters& get_counters() const    { return _counters; }
+
+private:
+    // packet in flight: only what is needed to build it on arrival
+    struct flight
+    {
+        int64       arrival_ns;
+        uint64      index;              // send order
+        bool        duplicate;
+
+        bool operator<(const flight& other) const
+        {
+            return (arrival_ns != other.arrival_ns) ? (arrival_ns > other.arrival_ns)
+                                                    : (index > other.index);
+        }
+    };
+
+    config              _config;
+    timepoint           _start;
+    timepoint           _now;
+    uint64              _next_index;
+    uint64              _rng[2];
+    bool                _ge_bad;
+    double              _spike_left_ms;
+    double              _spike_step_ms;
+    std::vector<flight> _in_flight;         // min-heap on arrival time
+    counters            _counters;
+
+    uint64      _next_random();
+    double      _uniform();
+    double      _delay_ms();
+    bool        _lost();
+    void        _send(const uint64 index);
+    rawrtp_ptr  _build(const uint64 index);
+};
+
+#endif  // RTP_TRAFFIC_H_93f0c6d2_5a1e_4b87_8c24_d7e1a04b69f3
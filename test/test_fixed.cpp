@@ -0,0 +1,189 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   -----
+*
+*   steady state check for the heap-free RTPFixedJitter.
+*
+*   usage: test_fixed [packets]
+*
+*   Builds an RTPFixedPacketPool and an RTPFixedJitter, sets up the thread's
+*   event log ring, then streams 'packets' packets through them -- in order,
+*   reordered, lost, overflowing and reset -- counting every heap allocation
+*   made in the meantime.  The exit status is 1 if anything was allocated,
+*   or if the stream failed to reach one of those paths.
+*
+******************************************************************************/
+
+#include "rtp_fixed.h"
+#include "rtp_log.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <arpa/inet.h>
+
+using namespace std;
+
+
+// - allocation counting -------------------------------------------------------
+
+static uint64 allocations = 0;
+
+void *operator new(size_t size)
+{
+    ++allocations;
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    ++allocations;
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept             { free(p); }
+void operator delete[](void *p) noexcept           { free(p); }
+void operator delete(void *p, size_t) noexcept     { free(p); }
+void operator delete[](void *p, size_t) noexcept   { free(p); }
+
+
+// - the stream ---------------------------------------------------------------
+
+static const unsigned   PACKET_BYTES = 172;
+static const unsigned   PACKET_MS    = 20;
+static const unsigned   DEPTH_MS     = 60;
+static const unsigned   SLOTS        = 4;      // under the 120 ms max depth (6 packets), so bursts hit the ring's capacity
+static const unsigned   POOL         = 64;
+
+typedef RTPFixedJitter<SLOTS>               fixed_jitter;
+typedef RTPFixedPacketPool<POOL, 256>       fixed_pool;
+
+struct counts
+{
+    uint64  popped;
+    uint64  out_of_order;
+    uint64  overflows;
+    uint64  dropped;
+    uint64  resets;
+};
+
+// the i'th packet of the stream: every 7th swapped with its successor,
+//  every 50th lost, and a burst every 1000 that overflows the ring
+static uint16 sequence_at(const unsigned i)
+{
+    if ((i % 7) == 0) return (uint16)(i + 1);
+    if ((i % 7) == 1) return (uint16)(i - 1);
+    return (uint16)i;
+}
+
+static void stream(fixed_jitter& jitter, fixed_pool& pool, const unsigned packets, counts& c)
+{
+    uint8       data[PACKET_BYTES];
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(data);
+    rawrtp_ptr  out;
+    timepoint   arrival = stdclock::now();
+
+    memset(data, 0xff, sizeof(data));
+    rtp->flags = htons((RTP_VERSION << 14) | RTP_PAYLOAD_G711U);
+    rtp->ssrc = htonl(0x1234);
+
+    for (unsigned i = 0; i < packets; ++i) {
+        uint16 sequence = sequence_at(i);
+
+        if ((i % 50) != 49) {
+            rtp->sequence = htons(sequence);
+            rtp->timestamp = htonl((uint32)sequence * 160);
+
+            rawrtp_ptr p = pool.acquire(data, sizeof(data));
+            RTPJitter::RESULT rc = p ? jitter.push(move(p), arrival) : RTPJitter::BUFFER_OVERFLOW;
+            c.overflows += (rc == RTPJitter::BUFFER_OVERFLOW) ? 1 : 0;
+        }
+
+        // pop at the packet rate, except during the overflow bursts
+        if ((i % 1000) >= 40) {
+            RTPJitter::RESULT rc = jitter.pop(out, arrival);
+            out.reset();
+            c.popped += (rc == RTPJitter::SUCCESS) ? 1 : 0;
+            c.dropped += (rc == RTPJitter::DROPPED_PACKET) ? 1 : 0;
+        }
+        if ((i % 20000) == 19999) {
+            c.out_of_order += jitter.out_of_order_count();
+            jitter.reset();
+            c.resets++;
+        }
+        arrival += clocks::milliseconds(PACKET_MS);
+    }
+    c.out_of_order += jitter.out_of_order_count();
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned packets = (argc > 1) ? atoi(argv[1]) : 100000;
+
+    // the library logs to stdout; keep the output to failures
+    if (freopen("/dev/null", "w", stdout) == nullptr) {
+        return 1;
+    }
+
+    static fixed_pool   pool;
+    static fixed_jitter jitter(DEPTH_MS);
+    counts              c;
+
+    memset(&c, 0, sizeof(c));
+
+    // the one allocation a media thread may make: its event log ring, set
+    //  up front as such threads do.  Everything after it is steady state.
+    RTPLog::attach_thread();
+
+    uint64 before = allocations;
+    stream(jitter, pool, packets, c);
+    uint64 allocated = allocations - before;
+
+    unsigned failures = 0;
+    if (allocated != 0) {
+        fprintf(stderr, "test_fixed: %llu allocations in steady state\n", (unsigned long long)allocated);
+        ++failures;
+    }
+    if ((c.popped == 0) || (c.out_of_order == 0) || (c.overflows == 0) || (c.dropped == 0) || (c.resets == 0)) {
+        fprintf(stderr, "test_fixed: stream missed a path: popped %llu, out of order %llu, overflows %llu, dropped %llu, resets %llu\n",
+                (unsigned long long)c.popped, (unsigned long long)c.out_of_order, (unsigned long long)c.overflows,
+                (unsigned long long)c.dropped, (unsigned long long)c.resets);
+        ++failures;
+    }
+    if (failures != 0) {
+        return 1;
+    }
+    fprintf(stderr, "test_fixed: all checks passed\n");
+    return 0;
+}
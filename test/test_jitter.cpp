@@ -0,0 +1,360 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   behaviour checks for RTPJitter push()/pop().
+*
+*   usage: test_jitter
+*
+*   Each case drives a buffer through a fixed sequence of pushes and pops at
+*   one instant and checks the result codes and the order packets come
+*   out in.  Failures are written to stderr; the exit status is 1 if any
+*   check failed, so 'make check' stops on it.
+*
+******************************************************************************/
+
+#include "rtp_jitter.h"
+#include <cstdio>
+#include <cstring>
+#include <arpa/inet.h>
+
+using namespace std;
+
+
+static const unsigned   PACKET_BYTES = 172;
+static const unsigned   PACKET_MS    = 20;
+static const unsigned   DEPTH_MS     = 60;
+
+static unsigned         failures = 0;
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n",                    \
+                    __FILE__, __LINE__, __func__, #cond);                       \
+            ++failures;                                                         \
+        }                                                                       \
+    } while (0)
+
+
+static rawrtp_ptr make_packet(const uint16 sequence, const uint32 timestamp)
+{
+    uint8       data[PACKET_BYTES];
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(data);
+
+    memset(data, 0xff, sizeof(data));
+    rtp->flags = htons((RTP_VERSION << 14) | RTP_PAYLOAD_G711U);
+    rtp->sequence = htons(sequence);
+    rtp->timestamp = htonl(timestamp);
+    rtp->ssrc = htonl(0x1234);
+
+    rawrtp_ptr packet = make_shared<RTPPacket>(data, sizeof(data));
+    packet->payload_ms = PACKET_MS;
+    packet->payload_bytes = PACKET_BYTES - RTP_HEADER_LENGTH;
+    return packet;
+}
+
+// 8 kHz audio, one packet per PACKET_MS
+static rawrtp_ptr make_packet(const uint16 sequence)
+{
+    return make_packet(sequence, (uint32)sequence * 8 * PACKET_MS);
+}
+
+static uint16 sequence_of(const rawrtp_ptr& packet)
+{
+    return ntohs(reinterpret_cast<RTPHeader *>(packet->pData)->sequence);
+}
+
+// pops one packet and checks it is 'sequence'
+static bool pops(RTPJitter& jitter, const timepoint now, const uint16 sequence)
+{
+    rawrtp_ptr packet;
+    return (jitter.pop(packet, now) == RTPJitter::SUCCESS) && packet && (sequence_of(packet) == sequence);
+}
+
+// pops and checks the next packet was reported missing
+static bool drops(RTPJitter& jitter, const timepoint now)
+{
+    rawrtp_ptr packet;
+    return (jitter.pop(packet, now) == RTPJitter::DROPPED_PACKET);
+}
+
+
+
+// - out of order ---------------------------------------------------------------
+
+// a packet that arrives after the one behind it was popped, but before its
+//  own turn, still plays in order
+static void late_but_playable()
+{
+    RTPJitter   jitter(DEPTH_MS);
+    timepoint   t = stdclock::now();
+
+    CHECK(jitter.push(make_packet(1), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.push(make_packet(3), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.push(make_packet(4), t) == RTPJitter::SUCCESS);
+    CHECK(pops(jitter, t, 1));
+
+    CHECK(jitter.push(make_packet(2), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.out_of_order_count() == 1);
+    CHECK(pops(jitter, t, 2));
+    CHECK(pops(jitter, t, 3));
+    CHECK(pops(jitter, t, 4));
+    CHECK(jitter.dropped_count() == 0);
+}
+
+// one that arrives after its turn has gone is refused
+static void already_played()
+{
+    RTPJitter   jitter(DEPTH_MS);
+    timepoint   t = stdclock::now();
+
+    for (uint16 sequence = 1; sequence <= 4; ++sequence) {
+        CHECK(jitter.push(make_packet(sequence), t) == RTPJitter::SUCCESS);
+    }
+    CHECK(pops(jitter, t, 1));
+    CHECK(pops(jitter, t, 2));
+
+    CHECK(jitter.push(make_packet(1), t) == RTPJitter::BAD_PACKET);
+    CHECK(jitter.push(make_packet(2), t) == RTPJitter::BAD_PACKET);
+    CHECK(pops(jitter, t, 3));
+    CHECK(pops(jitter, t, 4));
+}
+
+// once the buffer has run dry, an old packet must not start it again and be
+//  played twice; a new one, or a source that jumped well back, does
+static void empty_buffer_restart()
+{
+    RTPJitter   jitter(DEPTH_MS);
+    timepoint   t = stdclock::now();
+
+    for (uint16 sequence = 1; sequence <= 3; ++sequence) {
+        CHECK(jitter.push(make_packet(sequence), t) == RTPJitter::SUCCESS);
+    }
+    CHECK(pops(jitter, t, 1));
+    CHECK(pops(jitter, t, 2));
+    CHECK(pops(jitter, t, 3));
+    CHECK(jitter.get_depth() == 0);
+
+    CHECK(jitter.push(make_packet(2), t) == RTPJitter::BAD_PACKET);
+    CHECK(jitter.get_depth() == 0);
+
+    for (uint16 sequence = 4; sequence <= 6; ++sequence) {
+        CHECK(jitter.push(make_packet(sequence), t) == RTPJitter::SUCCESS);
+    }
+    CHECK(pops(jitter, t, 4));
+    CHECK(pops(jitter, t, 5));
+    CHECK(pops(jitter, t, 6));
+
+    // a jump back further than any reordering is a restarted source
+    for (uint16 sequence = 5000; sequence <= 5002; ++sequence) {
+        CHECK(jitter.push(make_packet(sequence), t) == RTPJitter::SUCCESS);
+    }
+    for (uint16 sequence = 5000; sequence <= 5002; ++sequence) {
+        CHECK(pops(jitter, t, sequence));
+    }
+    for (uint16 sequence = 1000; sequence <= 1002; ++sequence) {
+        CHECK(jitter.push(make_packet(sequence), t) == RTPJitter::SUCCESS);
+    }
+    CHECK(pops(jitter, t, 1000));
+}
+
+
+
+// - sequence wrap --------------------------------------------------------------
+
+// 65535 is followed by 0, not preceded by it
+static void wrap_in_order()
+{
+    RTPJitter   jitter(DEPTH_MS);
+    timepoint   t = stdclock::now();
+    uint16      sequence;
+
+    sequence = 65533;
+    for (int i = 0; i < 6; ++i) {
+        CHECK(jitter.push(make_packet(sequence++), t) == RTPJitter::SUCCESS);
+    }
+    sequence = 65533;
+    for (int i = 0; i < 6; ++i) {
+        CHECK(pops(jitter, t, sequence++));
+    }
+    CHECK(jitter.out_of_order_count() == 0);
+    CHECK(jitter.dropped_count() == 0);
+}
+
+// with 65535 and 0 both lost, the packets either side still line up: two
+//  drops are reported and play carries on from 1
+static void wrap_loss_both_sides()
+{
+    RTPJitter   jitter(DEPTH_MS);
+    timepoint   t = stdclock::now();
+
+    CHECK(jitter.push(make_packet(65533), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.push(make_packet(65534), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.push(make_packet(1), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.push(make_packet(2), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.out_of_order_count() == 0);
+
+    CHECK(pops(jitter, t, 65533));
+    CHECK(pops(jitter, t, 65534));
+    CHECK(drops(jitter, t));
+    CHECK(drops(jitter, t));
+    CHECK(pops(jitter, t, 1));
+    CHECK(pops(jitter, t, 2));
+    CHECK(jitter.dropped_count() == 2);
+
+    // and the lost ones turning up now are too late
+    CHECK(jitter.push(make_packet(65535), t) == RTPJitter::BAD_PACKET);
+    CHECK(jitter.push(make_packet(0), t) == RTPJitter::BAD_PACKET);
+}
+
+// reordered packets find their place across the wrap, at the front of the
+//  buffer and in the middle of it
+static void wrap_reordered()
+{
+    RTPJitter   jitter(DEPTH_MS);
+    timepoint   t = stdclock::now();
+
+    CHECK(jitter.push(make_packet(65534), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.push(make_packet(0), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.push(make_packet(2), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.push(make_packet(65535), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.push(make_packet(1), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.push(make_packet(65533), t) == RTPJitter::SUCCESS);
+    CHECK(jitter.out_of_order_count() == 3);
+
+    CHECK(pops(jitter, t, 65533));
+    CHECK(pops(jitter, t, 65534));
+    CHECK(pops(jitter, t, 65535));
+    CHECK(pops(jitter, t, 0));
+    CHECK(pops(jitter, t, 1));
+    CHECK(pops(jitter, t, 2));
+    CHECK(jitter.dropped_count() == 0);
+}
+
+
+
+// - interarrival jitter -------------------------------------------------------
+
+// RFC 3550 6.4.1: J += (|D| - J) / 16, with D the change in transit time in
+//  timestamp units (8 per ms here).  Packets are sent every 160 units, the
+//  timestamps wrapping past 2^32 on the way, and arrive at:
+//
+//      ms      0    20    45    60    80   110   130
+//      |D|     -     0    40    40     0    80     0
+//      J       0     0  2.50  4.84  4.54  9.26  8.68
+//
+//  jitter() and max_jitter() are J truncated to whole timestamp units.
+static void interarrival_jitter()
+{
+    static const unsigned arrival_ms[] = { 0, 20, 45, 60, 80, 110, 130 };
+
+    RTPJitter   jitter(DEPTH_MS);
+    timepoint   start = stdclock::now();
+    uint32      timestamp = 0xffffff00;
+
+    for (uint16 i = 0; i < sizeof(arrival_ms) / sizeof(arrival_ms[0]); ++i) {
+        timepoint arrival = start + clocks::milliseconds(arrival_ms[i]);
+        CHECK(jitter.push(make_packet(i, timestamp), arrival) == RTPJitter::SUCCESS);
+        timestamp += 8 * PACKET_MS;
+    }
+    CHECK(jitter.jitter() == 8);
+    CHECK(jitter.max_jitter() == 9);
+    CHECK(jitter.snapshot().jitter == 8);
+
+    // a steady stream has none
+    RTPJitter   steady(DEPTH_MS);
+
+    for (uint16 i = 0; i < 6; ++i) {
+        CHECK(steady.push(make_packet(i), start + clocks::milliseconds(i * PACKET_MS)) == RTPJitter::SUCCESS);
+    }
+    CHECK(steady.jitter() == 0);
+    CHECK(steady.max_jitter() == 0);
+}
+
+
+
+// - memory budget --------------------------------------------------------------
+
+// the budget counts only the packets, which dropping can free, and never
+//  takes the buffer below its nominal depth
+static void memory_budget()
+{
+    const uint64    cost = sizeof(RTPPacket) + PACKET_BYTES;
+    timepoint       t = stdclock::now();
+
+    // room for three packets, nominal depth one: the fourth push sheds one
+    RTPJitter       roomy(PACKET_MS);
+
+    roomy.set_memory_budget(3 * cost);
+    for (uint16 sequence = 1; sequence <= 3; ++sequence) {
+        CHECK(roomy.push(make_packet(sequence), t) == RTPJitter::SUCCESS);
+    }
+    CHECK(roomy.memory_bytes() > 3 * cost);     // the object and its queue, too
+    CHECK(roomy.push(make_packet(4), t) == RTPJitter::BUFFER_OVERFLOW);
+    CHECK(roomy.overflow_count() == 1);
+    CHECK(roomy.get_depth() == 3);
+    CHECK(pops(roomy, t, 2));
+
+    // a budget below even one packet still leaves the nominal depth, plus
+    //  the packet being pushed, to play
+    RTPJitter       tight(DEPTH_MS);
+
+    tight.set_memory_budget(1);
+    for (uint16 sequence = 1; sequence <= 3; ++sequence) {
+        CHECK(tight.push(make_packet(sequence), t) == RTPJitter::SUCCESS);
+    }
+    CHECK(tight.push(make_packet(4), t) == RTPJitter::SUCCESS);
+    CHECK(tight.push(make_packet(5), t) == RTPJitter::BUFFER_OVERFLOW);
+    CHECK(tight.overflow_count() == 1);
+    CHECK(tight.get_depth() == 4);
+    for (uint16 sequence = 2; sequence <= 5; ++sequence) {
+        CHECK(pops(tight, t, sequence));
+    }
+}
+
+
+
+int main()
+{
+    // the library logs to stdout; keep the output to failures
+    if (freopen("/dev/null", "w", stdout) == nullptr) {
+        return 1;
+    }
+
+    late_but_playable();
+    already_played();
+    empty_buffer_restart();
+    wrap_in_order();
+    wrap_loss_both_sides();
+    wrap_reordered();
+    interarrival_jitter();
+    memory_budget();
+
+    if (failures != 0) {
+        fprintf(stderr, "test_jitter: %u check(s) failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "test_jitter: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,147 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   -----
+*
+*   stress check for RTPPlayoutScheduler::remove().
+*
+*   usage: test_playout [seconds]
+*
+*   Client threads add a stream with a 1 ms ptime to a running scheduler,
+*   let it play for a moment, remove() it and destroy its buffer, over and
+*   over.  Once remove() has returned, no callback may run for that stream
+*   again -- its buffer is gone.  Every callback checks that its stream is
+*   still live; the exit status is 1 if one was not, or if a stream never
+*   played at all.
+*
+******************************************************************************/
+
+#include "rtp_playout.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+
+static const unsigned   CLIENTS = 4;
+static const unsigned   SLOTS   = 16;       // streams each client keeps going
+
+// one stream: live while 'generation' matches the one its callback captured
+struct slot
+{
+    unique_ptr<RTPJitter>   jitter;
+    atomic<uint64>          generation;
+    RTPPlayoutScheduler::stream_id id;
+};
+
+static atomic<uint64>   late_callbacks(0);
+static atomic<uint64>   callbacks(0);
+
+
+static void client(RTPPlayoutScheduler& scheduler, const unsigned index, const clocks::steady_clock::time_point end)
+{
+    mt19937         rng(index);
+    vector<slot>    slots(SLOTS);
+    uint64          generation = (uint64)index << 48;
+
+    for (slot& sl : slots) {
+        sl.generation = 0;
+    }
+
+    while (clocks::steady_clock::now() < end) {
+        slot& sl = slots[rng() % SLOTS];
+
+        if (sl.jitter) {
+            scheduler.remove(sl.id);
+            sl.generation.store(0);
+            sl.jitter.reset();
+            continue;
+        }
+
+        uint64 mine = ++generation;
+        sl.jitter.reset(new RTPJitter(20));
+        sl.generation.store(mine);
+
+        atomic<uint64> *live = &sl.generation;
+        sl.id = scheduler.add(sl.jitter.get(), 1,
+                              [live, mine](RTPPlayoutScheduler::stream_id, RTPJitter&, RTPJitter::RESULT, rawrtp_ptr&) {
+                                  if (live->load() != mine) {
+                                      ++late_callbacks;
+                                  }
+                                  ++callbacks;
+                              });
+
+        if ((rng() % 4) == 0) {
+            this_thread::sleep_for(clocks::microseconds(rng() % 2000));
+        }
+    }
+
+    for (slot& sl : slots) {
+        if (sl.jitter) {
+            scheduler.remove(sl.id);
+            sl.generation.store(0);
+            sl.jitter.reset();
+        }
+    }
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    unsigned seconds = (argc > 1) ? (unsigned)atoi(argv[1]) : 2;
+
+    // the library logs to stdout; keep the output to failures
+    if (freopen("/dev/null", "w", stdout) == nullptr) {
+        return 1;
+    }
+
+    RTPPlayoutScheduler scheduler(2);
+    if (!scheduler.start()) {
+        fprintf(stderr, "test_playout: scheduler would not start\n");
+        return 1;
+    }
+
+    auto            end = clocks::steady_clock::now() + clocks::seconds(seconds);
+    vector<thread>  clients;
+
+    for (unsigned i = 0; i < CLIENTS; ++i) {
+        clients.emplace_back(client, ref(scheduler), i, end);
+    }
+    for (thread& t : clients) {
+        t.join();
+    }
+    scheduler.stop();
+
+    if ((late_callbacks != 0) || (callbacks == 0)) {
+        fprintf(stderr, "test_playout: %llu of %llu callbacks ran after remove() returned\n",
+                (unsigned long long)late_callbacks.load(), (unsigned long long)callbacks.load());
+        return 1;
+    }
+    fprintf(stderr, "test_playout: all checks passed (%llu callbacks)\n", (unsigned long long)callbacks.load());
+    return 0;
+}
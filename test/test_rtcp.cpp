@@ -0,0 +1,339 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   -----
+*
+*   behaviour checks for RTCP receiver reports.
+*
+*   usage: test_rtcp
+*
+*   Pushes known sequence runs through an RTPJitter and checks the report
+*   block it fills against RFC 3550 appendix A.1 and A.3, worked out by hand
+*   in the comment above each case: sequence cycles, resync after a large
+*   jump, cumulative and fractional loss, and LSR/DLSR taken from a
+*   compound RTCP packet.  Failures are written to stderr; the exit status
+*   is 1 if any check failed.
+*
+******************************************************************************/
+
+#include "rtp_jitter.h"
+#include "rtp_rtcp.h"
+#include <cstdio>
+#include <cstring>
+#include <arpa/inet.h>
+
+using namespace std;
+
+
+static const unsigned   PACKET_BYTES = 172;
+static const unsigned   PACKET_MS    = 20;
+static const unsigned   DEPTH_MS     = 60;
+static const uint32     SSRC         = 0x1234;
+
+static unsigned         failures = 0;
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n",                    \
+                    __FILE__, __LINE__, __func__, #cond);                       \
+            ++failures;                                                         \
+        }                                                                       \
+    } while (0)
+
+
+static rawrtp_ptr make_packet(const uint16 sequence)
+{
+    uint8       data[PACKET_BYTES];
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(data);
+
+    memset(data, 0xff, sizeof(data));
+    rtp->flags = htons((RTP_VERSION << 14) | RTP_PAYLOAD_G711U);
+    rtp->sequence = htons(sequence);
+    rtp->timestamp = htonl((uint32)sequence * 8 * PACKET_MS);
+    rtp->ssrc = htonl(SSRC);
+
+    rawrtp_ptr packet = make_shared<RTPPacket>(data, sizeof(data));
+    packet->payload_ms = PACKET_MS;
+    packet->payload_bytes = PACKET_BYTES - RTP_HEADER_LENGTH;
+    return packet;
+}
+
+static void push(RTPJitter& jitter, const uint16 sequence)
+{
+    jitter.push(make_packet(sequence), stdclock::now());
+}
+
+// the report block's fields, in host order
+struct report
+{
+    bool    filled;
+    uint32  ssrc;
+    uint32  fraction;
+    int32   cumulative;         // sign-extended from 24 bits
+    uint32  highest;
+    uint32  lsr;
+    uint32  dlsr;
+};
+
+static report take(RTPJitter& jitter, const timepoint now = stdclock::now(), const RTCPSenderTracker *sender = nullptr)
+{
+    RTCPReportBlock block;
+    report          r;
+
+    memset(&block, 0, sizeof(block));
+    r.filled = jitter.report(block, now, sender);
+    r.ssrc = ntohl(block.ssrc);
+    r.fraction = ntohl(block.lost) >> 24;
+    r.cumulative = (int32)(ntohl(block.lost) << 8) >> 8;
+    r.highest = ntohl(block.highest_sequence);
+    r.lsr = ntohl(block.lsr);
+    r.dlsr = ntohl(block.dlsr);
+    return r;
+}
+
+
+
+// - RFC 3550 A.1 / A.3 --------------------------------------------------------
+
+// nothing to report on before the first packet
+static void no_source()
+{
+    RTPJitter jitter(DEPTH_MS);
+
+    CHECK(!take(jitter).filled);
+}
+
+// 65530 ... 65535, 0 ... 9: the wrap adds a cycle
+//
+//      extended highest    1 << 16 | 9 = 65545
+//      expected            65545 - 65530 + 1 = 16, all received
+static void cycles_on_wrap()
+{
+    RTPJitter jitter(DEPTH_MS);
+
+    for (uint16 sequence = 65530; sequence != 10; ++sequence) {
+        push(jitter, sequence);
+    }
+    report r = take(jitter);
+    CHECK(r.filled);
+    CHECK(r.ssrc == SSRC);
+    CHECK(r.highest == 65545);
+    CHECK(r.cumulative == 0);
+    CHECK(r.fraction == 0);
+}
+
+// fraction lost is per report interval, cumulative lost is not
+//
+//      interval    received            expected   lost   fraction          cumulative
+//      1 ... 10    all but 4, 7 (8)    10         2      (2 << 8) / 10 = 51     2
+//      11 ... 20   all (10)            10         0      0                      2
+//      21 ... 30   21-24, 30 (5)       10         5      (5 << 8) / 10 = 128    7
+//      no packets                       0         0      0                      7
+static void loss_per_interval()
+{
+    RTPJitter   jitter(DEPTH_MS);
+    report      r;
+
+    for (uint16 sequence = 1; sequence <= 10; ++sequence) {
+        if ((sequence != 4) && (sequence != 7)) {
+            push(jitter, sequence);
+        }
+    }
+    r = take(jitter);
+    CHECK((r.highest == 10) && (r.cumulative == 2) && (r.fraction == 51));
+
+    for (uint16 sequence = 11; sequence <= 20; ++sequence) {
+        push(jitter, sequence);
+    }
+    r = take(jitter);
+    CHECK((r.highest == 20) && (r.cumulative == 2) && (r.fraction == 0));
+
+    for (uint16 sequence = 21; sequence <= 30; ++sequence) {
+        if ((sequence <= 24) || (sequence == 30)) {
+            push(jitter, sequence);
+        }
+    }
+    r = take(jitter);
+    CHECK((r.highest == 30) && (r.cumulative == 7) && (r.fraction == 128));
+
+    r = take(jitter);
+    CHECK((r.highest == 30) && (r.cumulative == 7) && (r.fraction == 0));
+}
+
+// duplicates count as received, so loss goes negative; fraction does not
+//
+//      1 ... 5, then 5 five more times: expected 5, received 10
+//      cumulative  5 - 10 = -5 (0xfffffb in 24 bits), fraction 0
+static void duplicates()
+{
+    RTPJitter jitter(DEPTH_MS);
+
+    for (uint16 sequence = 1; sequence <= 5; ++sequence) {
+        push(jitter, sequence);
+    }
+    for (int i = 0; i < 5; ++i) {
+        push(jitter, 5);
+    }
+    report r = take(jitter);
+    CHECK((r.highest == 5) && (r.cumulative == -5) && (r.fraction == 0));
+}
+
+// a jump of MAX_DROPOUT or more is ignored unless the next packet follows
+//  it, in which case the source restarted and counting starts over
+//
+//      1 ... 5, 40000, 6 ... 8     40000 ignored: highest 8, nothing lost
+//      then 40000 ... 40004        40000 ignored again, 40001 follows it:
+//                                  base 40001, expected 4, received 4
+static void dropout_resync()
+{
+    RTPJitter   jitter(DEPTH_MS);
+    report      r;
+
+    for (uint16 sequence = 1; sequence <= 5; ++sequence) {
+        push(jitter, sequence);
+    }
+    push(jitter, 40000);
+    for (uint16 sequence = 6; sequence <= 8; ++sequence) {
+        push(jitter, sequence);
+    }
+    r = take(jitter);
+    CHECK((r.highest == 8) && (r.cumulative == 0) && (r.fraction == 0));
+
+    for (uint16 sequence = 40000; sequence <= 40004; ++sequence) {
+        push(jitter, sequence);
+    }
+    r = take(jitter);
+    CHECK(r.highest == 40004);
+    CHECK(r.cumulative == 0);
+    CHECK(r.fraction == 0);
+}
+
+// cumulative lost is 24 bits signed and clamps rather than wraps
+//
+//      3000 packets 1, 3000, 5999, ... (steps of 2999, under MAX_DROPOUT)
+//      extended highest    1 + 2999 * 2999 = 8994002
+//      expected            2999 * 2999 + 1 = 8994002, received 3000
+//      lost                8991002, over 0x7fffff so clamped to 8388607
+//      fraction            (8991002 << 8) / 8994002 = 255
+static void cumulative_clamp()
+{
+    RTPJitter   jitter(DEPTH_MS);
+    uint16      sequence = 1;
+
+    for (int i = 0; i < 3000; ++i) {
+        push(jitter, sequence);
+        sequence += 2999;
+    }
+    report r = take(jitter);
+    CHECK(r.highest == 8994002);
+    CHECK(r.cumulative == 0x7fffff);
+    CHECK(r.fraction == 255);
+}
+
+
+
+// - LSR / DLSR ------------------------------------------------------------------
+
+static unsigned put_header(uint8 *p, const uint8 count, const uint8 type, const unsigned bytes, const uint32 ssrc)
+{
+    uint16 length = htons((uint16)(bytes / 4 - 1));
+    uint32 s = htonl(ssrc);
+
+    memset(p, 0, bytes);
+    p[0] = (uint8)((2 << 6) | count);
+    p[1] = type;
+    memcpy(p + 2, &length, sizeof(length));
+    memcpy(p + 4, &s, sizeof(s));
+    return bytes;
+}
+
+// RR + SR + SDES, the SR's NTP timestamp 0x12345678.9abcdef0
+//
+//      LSR     middle 32 bits = 0x56789abc
+//      DLSR    1.5 s after it arrived = 1.5 * 65536 = 98304
+static void sender_report()
+{
+    static const uint32 SENDER = 0x5555;
+
+    uint8       packet[128];
+    unsigned    len = 0;
+    uint32      word;
+
+    len += put_header(packet + len, 1, RTCP_PT_RR, RTCP_HEADER_LENGTH + sizeof(RTCPReportBlock), 0x7777);
+    len += put_header(packet + len, 0, RTCP_PT_SR, 28, SENDER);
+    word = htonl(0x12345678);
+    memcpy(packet + len - 20, &word, sizeof(word));
+    word = htonl(0x9abcdef0);
+    memcpy(packet + len - 16, &word, sizeof(word));
+    len += put_header(packet + len, 1, 202, 12, SENDER);
+
+    const timepoint arrival(clocks::seconds(1000));
+    RTCPSenderTracker tracker;
+
+    CHECK(tracker.lsr() == 0);
+    CHECK(tracker.dlsr(arrival) == 0);
+    CHECK(!tracker.on_rtcp(packet, len, arrival, 0x9999));         // someone else's
+    CHECK(!tracker.on_rtcp(packet, 52, arrival, SENDER));           // cut off inside the SR
+    CHECK(tracker.lsr() == 0);
+    CHECK(tracker.on_rtcp(packet, len, arrival, SENDER));
+    CHECK(tracker.lsr() == 0x56789abc);
+    CHECK(tracker.dlsr(arrival + clocks::milliseconds(1500)) == 98304);
+
+    // and into the report block
+    RTPJitter jitter(DEPTH_MS);
+    push(jitter, 1);
+
+    report r = take(jitter, arrival + clocks::milliseconds(1500), &tracker);
+    CHECK(r.lsr == 0x56789abc);
+    CHECK(r.dlsr == 98304);
+
+    r = take(jitter, arrival);
+    CHECK((r.lsr == 0) && (r.dlsr == 0));
+}
+
+
+
+int main()
+{
+    // the library logs to stdout; keep the output to failures
+    if (freopen("/dev/null", "w", stdout) == nullptr) {
+        return 1;
+    }
+
+    no_source();
+    cycles_on_wrap();
+    loss_per_interval();
+    duplicates();
+    dropout_resync();
+    cumulative_clamp();
+    sender_report();
+
+    if (failures != 0) {
+        fprintf(stderr, "test_rtcp: %u check(s) failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "test_rtcp: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,416 @@
+/******************************************************************************
+*   Copyright (c) 2013-2015 thundernet development group, inc.
+*   http://thundernet.com
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   1. The above copyright notice and this permission notice shall be included
+*      in all copies or substantial portions of the Software.
+*
+*   2. THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+*      OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*      IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+*      CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+*      TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+*      SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*   -----
+*
+*   -----
+*
+*   behaviour checks for RTPTimerWheel and RTPPlayoutWheel.
+*
+*   usage: test_timer
+*
+*   Drives the wheels on a simulated clock of 1 ms ticks.  Timers are set on
+*   either side of every level boundary and past the top level.  The wheel
+*   is advanced a tick at a time, and in random jumps that take the skip-ahead
+*   path.  Each timer must fire exactly once: never before its deadline, and
+*   no later than the first advance() that reaches its tick.  The playout
+*   wheel is taken through its idle, waiting and playing states.
+*   Failures are written to stderr; the exit status is 1 if any check failed.
+*
+******************************************************************************/
+
+#include "rtp_playout.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <arpa/inet.h>
+
+using namespace std;
+
+
+static const unsigned   PACKET_BYTES = 172;
+static const unsigned   PACKET_MS    = 20;
+static const unsigned   DEPTH_MS     = 60;
+
+static const timepoint  T0 = stdclock::now();
+static const uint64     TOP = 1ULL << (RTPTimerWheel::SLOT_BITS * RTPTimerWheel::LEVELS);   // ticks the levels span
+
+static unsigned         failures = 0;
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n",                    \
+                    __FILE__, __LINE__, __func__, #cond);                       \
+            ++failures;                                                         \
+        }                                                                       \
+    } while (0)
+
+
+// the start of tick 'n'
+static timepoint at(const uint64 n)
+{
+    return T0 + clocks::milliseconds(n);
+}
+
+// the first tick boundary at or after 't', where a timer for 't' is due
+static timepoint due(const timepoint t)
+{
+    int64 ns = clocks::duration_cast<clocks::nanoseconds>(t - T0).count();
+    return at((uint64)((ns + 999999) / 1000000));
+}
+
+// one timer and when it went off
+struct probe
+{
+    RTPTimerWheel::timer    timer;
+    timepoint               deadline;
+    timepoint               fired_at;
+    unsigned                fired;
+};
+
+static void arm(RTPTimerWheel& wheel, probe& p, const timepoint deadline)
+{
+    p.deadline = deadline;
+    p.fired_at = timepoint::min();
+    p.fired = 0;
+    p.timer.on_expiry = [&p](RTPTimerWheel::timer&, const timepoint now) {
+        p.fired_at = now;
+        p.fired++;
+    };
+    wheel.schedule(p.timer, deadline);
+}
+
+
+
+// - RTPTimerWheel ---------------------------------------------------------------
+
+// timers either side of each level's span, set from tick 'start', fire at
+//  their tick exactly when the wheel is advanced one tick at a time -- at or
+//  after the deadline, and less than one tick after it
+static void level_boundaries(const uint64 start)
+{
+    static const uint64 distances[] = {
+        0, 1, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 262145,
+        TOP - 1, TOP, TOP + 4097
+    };
+    static const unsigned COUNT = sizeof(distances) / sizeof(distances[0]);
+
+    RTPTimerWheel   wheel(T0);
+    probe           probes[COUNT];
+
+    wheel.advance(at(start));
+    const uint64 now = start + 1;       // the next tick to run
+    CHECK(wheel.now() == at(now));
+
+    for (unsigned i = 0; i < COUNT; ++i) {
+        // every other one between ticks, to be rounded up
+        timepoint deadline = at(now + distances[i]) - clocks::microseconds((i & 1) ? 300 : 0);
+        arm(wheel, probes[i], deadline);
+    }
+    CHECK(wheel.pending() == COUNT);
+
+    const uint64 last = now + TOP + 4097;
+    for (uint64 tick = now; tick <= last; ++tick) {
+        wheel.advance(at(tick));
+    }
+
+    for (unsigned i = 0; i < COUNT; ++i) {
+        const probe& p = probes[i];
+        if (p.fired != 1) {
+            fprintf(stderr, "level_boundaries(%llu): distance %llu fired %u times\n",
+                    (unsigned long long)start, (unsigned long long)distances[i], p.fired);
+            ++failures;
+            continue;
+        }
+        if ((p.fired_at < p.deadline) || (p.fired_at - p.deadline >= clocks::milliseconds(1)) || (p.fired_at != due(p.deadline))) {
+            fprintf(stderr, "level_boundaries(%llu): distance %llu fired %lld ns from its deadline\n",
+                    (unsigned long long)start, (unsigned long long)distances[i],
+                    (long long)clocks::duration_cast<clocks::nanoseconds>(p.fired_at - p.deadline).count());
+            ++failures;
+        }
+    }
+    CHECK(wheel.pending() == 0);
+}
+
+// advance() in jumps of up to 20000 ticks, at times between ticks, skips
+//  the empty stretches -- but a timer still fires at the first advance()
+//  that reaches its tick, and never before its deadline
+static void skip_ahead()
+{
+    static const unsigned COUNT = 2000;
+
+    RTPTimerWheel   wheel(T0);
+    vector<probe>   probes(COUNT);
+    mt19937_64      rng(7);
+
+    for (unsigned i = 0; i < COUNT; ++i) {
+        // mostly within the levels, some parked past the top
+        uint64 ns = rng() % ((i % 10) ? (1ULL << 20) : (TOP + 300000)) * 1000000 + rng() % 1000000;
+        arm(wheel, probes[i], T0 + clocks::nanoseconds(ns));
+    }
+
+    timepoint previous = T0;
+    timepoint now = T0;
+    while (wheel.pending() != 0) {
+        now += clocks::microseconds(rng() % 20000000 + 1);
+        wheel.advance(now);
+
+        for (probe& p : probes) {
+            if ((p.fired != 0) && (p.fired_at == now)) {
+                CHECK(p.deadline <= now);
+                CHECK(previous < due(p.deadline));
+            }
+        }
+        for (probe& p : probes) {
+            // nothing left behind that this advance() has passed
+            if (p.fired == 0) {
+                CHECK(due(p.deadline) > now);
+            }
+        }
+        previous = now;
+    }
+
+    for (const probe& p : probes) {
+        CHECK(p.fired == 1);
+    }
+}
+
+// callbacks may re-arm their own timer, re-arm for a time already past, or
+//  cancel or move a timer that is due at the same tick and not yet fired
+static void rearm_and_cancel_in_callback()
+{
+    RTPTimerWheel   wheel(T0);
+
+    // a periodic timer re-arms itself every 20 ticks
+    RTPTimerWheel::timer    periodic;
+    vector<timepoint>       fired;
+    timepoint               next = at(20);
+
+    periodic.on_expiry = [&](RTPTimerWheel::timer& t, const timepoint now) {
+        fired.push_back(now);
+        next += clocks::milliseconds(20);
+        wheel.schedule(t, next);
+    };
+    wheel.schedule(periodic, next);
+    for (uint64 tick = 0; tick <= 1000; ++tick) {
+        wheel.advance(at(tick));
+    }
+    CHECK(fired.size() == 50);
+    for (size_t i = 0; i < fired.size(); ++i) {
+        CHECK(fired[i] == at(20 * (i + 1)));
+    }
+    wheel.cancel(periodic);
+    CHECK(!periodic.pending());
+
+    // one re-armed for a time already gone fires on the next advance()
+    RTPTimerWheel::timer    again;
+    unsigned                again_count = 0;
+
+    again.on_expiry = [&](RTPTimerWheel::timer& t, const timepoint now) {
+        if (++again_count == 1) {
+            wheel.schedule(t, now - clocks::milliseconds(5));
+        }
+    };
+    wheel.schedule(again, at(1002));
+    wheel.advance(at(1002));
+    CHECK(again_count == 1);
+    CHECK(again.pending());
+    wheel.advance(at(1003));
+    CHECK(again_count == 2);
+    CHECK(!again.pending());
+
+    // two due at the same tick: whichever fires first cancels the other
+    RTPTimerWheel::timer    a, b;
+    unsigned                a_count = 0, b_count = 0;
+
+    a.on_expiry = [&](RTPTimerWheel::timer&, const timepoint) { ++a_count; wheel.cancel(b); };
+    b.on_expiry = [&](RTPTimerWheel::timer&, const timepoint) { ++b_count; wheel.cancel(a); };
+    wheel.schedule(a, at(1010));
+    wheel.schedule(b, at(1010));
+    wheel.advance(at(1010));
+    CHECK(a_count + b_count == 1);
+    CHECK(!a.pending() && !b.pending());
+    CHECK(wheel.pending() == 0);
+
+    // ... or moves it on, and it fires then instead
+    timepoint moved_at = timepoint::min();
+
+    a_count = b_count = 0;
+    a.on_expiry = [&](RTPTimerWheel::timer&, const timepoint) { ++a_count; if (b.pending()) wheel.schedule(b, at(1030)); };
+    b.on_expiry = [&](RTPTimerWheel::timer&, const timepoint now) { ++b_count; moved_at = now; if (a.pending()) wheel.schedule(a, at(1030)); };
+    wheel.schedule(a, at(1020));
+    wheel.schedule(b, at(1020));
+    wheel.advance(at(1020));
+    CHECK(a_count + b_count == 1);
+    CHECK(wheel.pending() == 1);
+    wheel.advance(at(1029));
+    CHECK(a_count + b_count == 1);
+    wheel.advance(at(1030));
+    CHECK((a_count == 1) && (b_count == 1));
+    CHECK(wheel.pending() == 0);
+}
+
+
+
+// - RTPPlayoutWheel ---------------------------------------------------------------
+
+static rawrtp_ptr make_packet(const uint16 sequence)
+{
+    uint8       data[PACKET_BYTES];
+    RTPHeader  *rtp = reinterpret_cast<RTPHeader *>(data);
+
+    memset(data, 0xff, sizeof(data));
+    rtp->flags = htons((RTP_VERSION << 14) | RTP_PAYLOAD_G711U);
+    rtp->sequence = htons(sequence);
+    rtp->timestamp = htonl((uint32)sequence * 8 * PACKET_MS);
+    rtp->ssrc = htonl(0x1234);
+
+    rawrtp_ptr packet = make_shared<RTPPacket>(data, sizeof(data));
+    packet->payload_ms = PACKET_MS;
+    packet->payload_bytes = PACKET_BYTES - RTP_HEADER_LENGTH;
+    return packet;
+}
+
+struct played
+{
+    vector<RTPJitter::RESULT>   results;
+    vector<uint16>              sequences;
+};
+
+static RTPPlayoutWheel::stream_id add(RTPPlayoutWheel& wheel, RTPJitter& jitter, played& log)
+{
+    return wheel.add(&jitter, PACKET_MS, [&log](RTPPlayoutWheel::stream_id, RTPJitter&, RTPJitter::RESULT rc, rawrtp_ptr& packet) {
+        log.results.push_back(rc);
+        log.sequences.push_back(packet ? ntohs(reinterpret_cast<RTPHeader *>(packet->pData)->sequence) : 0);
+    });
+}
+
+// idle until pushed, waiting out the buffering delay, playing once per
+//  ptime, and idle again once the buffer runs dry
+static void playout_states()
+{
+    RTPPlayoutWheel wheel(T0);
+    RTPJitter       jitter(DEPTH_MS);
+    played          log;
+
+    RTPPlayoutWheel::stream_id id = add(wheel, jitter, log);
+    CHECK(wheel.streams() == 1);
+    CHECK(wheel.timers() == 0);         // idle costs nothing
+
+    jitter.push(make_packet(1), at(0));
+    wheel.pushed(id);
+    CHECK(wheel.timers() == 1);         // waiting for the buffering delay
+    CHECK(wheel.playing() == 0);
+
+    CHECK(wheel.advance(at(20)) == 0);
+    jitter.push(make_packet(2), at(20));
+    wheel.pushed(id);
+    CHECK(wheel.timers() == 1);
+    CHECK(wheel.advance(at(59)) == 0);
+
+    CHECK(wheel.advance(at(60)) == 1);  // buffering delay over
+    CHECK(wheel.playing() == 1);
+    CHECK(wheel.advance(at(79)) == 0);
+    CHECK(wheel.advance(at(80)) == 1);  // one ptime on
+    CHECK(wheel.advance(at(100)) == 1); // nothing left: buffering again
+    CHECK(wheel.playing() == 0);
+    CHECK(wheel.timers() == 0);
+    CHECK(wheel.advance(at(1000)) == 0);
+
+    CHECK(log.results.size() == 3);
+    if (log.results.size() == 3) {
+        CHECK((log.results[0] == RTPJitter::SUCCESS) && (log.sequences[0] == 1));
+        CHECK((log.results[1] == RTPJitter::SUCCESS) && (log.sequences[1] == 2));
+        CHECK(log.results[2] == RTPJitter::BUFFERING);
+    }
+
+    // and round again
+    jitter.push(make_packet(3), at(1000));
+    wheel.pushed(id);
+    CHECK(wheel.advance(at(1059)) == 0);
+    CHECK(wheel.advance(at(1060)) == 1);
+    CHECK(log.sequences.back() == 3);
+
+    wheel.remove(id);
+    CHECK(wheel.streams() == 0);
+    CHECK(wheel.timers() == 0);
+    CHECK(wheel.playing() == 0);
+}
+
+// a burst that fills the buffer to its nominal depth brings a waiting
+//  stream's timer forward: it plays on the next tick, not at the end of
+//  the buffering delay
+static void playout_burst()
+{
+    RTPPlayoutWheel wheel(T0);
+    RTPJitter       jitter(DEPTH_MS);
+    played          log;
+
+    RTPPlayoutWheel::stream_id id = add(wheel, jitter, log);
+
+    wheel.advance(at(5));
+    jitter.push(make_packet(1), at(5));
+    wheel.pushed(id);
+    CHECK(wheel.advance(at(6)) == 0);
+
+    jitter.push(make_packet(2), at(6));
+    wheel.pushed(id);
+    jitter.push(make_packet(3), at(6));
+    wheel.pushed(id);
+    CHECK(wheel.timers() == 1);
+
+    CHECK(wheel.advance(at(7)) == 1);
+    CHECK(wheel.playing() == 1);
+    CHECK((log.results.size() == 1) && (log.sequences[0] == 1));
+
+    // from there on it keeps to its ptime
+    CHECK(wheel.advance(at(26)) == 0);
+    CHECK(wheel.advance(at(27)) == 1);
+    CHECK(log.sequences.back() == 2);
+}
+
+
+
+int main()
+{
+    // the library logs to stdout; keep the output to failures
+    if (freopen("/dev/null", "w", stdout) == nullptr) {
+        return 1;
+    }
+
+    level_boundaries(0);
+    level_boundaries(36);
+    level_boundaries(4030);
+    skip_ahead();
+    rearm_and_cancel_in_callback();
+    playout_states();
+    playout_burst();
+
+    if (failures != 0) {
+        fprintf(stderr, "test_timer: %u check(s) failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "test_timer: all checks passed\n");
+    return 0;
+}